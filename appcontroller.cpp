@@ -0,0 +1,230 @@
+#include "appcontroller.h"
+#include "configmodel.h"
+#include "configwatcher.h"
+#include "configwriter.h"
+#include "hotkeymanager.h"
+#include "mainwindow.h"
+#include "ratelimiter.h"
+#include "taskmenu.h"
+#include "taskwindow.h"
+
+#include <QAction>
+#include <QApplication>
+#include <QCursor>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QIcon>
+#include <QLoggingCategory>
+#include <QMenu>
+#include <QStringList>
+#include <QTimer>
+#include <QUrl>
+
+#include <windows.h>
+
+Q_LOGGING_CATEGORY(lcStartup, "dlh.startup")
+
+namespace {
+QUrl buildApiUrl(const QString &baseUrl, const QString &pathSuffix) {
+    QUrl url(baseUrl.trimmed());
+    if (!url.isValid())
+        return QUrl();
+    QString path = url.path();
+    if (!path.endsWith('/'))
+        path += '/';
+    QString suffix = pathSuffix;
+    if (suffix.startsWith('/'))
+        suffix.remove(0, 1);
+    url.setPath(path + suffix);
+    return url;
+}
+
+// Measured from process creation so loader time on slow machines counts.
+qint64 msSinceProcessStart() {
+    FILETIME creation, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernelTime, &userTime))
+        return -1;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    ULARGE_INTEGER start;
+    start.LowPart = creation.dwLowDateTime;
+    start.HighPart = creation.dwHighDateTime;
+    ULARGE_INTEGER current;
+    current.LowPart = now.dwLowDateTime;
+    current.HighPart = now.dwHighDateTime;
+    return qint64(current.QuadPart - start.QuadPart) / 10000;
+}
+}
+
+AppController::AppController(QObject *parent)
+    : QObject(parent)
+    , configModel(ConfigModel::instance())
+    , hotkeyManager(new HotkeyManager(this))
+    , trayIcon(nullptr)
+    , trayMenu(nullptr)
+    , taskMenu(nullptr) {
+    connect(hotkeyManager, &HotkeyManager::hotkeyPressed,
+            this, &AppController::handleGlobalHotkey);
+}
+
+AppController::~AppController() {
+    delete taskMenu;
+    delete settingsWindow.data();
+    delete trayMenu;
+}
+
+void AppController::start() {
+    traceStartup("startup begins");
+    loadConfig();
+    traceStartup("config loaded");
+    createTrayIcon();
+    traceStartup("tray icon shown");
+    applyActiveSettings();
+    traceStartup("hotkey ready");
+
+    connect(configModel, &ConfigModel::configReset, this, [this]() {
+        applyActiveSettings();
+        updateTaskMenu();
+    });
+    connect(configModel, &ConfigModel::settingsChanged, this, &AppController::applyActiveSettings);
+    connect(configModel, &ConfigModel::taskListChanged, this, &AppController::updateTaskMenu);
+    connect(configModel, &ConfigModel::taskChanged, this, [this](int index) {
+        if (taskMenu)
+            taskMenu->setTaskName(index, configModel->config().tasks.at(index).name);
+    });
+    connect(configModel, &ConfigModel::changed, this, &AppController::persistConfig);
+
+    QTimer::singleShot(0, this, [this]() {
+        ensureTaskMenu();
+        traceStartup("task menu built");
+    });
+}
+
+void AppController::loadConfig() {
+    const QString path = ConfigStore::configFilePath();
+    if (!QFile::exists(path)) {
+        configModel->setConfig(ConfigStore::defaultConfig());
+        persistConfig();
+    } else {
+        AppConfig config;
+        if (!ConfigStore::loadFromFile(path, &config))
+            return;
+        configModel->setConfig(config);
+    }
+    ConfigWatcher::instance()->watch(path);
+}
+
+void AppController::persistConfig() {
+    ConfigWriter::instance()->save(ConfigStore::configFilePath(), configModel->config());
+}
+
+void AppController::applyActiveSettings() {
+    updatePreconnect();
+    hotkeyManager->registerHotkey(configModel->config().settings.hotkey);
+}
+
+void AppController::updatePreconnect() {
+    if (!taskMenu)
+        return;
+    const AppSettings &settings = configModel->config().settings;
+    taskMenu->setPreconnect(settings.preconnect
+                                ? buildApiUrl(settings.apiEndpoint, "chat/completions")
+                                : QUrl(),
+                            settings.proxy);
+}
+
+TaskMenu *AppController::ensureTaskMenu() {
+    if (taskMenu)
+        return taskMenu;
+    taskMenu = new TaskMenu();
+    connect(taskMenu, &TaskMenu::taskTriggered, this, &AppController::startTask);
+    updateTaskMenu();
+    updatePreconnect();
+    return taskMenu;
+}
+
+void AppController::updateTaskMenu() {
+    if (taskMenu)
+        taskMenu->setTasks(configModel->config().tasks);
+}
+
+void AppController::handleGlobalHotkey() {
+    ensureTaskMenu()->popup(QCursor::pos());
+}
+
+void AppController::startTask(int index) {
+    // The running session may be inside a nested event loop.
+    if (taskSession)
+        taskSession->deleteLater();
+    taskSession = new TaskWindow(configModel->snapshot(), this);
+    connect(taskSession, &TaskWindow::taskResponsePrefsChanged,
+            this, &AppController::updateTaskResponsePrefs);
+    connect(taskSession, &TaskWindow::taskResponsePrefsCommitRequested,
+            this, &AppController::persistConfig);
+    connect(taskSession, &TaskWindow::hedgeRaceDecided,
+            this, &AppController::recordHedgeWinner);
+    taskSession->start(index);
+}
+
+void AppController::recordHedgeWinner(const QString &winner) {
+    lastHedgeWinner = winner;
+    updateTrayToolTip();
+}
+
+void AppController::updateTaskResponsePrefs(int taskIndex, const QSize &size, int zoom) {
+    configModel->setTaskResponsePrefs(taskIndex, size, zoom);
+}
+
+void AppController::showSettings() {
+    if (!settingsWindow) {
+        QElapsedTimer timer;
+        timer.start();
+        settingsWindow = new MainWindow();
+        qCInfo(lcStartup) << "settings window built in" << timer.elapsed() << "ms";
+    }
+    settingsWindow->showNormal();
+    settingsWindow->raise();
+    settingsWindow->activateWindow();
+}
+
+void AppController::createTrayIcon() {
+    trayMenu = new QMenu();
+    QAction *restoreAction = trayMenu->addAction(tr("Settings"));
+    QAction *quitAction = trayMenu->addAction(tr("Exit"));
+
+    connect(restoreAction, &QAction::triggered, this, &AppController::showSettings);
+    connect(quitAction, &QAction::triggered, qApp, &QApplication::quit);
+
+    trayIcon = new QSystemTrayIcon(this);
+    trayIcon->setIcon(QIcon(":/icons/app.png"));
+    trayIcon->setToolTip(QCoreApplication::applicationName());
+    trayIcon->setContextMenu(trayMenu);
+    connect(trayIcon, &QSystemTrayIcon::activated,
+            this, &AppController::onTrayIconActivated);
+    connect(RateLimiter::instance(), &RateLimiter::stateChanged,
+            this, &AppController::updateTrayToolTip);
+    trayIcon->show();
+}
+
+void AppController::updateTrayToolTip() {
+    if (!trayIcon)
+        return;
+    QStringList lines = {QCoreApplication::applicationName()};
+    const QString limits = RateLimiter::instance()->summary();
+    if (!limits.isEmpty())
+        lines.append(limits);
+    if (!lastHedgeWinner.isEmpty())
+        lines.append(tr("Last hedge race: %1 won").arg(lastHedgeWinner));
+    trayIcon->setToolTip(lines.join('\n'));
+}
+
+void AppController::onTrayIconActivated(QSystemTrayIcon::ActivationReason reason) {
+    if (reason == QSystemTrayIcon::Trigger ||
+        reason == QSystemTrayIcon::DoubleClick) {
+        showSettings();
+    }
+}
+
+void AppController::traceStartup(const char *step) {
+    qCInfo(lcStartup) << step << "at" << msSinceProcessStart() << "ms after process start";
+}
@@ -0,0 +1,66 @@
+#ifndef APPCONTROLLER_H
+#define APPCONTROLLER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QSize>
+#include <QString>
+#include <QSystemTrayIcon>
+
+class ConfigModel;
+class HotkeyManager;
+class MainWindow;
+class QMenu;
+class TaskMenu;
+class TaskWindow;
+
+/**
+ * @brief Owns what the app needs while it sits in the tray.
+ *
+ *  Startup loads the config, shows the tray icon and installs the hotkey
+ *  hook; nothing else. The task menu is built in the first idle step and
+ *  the settings window the first time it is opened. Each step is logged
+ *  under dlh.startup with the time since the process was created.
+ */
+class AppController : public QObject {
+    Q_OBJECT
+
+public:
+    explicit AppController(QObject *parent = nullptr);
+    ~AppController() override;
+
+    void start();
+
+public slots:
+    void showSettings();
+
+private slots:
+    void handleGlobalHotkey();
+    void startTask(int index);
+    void updateTaskResponsePrefs(int taskIndex, const QSize &size, int zoom);
+    void persistConfig();
+    void applyActiveSettings();
+    void recordHedgeWinner(const QString &winner);
+    void updateTrayToolTip();
+    void onTrayIconActivated(QSystemTrayIcon::ActivationReason reason);
+
+private:
+    ConfigModel *configModel;
+    HotkeyManager *hotkeyManager;
+    QSystemTrayIcon *trayIcon;
+    QMenu *trayMenu;
+    TaskMenu *taskMenu;
+    QPointer<MainWindow> settingsWindow;
+    QPointer<TaskWindow> taskSession;
+    // Outcome of the most recent hedged request, shown in the tray tooltip.
+    QString lastHedgeWinner;
+
+    void loadConfig();
+    void createTrayIcon();
+    TaskMenu *ensureTaskMenu();
+    void updateTaskMenu();
+    void updatePreconnect();
+    static void traceStartup(const char *step);
+};
+
+#endif // APPCONTROLLER_H
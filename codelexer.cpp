@@ -0,0 +1,434 @@
+#include "codelexer.h"
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+namespace {
+constexpr quint32 kFnvOffset = 2166136261u;
+constexpr quint32 kFnvPrime = 16777619u;
+// Longer identifiers are never keywords and are not hashed.
+constexpr int kMaxKeywordLength = 32;
+
+constexpr quint32 hashWord(std::string_view word, quint32 seed) {
+    quint32 hash = kFnvOffset ^ seed;
+    for (char c : word)
+        hash = (hash ^ quint32(static_cast<unsigned char>(c))) * kFnvPrime;
+    return hash;
+}
+
+constexpr std::size_t tableSizeFor(std::size_t count) {
+    std::size_t size = 4;
+    while (size < count * 2)
+        size *= 2;
+    return size;
+}
+
+// Two-level perfect hash (hash and displace): words are grouped into
+// buckets by a first hash and every bucket gets the smallest seed that
+// sends all of its words to free slots. A lookup is two hashes and one
+// comparison. The table is built by the compiler; a word list that could
+// not be placed would not compile.
+template <std::size_t Count>
+class KeywordTable {
+public:
+    constexpr explicit KeywordTable(const std::string_view (&words)[Count]) {
+        std::array<std::size_t, kBuckets> sizes{};
+        std::array<std::size_t, kBuckets> order{};
+        for (std::string_view word : words)
+            ++sizes[bucketOf(word)];
+        for (std::size_t i = 0; i < kBuckets; ++i)
+            order[i] = i;
+        // Largest buckets first, while most slots are still free.
+        for (std::size_t i = 1; i < kBuckets; ++i) {
+            for (std::size_t j = i; j > 0 && sizes[order[j]] > sizes[order[j - 1]]; --j) {
+                const std::size_t moved = order[j];
+                order[j] = order[j - 1];
+                order[j - 1] = moved;
+            }
+        }
+        for (std::size_t bucket : order) {
+            if (sizes[bucket] == 0)
+                break;
+            quint32 seed = 1;
+            while (!place(words, bucket, seed))
+                ++seed;
+            seeds[bucket] = seed;
+        }
+    }
+
+    constexpr bool contains(std::string_view word) const {
+        if (word.empty())
+            return false;
+        const quint32 seed = seeds[bucketOf(word)];
+        return slots[hashWord(word, seed) & (kSlots - 1)] == word;
+    }
+
+private:
+    static constexpr std::size_t kSlots = tableSizeFor(Count);
+    static constexpr std::size_t kBuckets = kSlots / 4;
+
+    std::array<std::string_view, kSlots> slots{};
+    std::array<quint32, kBuckets> seeds{};
+
+    static constexpr std::size_t bucketOf(std::string_view word) {
+        return hashWord(word, 0) & (kBuckets - 1);
+    }
+
+    constexpr bool place(const std::string_view (&words)[Count], std::size_t bucket, quint32 seed) {
+        std::array<std::size_t, Count> placed{};
+        std::size_t placedCount = 0;
+        for (std::string_view word : words) {
+            if (bucketOf(word) != bucket)
+                continue;
+            const std::size_t slot = hashWord(word, seed) & (kSlots - 1);
+            if (!slots[slot].empty()) {
+                for (std::size_t i = 0; i < placedCount; ++i)
+                    slots[placed[i]] = std::string_view();
+                return false;
+            }
+            slots[slot] = word;
+            placed[placedCount++] = slot;
+        }
+        return true;
+    }
+};
+
+constexpr std::string_view kCppWords[] = {
+    "alignas", "alignof", "asm", "auto", "bool", "break", "case", "catch", "char",
+    "char8_t", "char16_t", "char32_t", "class", "const", "consteval", "constexpr",
+    "constinit", "const_cast", "continue", "co_await", "co_return", "co_yield", "decltype",
+    "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit",
+    "export", "extern", "false", "final", "float", "for", "friend", "goto", "if", "inline",
+    "int", "long", "mutable", "namespace", "new", "noexcept", "nullptr", "operator",
+    "override", "private", "protected", "public", "register", "reinterpret_cast",
+    "requires", "return", "short", "signed", "sizeof", "static", "static_assert",
+    "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true",
+    "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void",
+    "volatile", "wchar_t", "while"
+};
+constexpr std::string_view kPythonWords[] = {
+    "False", "None", "True", "and", "as", "assert", "async", "await", "break", "case",
+    "class", "continue", "def", "del", "elif", "else", "except", "finally", "for", "from",
+    "global", "if", "import", "in", "is", "lambda", "match", "nonlocal", "not", "or",
+    "pass", "raise", "return", "self", "try", "while", "with", "yield"
+};
+constexpr std::string_view kJavaScriptWords[] = {
+    "abstract", "any", "as", "async", "await", "boolean", "break", "case", "catch", "class",
+    "const", "constructor", "continue", "debugger", "declare", "default", "delete", "do",
+    "else", "enum", "export", "extends", "false", "finally", "for", "from", "function",
+    "get", "if", "implements", "import", "in", "instanceof", "interface", "keyof", "let",
+    "namespace", "never", "new", "null", "number", "of", "private", "protected", "public",
+    "readonly", "return", "set", "static", "string", "super", "switch", "symbol", "this",
+    "throw", "true", "try", "type", "typeof", "undefined", "unknown", "var", "void",
+    "while", "with", "yield"
+};
+constexpr std::string_view kJsonWords[] = {
+    "true", "false", "null"
+};
+constexpr std::string_view kShellWords[] = {
+    "alias", "break", "case", "cd", "continue", "declare", "do", "done", "echo", "elif",
+    "else", "esac", "exit", "export", "false", "fi", "for", "function", "if", "in", "local",
+    "read", "readonly", "return", "select", "set", "shift", "source", "then", "time",
+    "true", "unset", "until", "while"
+};
+constexpr std::string_view kSqlWords[] = {
+    "add", "all", "alter", "and", "as", "asc", "begin", "between", "by", "case", "check",
+    "commit", "constraint", "create", "cross", "default", "delete", "desc", "distinct",
+    "drop", "else", "end", "exists", "foreign", "from", "full", "group", "having", "if",
+    "in", "index", "inner", "insert", "into", "is", "join", "key", "left", "like", "limit",
+    "not", "null", "offset", "on", "or", "order", "outer", "primary", "references",
+    "replace", "returning", "right", "rollback", "select", "set", "table", "then",
+    "transaction", "union", "unique", "update", "values", "view", "when", "where", "with"
+};
+constexpr std::string_view kGenericWords[] = {
+    "auto", "bool", "break", "case", "catch", "class", "const", "continue", "def",
+    "default", "delete", "do", "else", "enum", "export", "extends", "false", "final",
+    "finally", "for", "foreach", "from", "function", "if", "implements", "import", "inline",
+    "interface", "lambda", "let", "namespace", "new", "nullptr", "null", "operator",
+    "private", "protected", "public", "return", "static", "struct", "switch", "template",
+    "this", "throw", "true", "try", "typedef", "typename", "using", "var", "virtual",
+    "void", "volatile", "while"
+};
+
+constexpr KeywordTable kCppKeywords(kCppWords);
+constexpr KeywordTable kPythonKeywords(kPythonWords);
+constexpr KeywordTable kJavaScriptKeywords(kJavaScriptWords);
+constexpr KeywordTable kJsonKeywords(kJsonWords);
+constexpr KeywordTable kShellKeywords(kShellWords);
+constexpr KeywordTable kSqlKeywords(kSqlWords);
+constexpr KeywordTable kGenericKeywords(kGenericWords);
+
+static_assert(kCppKeywords.contains("static_cast") && kSqlKeywords.contains("select"));
+
+struct Syntax {
+    bool slashComments;   // "//" and "/* */"
+    bool hashComments;    // "#" to the end of the line
+    bool dashComments;    // "--" to the end of the line
+    bool singleQuotes;
+    bool backticks;       // template strings that may span lines
+    bool tripleQuotes;
+    bool preprocessor;    // "#directive" at the start of a line
+    bool caseInsensitive;
+};
+
+Syntax syntaxFor(CodeLexer::Language language) {
+    switch (language) {
+        case CodeLexer::Language::Cpp:
+            return {true, false, false, true, false, false, true, false};
+        case CodeLexer::Language::Python:
+            return {false, true, false, true, false, true, false, false};
+        case CodeLexer::Language::JavaScript:
+            return {true, false, false, true, true, false, false, false};
+        case CodeLexer::Language::Json:
+            return {true, false, false, false, false, false, false, false};
+        case CodeLexer::Language::Shell:
+            return {false, true, false, true, false, false, false, false};
+        case CodeLexer::Language::Sql:
+            return {true, false, true, true, false, false, false, true};
+        case CodeLexer::Language::Generic:
+            break;
+    }
+    return {true, true, false, true, false, false, false, false};
+}
+
+bool isIdentifierStart(QChar c) {
+    return c.isLetter() || c == u'_' || c == u'$';
+}
+
+bool isIdentifierPart(QChar c) {
+    return c.isLetterOrNumber() || c == u'_' || c == u'$';
+}
+
+// Returns the position after the closing quote, or -1 when the string
+// runs past the end of the line.
+int scanQuoted(QStringView line, int from, QChar quote, bool escapes) {
+    const int size = int(line.size());
+    for (int i = from; i < size; ++i) {
+        const QChar c = line.at(i);
+        if (escapes && c == u'\\')
+            ++i;
+        else if (c == quote)
+            return i + 1;
+    }
+    return -1;
+}
+
+int scanTripleQuoted(QStringView line, int from, QChar quote) {
+    const int size = int(line.size());
+    for (int i = from; i < size; ++i) {
+        const QChar c = line.at(i);
+        if (c == u'\\') {
+            ++i;
+        } else if (c == quote && i + 2 < size && line.at(i + 1) == quote
+                   && line.at(i + 2) == quote) {
+            return i + 3;
+        }
+    }
+    return -1;
+}
+
+int scanBlockCommentEnd(QStringView line, int from) {
+    const int size = int(line.size());
+    for (int i = from; i + 1 < size; ++i) {
+        if (line.at(i) == u'*' && line.at(i + 1) == u'/')
+            return i + 2;
+    }
+    return -1;
+}
+
+int scanNumber(QStringView line, int from) {
+    const int size = int(line.size());
+    const bool hex = from + 1 < size && line.at(from) == u'0'
+        && (line.at(from + 1) == u'x' || line.at(from + 1) == u'X');
+    int i = from + 1;
+    while (i < size) {
+        const QChar c = line.at(i);
+        if (c.isLetterOrNumber() || c == u'.' || c == u'_' || c == u'\'') {
+            ++i;
+        } else if ((c == u'+' || c == u'-') && !hex
+                   && (line.at(i - 1) == u'e' || line.at(i - 1) == u'E')) {
+            ++i;
+        } else {
+            break;
+        }
+    }
+    // A trailing quote belongs to a string, not to a C++ digit separator.
+    while (i > from + 1 && line.at(i - 1) == u'\'')
+        --i;
+    return i;
+}
+} // namespace
+
+CodeLexer::Language CodeLexer::languageForFence(QStringView fence) {
+    // The info string may carry attributes after the language name.
+    qsizetype end = 0;
+    while (end < fence.size() && !fence.at(end).isSpace() && fence.at(end) != u'{'
+           && fence.at(end) != u',')
+        ++end;
+    const QStringView name = fence.left(end);
+    auto is = [name](const char *candidate) {
+        return name.compare(QLatin1String(candidate), Qt::CaseInsensitive) == 0;
+    };
+    if (is("c") || is("cpp") || is("c++") || is("cc") || is("cxx") || is("h") || is("hpp")
+        || is("objc") || is("cuda")) {
+        return Language::Cpp;
+    }
+    if (is("python") || is("py") || is("python3") || is("py3"))
+        return Language::Python;
+    if (is("javascript") || is("js") || is("jsx") || is("mjs") || is("typescript") || is("ts")
+        || is("tsx")) {
+        return Language::JavaScript;
+    }
+    if (is("json") || is("jsonc") || is("json5"))
+        return Language::Json;
+    if (is("sh") || is("bash") || is("shell") || is("zsh") || is("console"))
+        return Language::Shell;
+    if (is("sql") || is("mysql") || is("postgresql") || is("postgres") || is("psql")
+        || is("sqlite") || is("tsql")) {
+        return Language::Sql;
+    }
+    return Language::Generic;
+}
+
+bool CodeLexer::isKeyword(Language language, QStringView word) {
+    if (word.isEmpty() || word.size() > kMaxKeywordLength)
+        return false;
+    const bool caseInsensitive = syntaxFor(language).caseInsensitive;
+    char buffer[kMaxKeywordLength];
+    for (qsizetype i = 0; i < word.size(); ++i) {
+        char16_t c = word.at(i).unicode();
+        if (c > 0x7f)
+            return false;
+        if (caseInsensitive && c >= u'A' && c <= u'Z')
+            c = char16_t(c - u'A' + u'a');
+        buffer[i] = char(c);
+    }
+    const std::string_view key(buffer, std::size_t(word.size()));
+    switch (language) {
+        case Language::Cpp: return kCppKeywords.contains(key);
+        case Language::Python: return kPythonKeywords.contains(key);
+        case Language::JavaScript: return kJavaScriptKeywords.contains(key);
+        case Language::Json: return kJsonKeywords.contains(key);
+        case Language::Shell: return kShellKeywords.contains(key);
+        case Language::Sql: return kSqlKeywords.contains(key);
+        case Language::Generic: break;
+    }
+    return kGenericKeywords.contains(key);
+}
+
+int CodeLexer::lexLine(QStringView line, Language language, int state, QList<Token> *tokens) {
+    const Syntax syntax = syntaxFor(language);
+    const int size = int(line.size());
+    auto emitToken = [tokens](int start, int end, TokenKind kind) {
+        if (end > start)
+            tokens->append({start, end - start, kind});
+    };
+
+    int i = 0;
+    // Finish a construct left open by the previous line.
+    if (state != Normal) {
+        int end = -1;
+        TokenKind kind = TokenKind::String;
+        if (state == BlockComment) {
+            end = scanBlockCommentEnd(line, 0);
+            kind = TokenKind::Comment;
+        } else if (state == TripleSingleQuote || state == TripleDoubleQuote) {
+            end = scanTripleQuoted(line, 0, state == TripleSingleQuote ? u'\'' : u'"');
+        } else if (state == TemplateString) {
+            end = scanQuoted(line, 0, u'`', true);
+        }
+        if (end < 0) {
+            emitToken(0, size, kind);
+            return state;
+        }
+        emitToken(0, end, kind);
+        i = end;
+    }
+
+    bool lineStart = true;
+    while (i < size) {
+        const QChar c = line.at(i);
+        if (c.isSpace()) {
+            ++i;
+            continue;
+        }
+        const QChar next = i + 1 < size ? line.at(i + 1) : QChar();
+        const bool atLineStart = lineStart;
+        lineStart = false;
+
+        if (syntax.slashComments && c == u'/' && next == u'/') {
+            emitToken(i, size, TokenKind::Comment);
+            return Normal;
+        }
+        if (syntax.slashComments && c == u'/' && next == u'*') {
+            const int end = scanBlockCommentEnd(line, i + 2);
+            if (end < 0) {
+                emitToken(i, size, TokenKind::Comment);
+                return BlockComment;
+            }
+            emitToken(i, end, TokenKind::Comment);
+            i = end;
+            continue;
+        }
+        if (syntax.dashComments && c == u'-' && next == u'-') {
+            emitToken(i, size, TokenKind::Comment);
+            return Normal;
+        }
+        if (syntax.preprocessor && c == u'#' && atLineStart) {
+            int end = i + 1;
+            while (end < size && line.at(end).isSpace())
+                ++end;
+            while (end < size && isIdentifierPart(line.at(end)))
+                ++end;
+            emitToken(i, end, TokenKind::Keyword);
+            i = end;
+            continue;
+        }
+        // In shell "#" only starts a comment at the beginning of a word.
+        if (syntax.hashComments && c == u'#'
+            && (language != Language::Shell || i == 0 || line.at(i - 1).isSpace())) {
+            emitToken(i, size, TokenKind::Comment);
+            return Normal;
+        }
+        if (c == u'"' || (syntax.singleQuotes && c == u'\'') || (syntax.backticks && c == u'`')) {
+            if (syntax.tripleQuotes && next == c && i + 2 < size && line.at(i + 2) == c) {
+                const int end = scanTripleQuoted(line, i + 3, c);
+                if (end < 0) {
+                    emitToken(i, size, TokenKind::String);
+                    return c == u'\'' ? TripleSingleQuote : TripleDoubleQuote;
+                }
+                emitToken(i, end, TokenKind::String);
+                i = end;
+                continue;
+            }
+            // Shell single quotes take everything literally.
+            const bool escapes = !(language == Language::Shell && c == u'\'');
+            const int end = scanQuoted(line, i + 1, c, escapes);
+            if (end < 0) {
+                emitToken(i, size, TokenKind::String);
+                return c == u'`' ? TemplateString : Normal;
+            }
+            emitToken(i, end, TokenKind::String);
+            i = end;
+            continue;
+        }
+        if (c.isDigit() || (c == u'.' && next.isDigit())) {
+            const int end = scanNumber(line, i);
+            emitToken(i, end, TokenKind::Number);
+            i = end;
+            continue;
+        }
+        if (isIdentifierStart(c)) {
+            int end = i + 1;
+            while (end < size && isIdentifierPart(line.at(end)))
+                ++end;
+            if (isKeyword(language, line.mid(i, end - i)))
+                emitToken(i, end, TokenKind::Keyword);
+            i = end;
+            continue;
+        }
+        ++i;
+    }
+    return Normal;
+}
@@ -0,0 +1,57 @@
+#ifndef CODELEXER_H
+#define CODELEXER_H
+
+#include <QList>
+#include <QStringView>
+
+/**
+ * @brief Single-pass tokenizer for syntax highlighting of code blocks.
+ *
+ *  Each line is scanned once from left to right, so strings, comments,
+ *  numbers and identifiers can never overlap. Identifiers are checked
+ *  against per-language keyword tables built at compile time as perfect
+ *  hashes. Constructs that span lines (block comments, Python triple
+ *  quoted strings, JS template strings) are carried in the returned state.
+ */
+class CodeLexer {
+public:
+    enum class Language {
+        Generic,
+        Cpp,
+        Python,
+        JavaScript,
+        Json,
+        Shell,
+        Sql
+    };
+
+    enum class TokenKind {
+        Keyword,
+        String,
+        Number,
+        Comment
+    };
+
+    struct Token {
+        int start;
+        int length;
+        TokenKind kind;
+    };
+
+    /// Line state; 0 means the previous line ended in plain code.
+    enum State {
+        Normal = 0,
+        BlockComment,
+        TripleSingleQuote,
+        TripleDoubleQuote,
+        TemplateString
+    };
+
+    /// Maps a code fence info string ("cpp", "py", "ts", ...) to a language.
+    static Language languageForFence(QStringView fence);
+    /// Appends the tokens of one line and returns the state at its end.
+    static int lexLine(QStringView line, Language language, int state, QList<Token> *tokens);
+    static bool isKeyword(Language language, QStringView word);
+};
+
+#endif // CODELEXER_H
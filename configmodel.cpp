@@ -0,0 +1,133 @@
+#include "configmodel.h"
+
+#include <QCoreApplication>
+#include <QPointer>
+
+ConfigModel *ConfigModel::instance() {
+    static QPointer<ConfigModel> model;
+    if (!model)
+        model = new ConfigModel(QCoreApplication::instance());
+    return model;
+}
+
+ConfigModel::ConfigModel(QObject *parent)
+    : QObject(parent) {
+}
+
+void ConfigModel::setConfig(const AppConfig &config) {
+    mutableConfig() = config;
+    emit configReset();
+}
+
+void ConfigModel::mergeConfig(const AppConfig &config) {
+    if (config.settings != this->config().settings) {
+        mutableConfig().settings = config.settings;
+        emit settingsChanged();
+    }
+
+    const QList<TaskDefinition> &tasks = config.tasks;
+    const int common = qMin(tasks.size(), this->config().tasks.size());
+    for (int i = 0; i < common; ++i) {
+        if (tasks.at(i) == this->config().tasks.at(i))
+            continue;
+        mutableConfig().tasks[i] = tasks.at(i);
+        emit taskChanged(i);
+    }
+
+    // Pack tasks are already in tasks; the list itself is what a save
+    // writes back, so it has to follow the file too.
+    const bool packsChanged = config.taskPacks != this->config().taskPacks;
+    if (packsChanged)
+        mutableConfig().taskPacks = config.taskPacks;
+
+    const bool resized = tasks.size() != this->config().tasks.size();
+    while (this->config().tasks.size() > tasks.size()) {
+        mutableConfig().tasks.removeLast();
+        emit taskRemoved(this->config().tasks.size());
+    }
+    for (int i = this->config().tasks.size(); i < tasks.size(); ++i) {
+        mutableConfig().tasks.append(tasks.at(i));
+        emit taskInserted(i);
+    }
+    if (resized || packsChanged)
+        emit taskListChanged();
+}
+
+void ConfigModel::setSettings(const AppSettings &settings) {
+    mutableConfig().settings = settings;
+    emit settingsChanged();
+    emit changed();
+}
+
+void ConfigModel::setTask(int index, const TaskDefinition &task) {
+    if (index < 0 || index >= config().tasks.size())
+        return;
+    mutableConfig().tasks[index] = task;
+    emit taskChanged(index);
+    emit changed();
+}
+
+void ConfigModel::insertTask(int index, const TaskDefinition &task) {
+    const int packStart = packTaskStart();
+    if (index < 0 || index > packStart)
+        index = packStart;
+    mutableConfig().tasks.insert(index, task);
+    emit taskInserted(index);
+    emit taskListChanged();
+    emit changed();
+}
+
+void ConfigModel::removeTask(int index) {
+    if (index < 0 || index >= config().tasks.size())
+        return;
+    mutableConfig().tasks.removeAt(index);
+    emit taskRemoved(index);
+    emit taskListChanged();
+    emit changed();
+}
+
+void ConfigModel::reorderTasks(const QList<int> &order) {
+    const QList<TaskDefinition> &tasks = config().tasks;
+    if (order.size() != tasks.size())
+        return;
+    QList<TaskDefinition> reordered;
+    reordered.reserve(tasks.size());
+    for (int to = 0; to < order.size(); ++to) {
+        const int from = order.at(to);
+        if (from < 0 || from >= tasks.size())
+            return;
+        if (from != to && !tasks.at(from).pack.isEmpty())
+            return;
+        reordered.append(tasks.at(from));
+    }
+    mutableConfig().tasks = reordered;
+    emit taskListChanged();
+    emit changed();
+}
+
+void ConfigModel::setTaskResponsePrefs(int index, const QSize &size, int zoom) {
+    if (index < 0 || index >= config().tasks.size())
+        return;
+    const TaskDefinition &task = config().tasks.at(index);
+    if (!task.pack.isEmpty())
+        return;
+    if (task.responseWidth == size.width() && task.responseHeight == size.height()
+        && task.responseZoom == zoom) {
+        return;
+    }
+    TaskDefinition &target = mutableConfig().tasks[index];
+    target.responseWidth = size.width();
+    target.responseHeight = size.height();
+    target.responseZoom = zoom;
+    emit taskChanged(index);
+    emit changed();
+}
+
+int ConfigModel::packTaskStart() const {
+    const QList<TaskDefinition> &tasks = config().tasks;
+    for (int i = 0; i < tasks.size(); ++i) {
+        if (!tasks.at(i).pack.isEmpty())
+            return i;
+    }
+    return tasks.size();
+}
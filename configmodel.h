@@ -0,0 +1,94 @@
+#ifndef CONFIGMODEL_H
+#define CONFIGMODEL_H
+
+#include <QList>
+#include <QObject>
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QSize>
+
+#include "configstore.h"
+
+/**
+ * @brief Immutable, implicitly shared view of an AppConfig.
+ *
+ *  Copying a snapshot only bumps a reference count. The model detaches
+ *  when it is changed while a snapshot is still held, so holders keep
+ *  seeing the config as it was when they took it.
+ */
+class ConfigSnapshot {
+public:
+    ConfigSnapshot() : d(new Data) {}
+
+    const AppConfig &operator*() const { return d->config; }
+    const AppConfig *operator->() const { return &d->config; }
+
+private:
+    friend class ConfigModel;
+
+    struct Data : QSharedData {
+        AppConfig config;
+    };
+    QSharedDataPointer<Data> d;
+};
+
+/**
+ * @brief Canonical in-memory config.
+ *
+ *  The settings window pushes each edit here, one setting block or task
+ *  at a time, instead of the config being rebuilt from every widget.
+ *  Readers take a snapshot().
+ */
+class ConfigModel : public QObject {
+    Q_OBJECT
+
+public:
+    static ConfigModel *instance();
+
+    const AppConfig &config() const { return *current; }
+    ConfigSnapshot snapshot() const { return current; }
+
+    /// Replaces everything, e.g. after loading; emits only configReset().
+    void setConfig(const AppConfig &config);
+    /**
+     * Applies a config that is already on disk, e.g. after another program
+     * rewrote the file. Only differing settings and tasks are replaced,
+     * compared by position; tasks are added or removed at the end. The
+     * task pack list is replaced as a whole.
+     * changed() is not emitted.
+     */
+    void mergeConfig(const AppConfig &config);
+    void setSettings(const AppSettings &settings);
+    void setTask(int index, const TaskDefinition &task);
+    /// Inserts before the pack tasks at the latest.
+    void insertTask(int index, const TaskDefinition &task);
+    void removeTask(int index);
+    /// order[i] is the current index of the task that moves to position i.
+    /// Ignored if it moves a pack task.
+    void reorderTasks(const QList<int> &order);
+    /// Ignored for pack tasks, which are not written back to the file.
+    void setTaskResponsePrefs(int index, const QSize &size, int zoom);
+    /// Index of the first pack task. Pack tasks are not saved in the config
+    /// file, so they always follow the inline tasks in pack order.
+    int packTaskStart() const;
+
+signals:
+    void configReset();
+    void settingsChanged();
+    void taskChanged(int index);
+    void taskInserted(int index);
+    void taskRemoved(int index);
+    /// Tasks were added, removed or reordered.
+    void taskListChanged();
+    /// Emitted after every change except setConfig() and mergeConfig().
+    void changed();
+
+private:
+    explicit ConfigModel(QObject *parent);
+
+    ConfigSnapshot current;
+
+    AppConfig &mutableConfig() { return current.d->config; }
+};
+
+#endif // CONFIGMODEL_H
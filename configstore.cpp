@@ -3,12 +3,17 @@
 #include <QCoreApplication>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QJsonParseError>
 #include <QSaveFile>
 #include <QStandardPaths>
 
+#include <utility>
+
+Q_LOGGING_CATEGORY(lcConfig, "dlh.config")
+
 namespace {
 constexpr const char kDefaultModelName[] = "Default";
 
@@ -24,6 +29,13 @@ TaskDefinition taskFromJson(const QJsonObject &obj) {
     task.prompt = obj.value("prompt").toString();
     task.modelName = normalizeModelName(obj.value("modelName").toString());
     task.insertMode = obj.value("insert").toBool(true);
+    task.streamInsert = obj.value("streamInsert").toBool(false);
+    task.insertBatchChars = qMax(1, obj.value("insertBatchChars").toInt(40));
+    task.insertDebounceMs = qMax(0, obj.value("insertDebounceMs").toInt(250));
+    task.hedge = obj.value("hedge").toBool(false);
+    task.hedgeModel = normalizeModelName(obj.value("hedgeModel").toString());
+    task.hedgeDelayMs = qMax(-1, obj.value("hedgeDelayMs").toInt(-1));
+    task.cacheResponses = obj.value("cacheResponses").toBool(false);
     task.maxTokens = obj.value("maxTokens").toInt(300);
     task.temperature = obj.value("temperature").toDouble(0.5);
     const int width = obj.value("responseWidth").toInt(600);
@@ -34,11 +46,37 @@ TaskDefinition taskFromJson(const QJsonObject &obj) {
     return task;
 }
 
+QList<EndpointConfig> endpointsFromJson(const QJsonArray &array) {
+    QList<EndpointConfig> endpoints;
+    for (const QJsonValue &value : array) {
+        const QJsonObject obj = value.toObject();
+        EndpointConfig endpoint;
+        endpoint.url = obj.value("url").toString().trimmed();
+        endpoint.apiKey = obj.value("apiKey").toString();
+        if (!endpoint.url.isEmpty())
+            endpoints.append(endpoint);
+    }
+    return endpoints;
+}
+
+QJsonArray endpointsToJson(const QList<EndpointConfig> &endpoints) {
+    QJsonArray array;
+    for (const EndpointConfig &endpoint : endpoints)
+        array.append(QJsonObject{{"url", endpoint.url}, {"apiKey", endpoint.apiKey}});
+    return array;
+}
+
 QJsonObject taskToJson(const TaskDefinition &task) {
     QJsonObject obj{
         {"name", task.name},
         {"prompt", task.prompt},
         {"insert", task.insertMode},
+        {"streamInsert", task.streamInsert},
+        {"insertBatchChars", task.insertBatchChars},
+        {"insertDebounceMs", task.insertDebounceMs},
+        {"hedge", task.hedge},
+        {"hedgeDelayMs", task.hedgeDelayMs},
+        {"cacheResponses", task.cacheResponses},
         {"maxTokens", task.maxTokens},
         {"temperature", task.temperature},
         {"responseWidth", task.responseWidth},
@@ -47,16 +85,64 @@ QJsonObject taskToJson(const TaskDefinition &task) {
     };
     if (!task.modelName.isEmpty())
         obj.insert("modelName", task.modelName);
+    if (!task.hedgeModel.isEmpty())
+        obj.insert("hedgeModel", task.hedgeModel);
     return obj;
 }
 } // namespace
 
+bool operator==(const EndpointConfig &a, const EndpointConfig &b) {
+    return a.url == b.url && a.apiKey == b.apiKey;
+}
+
+bool operator==(const AppSettings &a, const AppSettings &b) {
+    return a.apiEndpoint == b.apiEndpoint
+           && a.modelName == b.modelName
+           && a.apiKey == b.apiKey
+           && a.proxy == b.proxy
+           && a.hotkey == b.hotkey
+           && a.maxChars == b.maxChars
+           && a.preconnect == b.preconnect
+           && a.fallbackEndpoints == b.fallbackEndpoints
+           && a.connectTimeoutMs == b.connectTimeoutMs
+           && a.firstByteTimeoutMs == b.firstByteTimeoutMs
+           && a.idleTimeoutMs == b.idleTimeoutMs
+           && a.responseCacheMaxMb == b.responseCacheMaxMb
+           && a.responseCacheTtlHours == b.responseCacheTtlHours
+           && a.streamRenderIntervalMs == b.streamRenderIntervalMs;
+}
+
+bool operator==(const TaskDefinition &a, const TaskDefinition &b) {
+    return a.name == b.name
+           && a.prompt == b.prompt
+           && a.modelName == b.modelName
+           && a.insertMode == b.insertMode
+           && a.streamInsert == b.streamInsert
+           && a.insertBatchChars == b.insertBatchChars
+           && a.insertDebounceMs == b.insertDebounceMs
+           && a.hedge == b.hedge
+           && a.hedgeModel == b.hedgeModel
+           && a.hedgeDelayMs == b.hedgeDelayMs
+           && a.cacheResponses == b.cacheResponses
+           && a.maxTokens == b.maxTokens
+           && a.temperature == b.temperature
+           && a.responseWidth == b.responseWidth
+           && a.responseHeight == b.responseHeight
+           && a.responseZoom == b.responseZoom
+           && a.pack == b.pack
+           && a.promptFile == b.promptFile;
+}
+
 QString ConfigStore::configFilePath() {
-    const QString configDir = QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation)
-                              + QDir::separator()
-                              + QCoreApplication::applicationName();
-    QDir().mkpath(configDir);
-    return configDir + QDir::separator() + "config.json";
+    // Called on every save; the directory only has to be created once.
+    static const QString path = []() {
+        const QString configDir = QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation)
+                                  + QDir::separator()
+                                  + QCoreApplication::applicationName();
+        QDir().mkpath(configDir);
+        return configDir + QDir::separator() + "config.json";
+    }();
+    return path;
 }
 
 AppConfig ConfigStore::defaultConfig() {
@@ -67,6 +153,7 @@ AppConfig ConfigStore::defaultConfig() {
     config.settings.proxy = "";
     config.settings.hotkey = "Ctrl+Shift+Space";
     config.settings.maxChars = 1000;
+    config.settings.preconnect = true;
 
     TaskDefinition task;
     task.name = QString::fromUtf8("\xF0\x9F\xA7\xA0 Explane");
@@ -95,12 +182,25 @@ AppConfig ConfigStore::fromJson(const QJsonDocument &doc, bool *ok) {
     config.settings.proxy = settings.value("proxy").toString();
     config.settings.hotkey = settings.value("hotkey").toString();
     config.settings.maxChars = settings.value("maxChars").toInt();
+    config.settings.preconnect = settings.value("preconnect").toBool(true);
+    config.settings.fallbackEndpoints = endpointsFromJson(settings.value("fallbackEndpoints").toArray());
+    config.settings.connectTimeoutMs = qMax(0, settings.value("connectTimeoutMs").toInt(10000));
+    config.settings.firstByteTimeoutMs = qMax(0, settings.value("firstByteTimeoutMs").toInt(30000));
+    config.settings.idleTimeoutMs = qMax(0, settings.value("idleTimeoutMs").toInt(30000));
+    config.settings.responseCacheMaxMb = qMax(1, settings.value("responseCacheMaxMb").toInt(64));
+    config.settings.responseCacheTtlHours = qMax(0, settings.value("responseCacheTtlHours").toInt(168));
+    config.settings.streamRenderIntervalMs = qBound(0, settings.value("streamRenderIntervalMs").toInt(), 1000);
 
     const QJsonArray tasksArray = root.value("tasks").toArray();
     for (const QJsonValue &value : tasksArray) {
         if (value.isObject())
             config.tasks.append(taskFromJson(value.toObject()));
     }
+    for (const QJsonValue &value : root.value("taskPacks").toArray()) {
+        const QString pack = value.toString().trimmed();
+        if (!pack.isEmpty())
+            config.taskPacks.append(pack);
+    }
 
     if (ok)
         *ok = true;
@@ -114,17 +214,29 @@ QJsonDocument ConfigStore::toJson(const AppConfig &config) {
         {"apiKey", config.settings.apiKey},
         {"proxy", config.settings.proxy},
         {"hotkey", config.settings.hotkey},
-        {"maxChars", config.settings.maxChars}
+        {"maxChars", config.settings.maxChars},
+        {"preconnect", config.settings.preconnect},
+        {"fallbackEndpoints", endpointsToJson(config.settings.fallbackEndpoints)},
+        {"connectTimeoutMs", config.settings.connectTimeoutMs},
+        {"firstByteTimeoutMs", config.settings.firstByteTimeoutMs},
+        {"idleTimeoutMs", config.settings.idleTimeoutMs},
+        {"responseCacheMaxMb", config.settings.responseCacheMaxMb},
+        {"responseCacheTtlHours", config.settings.responseCacheTtlHours},
+        {"streamRenderIntervalMs", config.settings.streamRenderIntervalMs}
     };
 
     QJsonArray tasksArray;
-    for (const TaskDefinition &task : config.tasks)
-        tasksArray.append(taskToJson(task));
+    for (const TaskDefinition &task : config.tasks) {
+        if (task.pack.isEmpty())
+            tasksArray.append(taskToJson(task));
+    }
 
     QJsonObject root{
         {"settings", settings},
         {"tasks", tasksArray}
     };
+    if (!config.taskPacks.isEmpty())
+        root.insert("taskPacks", QJsonArray::fromStringList(config.taskPacks));
 
     return QJsonDocument(root);
 }
@@ -139,22 +251,104 @@ bool ConfigStore::loadFromFile(const QString &path, AppConfig *config) {
 
     const QByteArray payload = file.readAll();
     file.close();
+    return parse(payload, path, config);
+}
+
+bool ConfigStore::parse(const QByteArray &bytes, const QString &path, AppConfig *config) {
+    if (!config)
+        return false;
 
     QJsonParseError parseError;
-    const QJsonDocument doc = QJsonDocument::fromJson(payload, &parseError);
+    const QJsonDocument doc = QJsonDocument::fromJson(bytes, &parseError);
     if (parseError.error != QJsonParseError::NoError)
         return false;
 
     bool ok = false;
-    const AppConfig parsed = fromJson(doc, &ok);
+    AppConfig parsed = fromJson(doc, &ok);
     if (!ok)
         return false;
+    loadTaskPacks(&parsed, path);
 
     *config = parsed;
     return true;
 }
 
+void ConfigStore::loadTaskPacks(AppConfig *config, const QString &configPath) {
+    const QDir configDir = QFileInfo(configPath).absoluteDir();
+    for (const QString &entry : std::as_const(config->taskPacks)) {
+        QString indexPath = configDir.absoluteFilePath(entry);
+        if (QFileInfo(indexPath).isDir())
+            indexPath = QDir(indexPath).filePath("pack.json");
+
+        QFile file(indexPath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qCWarning(lcConfig) << "skipping task pack" << indexPath << file.errorString();
+            continue;
+        }
+        QJsonParseError parseError;
+        const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+        if (parseError.error != QJsonParseError::NoError) {
+            qCWarning(lcConfig) << "skipping task pack" << indexPath << parseError.errorString()
+                                << "at offset" << parseError.offset;
+            continue;
+        }
+        if (!doc.isObject()) {
+            qCWarning(lcConfig) << "skipping task pack" << indexPath << "- not a JSON object";
+            continue;
+        }
+
+        const QJsonObject root = doc.object();
+        const QDir packDir = QFileInfo(indexPath).absoluteDir();
+        const QString packName = root.value("name").toString(packDir.dirName());
+        const QJsonArray tasks = root.value("tasks").toArray();
+        config->tasks.reserve(config->tasks.size() + tasks.size());
+        for (const QJsonValue &value : tasks) {
+            if (!value.isObject())
+                continue;
+            const QJsonObject obj = value.toObject();
+            TaskDefinition task = taskFromJson(obj);
+            task.pack = packName;
+            const QString promptFile = obj.value("promptFile").toString();
+            if (!promptFile.isEmpty()) {
+                task.prompt.clear();
+                task.promptFile = packDir.absoluteFilePath(promptFile);
+            }
+            config->tasks.append(task);
+        }
+    }
+}
+
+QString ConfigStore::taskPrompt(const TaskDefinition &task) {
+    if (task.promptFile.isEmpty())
+        return task.prompt;
+    return loadPrompt(task.promptFile);
+}
+
+QString ConfigStore::loadPrompt(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+    const qint64 size = file.size();
+    if (size <= 0)
+        return QString();
+    // Decoding straight from the mapping skips an intermediate byte copy.
+    if (uchar *data = file.map(0, size)) {
+        const QString text = QString::fromUtf8(reinterpret_cast<const char *>(data), size);
+        file.unmap(data);
+        return text;
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
 bool ConfigStore::saveToFile(const QString &path, const AppConfig &config) {
+    return writeFile(path, serialize(config));
+}
+
+QByteArray ConfigStore::serialize(const AppConfig &config) {
+    return toJson(config).toJson();
+}
+
+bool ConfigStore::writeFile(const QString &path, const QByteArray &bytes) {
     if (path.trimmed().isEmpty())
         return false;
 
@@ -162,9 +356,54 @@ bool ConfigStore::saveToFile(const QString &path, const AppConfig &config) {
     if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
         return false;
 
-    const QJsonDocument doc = toJson(config);
-    if (file.write(doc.toJson()) < 0)
+    if (file.write(bytes) < 0)
         return false;
 
     return file.commit();
 }
+
+QString ConfigStore::usageFilePath() {
+    return QFileInfo(configFilePath()).dir().filePath("task_usage.json");
+}
+
+QHash<QString, TaskUsage> ConfigStore::loadUsage(const QString &path) {
+    QHash<QString, TaskUsage> usage;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return usage;
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    for (auto it = root.begin(); it != root.end(); ++it) {
+        const QJsonObject entry = it.value().toObject();
+        TaskUsage item;
+        item.count = entry.value("count").toInt();
+        item.lastUsedMs = qint64(entry.value("lastUsed").toDouble());
+        if (item.count > 0)
+            usage.insert(it.key(), item);
+    }
+    return usage;
+}
+
+QByteArray ConfigStore::serializeUsage(const QHash<QString, TaskUsage> &usage) {
+    QJsonObject root;
+    for (auto it = usage.constBegin(); it != usage.constEnd(); ++it) {
+        QJsonObject entry;
+        entry["count"] = it->count;
+        entry["lastUsed"] = double(it->lastUsedMs);
+        root[it.key()] = entry;
+    }
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QList<EndpointConfig> ConfigStore::endpointList(const AppSettings &settings) {
+    QList<EndpointConfig> endpoints;
+    if (!settings.apiEndpoint.trimmed().isEmpty())
+        endpoints.append({settings.apiEndpoint, settings.apiKey});
+    for (const EndpointConfig &endpoint : settings.fallbackEndpoints) {
+        EndpointConfig entry = endpoint;
+        // A fallback without its own key uses the primary key.
+        if (entry.apiKey.isEmpty())
+            entry.apiKey = settings.apiKey;
+        endpoints.append(entry);
+    }
+    return endpoints;
+}
@@ -1,9 +1,20 @@
 #ifndef CONFIGSTORE_H
 #define CONFIGSTORE_H
 
+#include <QByteArray>
+#include <QHash>
 #include <QJsonDocument>
 #include <QList>
+#include <QLoggingCategory>
 #include <QString>
+#include <QStringList>
+
+Q_DECLARE_LOGGING_CATEGORY(lcConfig)
+
+struct EndpointConfig {
+    QString url;
+    QString apiKey;
+};
 
 struct AppSettings {
     QString apiEndpoint;
@@ -12,6 +23,14 @@ struct AppSettings {
     QString proxy;
     QString hotkey;
     int maxChars = 0;
+    bool preconnect = true;
+    QList<EndpointConfig> fallbackEndpoints;
+    int connectTimeoutMs = 10000;
+    int firstByteTimeoutMs = 30000;
+    int idleTimeoutMs = 30000;
+    int responseCacheMaxMb = 64;
+    int responseCacheTtlHours = 168; // 0: entries never expire
+    int streamRenderIntervalMs = 0; // 0: once per display frame
 };
 
 struct TaskDefinition {
@@ -19,26 +38,72 @@ struct TaskDefinition {
     QString prompt;
     QString modelName;
     bool insertMode = true;
+    bool streamInsert = false;
+    int insertBatchChars = 40;
+    int insertDebounceMs = 250;
+    bool hedge = false;
+    QString hedgeModel;
+    int hedgeDelayMs = -1; // -1: p95 time to first byte of the primary endpoint
+    bool cacheResponses = false;
     int maxTokens = 300;
     double temperature = 0.5;
     int responseWidth = 600;
     int responseHeight = 200;
     int responseZoom = 0;
+    // Name of the task pack the task comes from; pack tasks are read-only
+    // and are not written back to config.json.
+    QString pack;
+    // When set, prompt stays empty and is read from this file on demand.
+    QString promptFile;
 };
 
 struct AppConfig {
     AppSettings settings;
     QList<TaskDefinition> tasks;
+    // Pack directories or pack.json files, relative to the config file.
+    QStringList taskPacks;
 };
 
+// How often and when a task was last picked from the menu.
+struct TaskUsage {
+    int count = 0;
+    qint64 lastUsedMs = 0;
+};
+
+bool operator==(const EndpointConfig &a, const EndpointConfig &b);
+bool operator==(const AppSettings &a, const AppSettings &b);
+bool operator==(const TaskDefinition &a, const TaskDefinition &b);
+inline bool operator!=(const EndpointConfig &a, const EndpointConfig &b) { return !(a == b); }
+inline bool operator!=(const AppSettings &a, const AppSettings &b) { return !(a == b); }
+inline bool operator!=(const TaskDefinition &a, const TaskDefinition &b) { return !(a == b); }
+
 class ConfigStore {
 public:
     static QString configFilePath();
     static AppConfig defaultConfig();
     static AppConfig fromJson(const QJsonDocument &doc, bool *ok = nullptr);
     static QJsonDocument toJson(const AppConfig &config);
+    /// Parses the content of the config file at path, including its task
+    /// packs. config is left untouched if bytes are not a valid config.
+    static bool parse(const QByteArray &bytes, const QString &path, AppConfig *config);
     static bool loadFromFile(const QString &path, AppConfig *config);
     static bool saveToFile(const QString &path, const AppConfig &config);
+    static QByteArray serialize(const AppConfig &config);
+    /// Appends the tasks of every pack in config->taskPacks. Only the pack
+    /// index is read; prompt files are left for taskPrompt().
+    static void loadTaskPacks(AppConfig *config, const QString &configPath);
+    /// The task's prompt, read from its prompt file if it has one.
+    static QString taskPrompt(const TaskDefinition &task);
+    static QString loadPrompt(const QString &path);
+    /// Atomically replaces path with bytes.
+    static bool writeFile(const QString &path, const QByteArray &bytes);
+    /// task_usage.json next to the config file.
+    static QString usageFilePath();
+    /// Usage by task name; empty if the file is missing or unreadable.
+    static QHash<QString, TaskUsage> loadUsage(const QString &path);
+    static QByteArray serializeUsage(const QHash<QString, TaskUsage> &usage);
+    /// Primary endpoint first, then the fallbacks in configured order.
+    static QList<EndpointConfig> endpointList(const AppSettings &settings);
 };
 
 #endif // CONFIGSTORE_H
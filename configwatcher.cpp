@@ -0,0 +1,110 @@
+#include "configwatcher.h"
+#include "configmodel.h"
+#include "configwriter.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QPointer>
+#include <QTimer>
+
+namespace {
+// Lets a copy or a non-atomic writer finish before the file is read.
+constexpr int kSettleMs = 200;
+}
+
+ConfigWatcher *ConfigWatcher::instance() {
+    static QPointer<ConfigWatcher> configWatcher;
+    if (!configWatcher)
+        configWatcher = new ConfigWatcher(QCoreApplication::instance());
+    return configWatcher;
+}
+
+ConfigWatcher::ConfigWatcher(QObject *parent)
+    : QObject(parent)
+    , watcher(new QFileSystemWatcher(this))
+    , settleTimer(new QTimer(this)) {
+    pool.setMaxThreadCount(1);
+    settleTimer->setSingleShot(true);
+    settleTimer->setInterval(kSettleMs);
+    connect(settleTimer, &QTimer::timeout, this, &ConfigWatcher::reload);
+    connect(watcher, &QFileSystemWatcher::fileChanged, this, &ConfigWatcher::scheduleReload);
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this, &ConfigWatcher::handleDirectoryChanged);
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    pool.waitForDone();
+}
+
+void ConfigWatcher::watch(const QString &path) {
+    if (!filePath.isEmpty())
+        watcher->removePaths(watcher->files() + watcher->directories());
+    filePath = path;
+    watcher->addPath(QFileInfo(path).absolutePath());
+    if (QFile::exists(path))
+        watcher->addPath(path);
+    updateStamp();
+
+    // The content at this point is already in the model.
+    pool.start([this, path]() {
+        QFile file(path);
+        if (file.open(QIODevice::ReadOnly))
+            seenBytes = file.readAll();
+    });
+}
+
+void ConfigWatcher::handleDirectoryChanged() {
+    const QFileInfo info(filePath);
+    if (info.lastModified() == seenModified && info.size() == seenSize)
+        return;
+    scheduleReload();
+}
+
+void ConfigWatcher::updateStamp() {
+    const QFileInfo info(filePath);
+    seenModified = info.lastModified();
+    seenSize = info.size();
+}
+
+void ConfigWatcher::scheduleReload() {
+    settleTimer->start();
+}
+
+void ConfigWatcher::reload() {
+    if (filePath.isEmpty())
+        return;
+    if (!watcher->files().contains(filePath) && QFile::exists(filePath))
+        watcher->addPath(filePath);
+    updateStamp();
+
+    // instance() is not thread safe; create the writer here.
+    ConfigWriter *writer = ConfigWriter::instance();
+    const QString path = filePath;
+    pool.start([this, writer, path]() {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return;
+        const QByteArray bytes = file.readAll();
+        if (bytes == seenBytes)
+            return;
+        seenBytes = bytes;
+        if (writer->matchesLastWrite(path, bytes))
+            return;
+
+        AppConfig config;
+        if (!ConfigStore::parse(bytes, path, &config)) {
+            qCWarning(lcConfig) << "ignoring unreadable config change in" << path;
+            return;
+        }
+        QMetaObject::invokeMethod(this, [this, bytes, config]() {
+            applyReload(bytes, config);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ConfigWatcher::applyReload(const QByteArray &bytes, const AppConfig &config) {
+    qCInfo(lcConfig) << "reloading changed config" << filePath;
+    ConfigWriter::instance()->adoptExternal(filePath, bytes);
+    ConfigModel::instance()->mergeConfig(config);
+}
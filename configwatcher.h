@@ -0,0 +1,53 @@
+#ifndef CONFIGWATCHER_H
+#define CONFIGWATCHER_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#include "configstore.h"
+
+class QFileSystemWatcher;
+class QTimer;
+
+/**
+ * @brief Reloads the config when another program rewrites the file.
+ *
+ *  The file and its directory are both watched, since an atomic save
+ *  replaces the file and drops it from the watch list. After a short
+ *  settle delay the file is read and parsed on a worker thread. Content
+ *  that ConfigWriter wrote itself, or that was already seen, is ignored;
+ *  anything else is merged into ConfigModel so only the differing
+ *  settings and tasks are applied.
+ */
+class ConfigWatcher : public QObject {
+public:
+    static ConfigWatcher *instance();
+
+    void watch(const QString &path);
+
+private:
+    explicit ConfigWatcher(QObject *parent);
+    ~ConfigWatcher() override;
+
+    QFileSystemWatcher *watcher;
+    QTimer *settleTimer;
+    QThreadPool pool;
+    QString filePath;
+    // Last content read from the file; only touched on the worker thread.
+    QByteArray seenBytes;
+    // Stamp of the file at the last reload, so changes to other files in
+    // the directory (task usage, for one) do not trigger a reload.
+    QDateTime seenModified;
+    qint64 seenSize = -1;
+
+    void handleDirectoryChanged();
+    void updateStamp();
+    void scheduleReload();
+    void reload();
+    void applyReload(const QByteArray &bytes, const AppConfig &config);
+};
+
+#endif // CONFIGWATCHER_H
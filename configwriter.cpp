@@ -0,0 +1,112 @@
+#include "configwriter.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QGuiApplication>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QTimer>
+
+#include <utility>
+
+namespace {
+// Long enough to cover a burst of typing, short enough that a crash right
+// after an edit loses little.
+constexpr int kDebounceMs = 500;
+}
+
+ConfigWriter *ConfigWriter::instance() {
+    static QPointer<ConfigWriter> writer;
+    if (!writer)
+        writer = new ConfigWriter(QCoreApplication::instance());
+    return writer;
+}
+
+ConfigWriter::ConfigWriter(QObject *parent)
+    : QObject(parent)
+    , debounceTimer(new QTimer(this)) {
+    pool.setMaxThreadCount(1);
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(kDebounceMs);
+    connect(debounceTimer, &QTimer::timeout, this, &ConfigWriter::startWrite);
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &ConfigWriter::flush);
+    if (auto *app = qobject_cast<QGuiApplication *>(QCoreApplication::instance())) {
+        connect(app, &QGuiApplication::commitDataRequest, this, [this]() {
+            flush();
+        });
+    }
+}
+
+ConfigWriter::~ConfigWriter() {
+    flush();
+}
+
+void ConfigWriter::save(const QString &path, const AppConfig &config) {
+    queue(path, [config]() {
+        return ConfigStore::serialize(config);
+    });
+}
+
+void ConfigWriter::saveUsage(const QString &path, const QHash<QString, TaskUsage> &usage) {
+    queue(path, [usage]() {
+        return ConfigStore::serializeUsage(usage);
+    });
+}
+
+void ConfigWriter::queue(const QString &path, std::function<QByteArray()> serialize) {
+    pending.insert(path, std::move(serialize));
+    debounceTimer->start();
+}
+
+void ConfigWriter::flush() {
+    debounceTimer->stop();
+    startWrite();
+    pool.waitForDone();
+}
+
+bool ConfigWriter::matchesLastWrite(const QString &path, const QByteArray &bytes) {
+    QMutexLocker locker(&writtenMutex);
+    const auto it = writtenBytes.constFind(path);
+    return it != writtenBytes.constEnd() && it.value() == bytes;
+}
+
+void ConfigWriter::adoptExternal(const QString &path, const QByteArray &bytes) {
+    if (pending.remove(path) && pending.isEmpty())
+        debounceTimer->stop();
+    QMutexLocker locker(&writtenMutex);
+    writtenBytes.insert(path, bytes);
+}
+
+void ConfigWriter::startWrite() {
+    if (pending.isEmpty())
+        return;
+    const auto writes = std::exchange(pending, {});
+    pool.start([this, writes]() {
+        for (auto it = writes.constBegin(); it != writes.constEnd(); ++it)
+            write(it.key(), it.value()());
+    });
+}
+
+void ConfigWriter::write(const QString &path, const QByteArray &bytes) {
+    QByteArray previous;
+    {
+        QMutexLocker locker(&writtenMutex);
+        auto it = writtenBytes.find(path);
+        if (it == writtenBytes.end()) {
+            QFile file(path);
+            it = writtenBytes.insert(path, file.open(QIODevice::ReadOnly) ? file.readAll()
+                                                                          : QByteArray());
+        }
+        if (it.value() == bytes)
+            return;
+        // Recorded before the write so a watcher that reads the file right
+        // after the rename already sees it as ours.
+        previous = it.value();
+        it.value() = bytes;
+    }
+    if (!ConfigStore::writeFile(path, bytes)) {
+        qCWarning(lcConfig) << "cannot write" << path;
+        QMutexLocker locker(&writtenMutex);
+        writtenBytes.insert(path, previous);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef CONFIGWRITER_H
+#define CONFIGWRITER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#include <functional>
+
+#include "configstore.h"
+
+class QTimer;
+
+/**
+ * @brief Saves the config and task usage in the background.
+ *
+ *  Saves of a file requested within the debounce window collapse into one.
+ *  Files are serialized and written on a single worker thread, so writes
+ *  stay in order, and nothing is written when the bytes match what is
+ *  already on disk. Pending saves are flushed when the application quits
+ *  or the session ends.
+ */
+class ConfigWriter : public QObject {
+public:
+    static ConfigWriter *instance();
+
+    void save(const QString &path, const AppConfig &config);
+    void saveUsage(const QString &path, const QHash<QString, TaskUsage> &usage);
+    /// Writes a pending save now and waits for all writes to finish.
+    void flush();
+    /// True if bytes are what this writer last wrote to path. Thread safe.
+    bool matchesLastWrite(const QString &path, const QByteArray &bytes);
+    /// Records that path now holds bytes written by someone else and drops
+    /// a pending save of it.
+    void adoptExternal(const QString &path, const QByteArray &bytes);
+
+private:
+    explicit ConfigWriter(QObject *parent);
+    ~ConfigWriter() override;
+
+    QTimer *debounceTimer;
+    QThreadPool pool;
+    // Serializes the latest state saved to each path; run by the worker.
+    QHash<QString, std::function<QByteArray()>> pending;
+    // Last bytes known to be on disk per path; used by the worker thread.
+    QMutex writtenMutex;
+    QHash<QString, QByteArray> writtenBytes;
+
+    void queue(const QString &path, std::function<QByteArray()> serialize);
+    void startWrite();
+    void write(const QString &path, const QByteArray &bytes);
+};
+
+#endif // CONFIGWRITER_H
@@ -0,0 +1,399 @@
+#include "deltaextractor.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+constexpr int kMaxDepth = 64;
+constexpr char16_t kReplacementChar = 0xFFFD;
+
+class ChunkScanner {
+public:
+    explicit ChunkScanner(QByteArrayView payload)
+        : p(payload.data())
+        , end(payload.data() + payload.size()) {}
+
+    bool parseRoot(QString *content) {
+        QString deltaContent;
+        QString messageContent;
+        skipWhitespace();
+        if (!consume('{'))
+            return false;
+        if (!parseMembers([&](QByteArrayView key) {
+                if (key == "choices")
+                    return parseChoices(&deltaContent, &messageContent);
+                return skipValue(0);
+            })) {
+            return false;
+        }
+        *content = deltaContent.isEmpty() ? messageContent : deltaContent;
+        return true;
+    }
+
+private:
+    const char *p;
+    const char *end;
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            ++p;
+    }
+
+    bool consume(char c) {
+        if (p >= end || *p != c)
+            return false;
+        ++p;
+        return true;
+    }
+
+    // Called after '{'. Invokes handler for every key with p at the value.
+    template<typename Handler>
+    bool parseMembers(Handler handler) {
+        skipWhitespace();
+        if (consume('}'))
+            return true;
+        while (true) {
+            skipWhitespace();
+            QByteArrayView key;
+            if (!readKey(&key))
+                return false;
+            skipWhitespace();
+            if (!consume(':'))
+                return false;
+            skipWhitespace();
+            if (!handler(key))
+                return false;
+            skipWhitespace();
+            if (consume(','))
+                continue;
+            return consume('}');
+        }
+    }
+
+    bool readKey(QByteArrayView *key) {
+        if (!consume('"'))
+            return false;
+        const char *start = p;
+        while (p < end && *p != '"') {
+            if (*p == '\\')
+                return false; // escaped keys are not part of the chunk shape
+            ++p;
+        }
+        if (p >= end)
+            return false;
+        *key = QByteArrayView(start, p - start);
+        ++p;
+        return true;
+    }
+
+    bool parseChoices(QString *deltaContent, QString *messageContent) {
+        if (!consume('['))
+            return false;
+        skipWhitespace();
+        if (consume(']'))
+            return true;
+        if (!consume('{'))
+            return false;
+        if (!parseMembers([&](QByteArrayView key) {
+                if (key == "delta")
+                    return parseMessage(deltaContent);
+                if (key == "message")
+                    return parseMessage(messageContent);
+                return skipValue(1);
+            })) {
+            return false;
+        }
+        while (true) {
+            skipWhitespace();
+            if (consume(']'))
+                return true;
+            if (!consume(','))
+                return false;
+            skipWhitespace();
+            if (!skipValue(1))
+                return false;
+        }
+    }
+
+    bool parseMessage(QString *content) {
+        if (skipLiteral("null"))
+            return true;
+        if (!consume('{'))
+            return false;
+        return parseMembers([&](QByteArrayView key) {
+            if (key != "content")
+                return skipValue(2);
+            if (skipLiteral("null"))
+                return true;
+            content->clear();
+            return decodeString(content);
+        });
+    }
+
+    bool skipLiteral(const char *literal) {
+        const char *cursor = p;
+        for (; *literal; ++literal, ++cursor) {
+            if (cursor >= end || *cursor != *literal)
+                return false;
+        }
+        p = cursor;
+        return true;
+    }
+
+    bool skipValue(int depth) {
+        if (depth > kMaxDepth || p >= end)
+            return false;
+        switch (*p) {
+            case '"':
+                return skipString();
+            case '{':
+                ++p;
+                return parseMembers([&](QByteArrayView) { return skipValue(depth + 1); });
+            case '[':
+                ++p;
+                skipWhitespace();
+                if (consume(']'))
+                    return true;
+                while (true) {
+                    skipWhitespace();
+                    if (!skipValue(depth + 1))
+                        return false;
+                    skipWhitespace();
+                    if (consume(']'))
+                        return true;
+                    if (!consume(','))
+                        return false;
+                }
+            case 't':
+                return skipLiteral("true");
+            case 'f':
+                return skipLiteral("false");
+            case 'n':
+                return skipLiteral("null");
+            default:
+                return skipNumber();
+        }
+    }
+
+    bool skipString() {
+        ++p;
+        while (p < end) {
+            if (*p == '\\') {
+                p += 2;
+                continue;
+            }
+            if (*p == '"') {
+                ++p;
+                return true;
+            }
+            ++p;
+        }
+        return false;
+    }
+
+    bool skipNumber() {
+        const char *start = p;
+        while (p < end) {
+            const char c = *p;
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')
+                ++p;
+            else
+                break;
+        }
+        return p != start;
+    }
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    bool readHex4(char32_t *value) {
+        if (end - p < 4)
+            return false;
+        char32_t result = 0;
+        for (int i = 0; i < 4; ++i) {
+            const int digit = hexValue(p[i]);
+            if (digit < 0)
+                return false;
+            result = (result << 4) | char32_t(digit);
+        }
+        p += 4;
+        *value = result;
+        return true;
+    }
+
+    static void appendCodePoint(QString *out, char32_t cp) {
+        if (cp > 0xFFFF) {
+            out->append(QChar(QChar::highSurrogate(cp)));
+            out->append(QChar(QChar::lowSurrogate(cp)));
+        } else {
+            out->append(QChar(char16_t(cp)));
+        }
+    }
+
+    bool decodeUnicodeEscape(QString *out) {
+        char32_t unit = 0;
+        if (!readHex4(&unit))
+            return false;
+        if (QChar::isHighSurrogate(unit)) {
+            const char *save = p;
+            char32_t low = 0;
+            if (end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                p += 2;
+                if (readHex4(&low) && QChar::isLowSurrogate(low)) {
+                    appendCodePoint(out, QChar::surrogateToUcs4(char16_t(unit), char16_t(low)));
+                    return true;
+                }
+            }
+            p = save;
+            out->append(QChar(kReplacementChar));
+            return true;
+        }
+        if (QChar::isLowSurrogate(unit)) {
+            out->append(QChar(kReplacementChar));
+            return true;
+        }
+        appendCodePoint(out, unit);
+        return true;
+    }
+
+    bool decodeEscape(QString *out) {
+        ++p;
+        if (p >= end)
+            return false;
+        const char c = *p++;
+        switch (c) {
+            case '"': out->append(QLatin1Char('"')); return true;
+            case '\\': out->append(QLatin1Char('\\')); return true;
+            case '/': out->append(QLatin1Char('/')); return true;
+            case 'b': out->append(QLatin1Char('\b')); return true;
+            case 'f': out->append(QLatin1Char('\f')); return true;
+            case 'n': out->append(QLatin1Char('\n')); return true;
+            case 'r': out->append(QLatin1Char('\r')); return true;
+            case 't': out->append(QLatin1Char('\t')); return true;
+            case 'u': return decodeUnicodeEscape(out);
+            default: return false;
+        }
+    }
+
+    // Decodes one UTF-8 sequence; invalid input yields U+FFFD per byte.
+    void decodeUtf8(QString *out) {
+        const auto lead = static_cast<uchar>(*p);
+        int extra = 0;
+        char32_t cp = 0;
+        char32_t minimum = 0;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            extra = 1;
+            cp = lead & 0x1F;
+            minimum = 0x80;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            extra = 2;
+            cp = lead & 0x0F;
+            minimum = 0x800;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            extra = 3;
+            cp = lead & 0x07;
+            minimum = 0x10000;
+        } else {
+            ++p;
+            out->append(QChar(kReplacementChar));
+            return;
+        }
+        if (end - p <= extra) {
+            ++p;
+            out->append(QChar(kReplacementChar));
+            return;
+        }
+        for (int i = 1; i <= extra; ++i) {
+            const auto next = static_cast<uchar>(p[i]);
+            if ((next & 0xC0) != 0x80) {
+                ++p;
+                out->append(QChar(kReplacementChar));
+                return;
+            }
+            cp = (cp << 6) | (next & 0x3F);
+        }
+        if (cp < minimum || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            ++p;
+            out->append(QChar(kReplacementChar));
+            return;
+        }
+        p += extra + 1;
+        appendCodePoint(out, cp);
+    }
+
+    bool decodeString(QString *out) {
+        if (!consume('"'))
+            return false;
+        out->reserve(out->size() + (end - p));
+        while (p < end) {
+            const char *run = p;
+            while (p < end) {
+                const auto c = static_cast<uchar>(*p);
+                if (c == '"' || c == '\\' || c >= 0x80 || c < 0x20)
+                    break;
+                ++p;
+            }
+            if (p != run)
+                out->append(QLatin1StringView(run, p - run));
+            if (p >= end)
+                return false;
+
+            const auto c = static_cast<uchar>(*p);
+            if (c == '"') {
+                ++p;
+                return true;
+            }
+            if (c == '\\') {
+                if (!decodeEscape(out))
+                    return false;
+            } else if (c >= 0x80) {
+                decodeUtf8(out);
+            } else {
+                return false; // raw control characters are not valid JSON
+            }
+        }
+        return false;
+    }
+};
+} // namespace
+
+QString DeltaExtractor::extractContent(QByteArrayView payload) {
+    QString content;
+    if (extractContentFast(payload, &content))
+        return content;
+    return extractContentWithJsonDocument(payload);
+}
+
+bool DeltaExtractor::extractContentFast(QByteArrayView payload, QString *content) {
+    if (!content)
+        return false;
+    QString result;
+    ChunkScanner scanner(payload);
+    if (!scanner.parseRoot(&result))
+        return false;
+    *content = result;
+    return true;
+}
+
+QString DeltaExtractor::extractContentWithJsonDocument(QByteArrayView payload) {
+    const QJsonDocument doc = QJsonDocument::fromJson(payload.toByteArray());
+    if (!doc.isObject())
+        return QString();
+    const QJsonObject obj = doc.object();
+    const QJsonArray choices = obj.value("choices").toArray();
+    if (choices.isEmpty())
+        return QString();
+    const QJsonObject choice = choices.first().toObject();
+    QString deltaText = choice.value("delta").toObject().value("content").toString();
+    if (deltaText.isEmpty())
+        deltaText = choice.value("message").toObject().value("content").toString();
+    return deltaText;
+}
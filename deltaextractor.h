@@ -0,0 +1,24 @@
+#ifndef DELTAEXTRACTOR_H
+#define DELTAEXTRACTOR_H
+
+#include <QByteArrayView>
+#include <QString>
+
+/**
+ * @brief Reads choices[0].delta.content (or choices[0].message.content)
+ *        from an OpenAI-style chat completion chunk.
+ *
+ *  The fast path is a single forward scan that skips unrelated values and
+ *  decodes the content string, including escapes and surrogate pairs,
+ *  directly into a QString. Payloads it does not recognize are handed to
+ *  QJsonDocument.
+ */
+class DeltaExtractor {
+public:
+    static QString extractContent(QByteArrayView payload);
+    /// @return false when the payload does not have the expected shape.
+    static bool extractContentFast(QByteArrayView payload, QString *content);
+    static QString extractContentWithJsonDocument(QByteArrayView payload);
+};
+
+#endif // DELTAEXTRACTOR_H
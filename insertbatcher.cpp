@@ -0,0 +1,61 @@
+#include "insertbatcher.h"
+
+namespace {
+// Without a sentence or line boundary, cut at whitespace after this many minimums.
+constexpr int kForcedCutFactor = 4;
+
+bool isSentenceEnd(QChar c) {
+    return c == QLatin1Char('.') || c == QLatin1Char('!') || c == QLatin1Char('?')
+           || c == QLatin1Char(':') || c == QLatin1Char(';');
+}
+} // namespace
+
+void InsertBatcher::setMinBatchChars(int chars) {
+    minBatchChars = qMax(1, chars);
+}
+
+void InsertBatcher::append(const QString &text) {
+    pending += text;
+}
+
+QString InsertBatcher::takeBoundaryBatch() {
+    if (pending.size() < minBatchChars)
+        return QString();
+
+    qsizetype end = lastBoundaryEnd();
+    if (end < minBatchChars && pending.size() >= qsizetype(minBatchChars) * kForcedCutFactor)
+        end = lastWhitespaceEnd();
+    if (end < minBatchChars)
+        return QString();
+
+    const QString batch = pending.left(end);
+    pending.remove(0, end);
+    return batch;
+}
+
+QString InsertBatcher::takeAll() {
+    QString batch;
+    batch.swap(pending);
+    return batch;
+}
+
+qsizetype InsertBatcher::lastBoundaryEnd() const {
+    for (qsizetype i = pending.size() - 1; i >= 0; --i) {
+        const QChar c = pending.at(i);
+        if (c == QLatin1Char('\n'))
+            return i + 1;
+        // The whitespace after the punctuation goes with the batch, so the
+        // next batch starts at the next word.
+        if (c.isSpace() && i > 0 && isSentenceEnd(pending.at(i - 1)))
+            return i + 1;
+    }
+    return -1;
+}
+
+qsizetype InsertBatcher::lastWhitespaceEnd() const {
+    for (qsizetype i = pending.size() - 1; i >= 0; --i) {
+        if (pending.at(i).isSpace())
+            return i + 1;
+    }
+    return pending.size();
+}
@@ -0,0 +1,31 @@
+#ifndef INSERTBATCHER_H
+#define INSERTBATCHER_H
+
+#include <QString>
+
+/**
+ * @brief Splits streamed text into paste batches.
+ *
+ *  A batch ends at a line break or after sentence punctuation followed by
+ *  whitespace and is at least minBatchChars long. Text without any such
+ *  boundary is cut at the last whitespace once it grows well past the
+ *  minimum. Concatenating every batch, including takeAll(), always yields
+ *  exactly the appended text.
+ */
+class InsertBatcher {
+public:
+    void setMinBatchChars(int chars);
+    void append(const QString &text);
+    QString takeBoundaryBatch();
+    QString takeAll();
+    bool isEmpty() const { return pending.isEmpty(); }
+
+private:
+    QString pending;
+    int minBatchChars = 1;
+
+    qsizetype lastBoundaryEnd() const;
+    qsizetype lastWhitespaceEnd() const;
+};
+
+#endif // INSERTBATCHER_H
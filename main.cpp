@@ -1,4 +1,4 @@
-#include "mainwindow.h"
+#include "appcontroller.h"
 
 #include <QApplication>
 #include <QLockFile>
@@ -51,8 +51,8 @@ int main(int argc, char *argv[]) {
 
     a.setQuitOnLastWindowClosed(false);
 
-    MainWindow w;
-    w.hide();
+    AppController controller;
+    controller.start();
 
     return a.exec();
 }
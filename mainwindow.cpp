@@ -1,14 +1,16 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "configmodel.h"
+#include "configwriter.h"
 #include "taskwidget.h"
-#include "taskwindow.h"
-#include "hotkeymanager.h"
+#include "networkengine.h"
 
 #include <QDir>
 #include <QFile>
 #include <QFileDialog>
 #include <QJsonDocument>
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QLineEdit>
 #include <QMetaObject>
 #include <QTabBar>
@@ -18,27 +20,28 @@
 #include <QStylePainter>
 #include <QFontMetrics>
 #include <QMouseEvent>
-#include <QMenu>
-#include <QAction>
-#include <QSystemTrayIcon>
 #include <QIcon>
 #include <QCloseEvent>
 #include <QApplication>
 #include <QVariant>
 #include <QMessageBox>
+#include <QCheckBox>
 #include <QComboBox>
+#include <QPlainTextEdit>
+#include <QSpinBox>
 #include <QToolButton>
-#include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
-#include <QNetworkProxy>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QScopedValueRollback>
 #include <QSignalBlocker>
 #include <QStandardPaths>
 #include <QUrl>
+#include <QVBoxLayout>
 
 #include <functional>
+#include <utility>
 
 #include <windows.h>
 
@@ -62,25 +65,30 @@ QUrl buildApiUrl(const QString &baseUrl, const QString &pathSuffix) {
     return url;
 }
 
-void applyProxyToManager(QNetworkAccessManager *manager, const QString &proxyText) {
-    if (!manager)
-        return;
-    const QString trimmed = proxyText.trimmed();
-    if (trimmed.isEmpty()) {
-        QNetworkProxy proxy;
-        proxy.setType(QNetworkProxy::NoProxy);
-        manager->setProxy(proxy);
-        return;
+QList<EndpointConfig> parseEndpointLines(const QString &text) {
+    QList<EndpointConfig> endpoints;
+    const QStringList lines = text.split('\n', Qt::SkipEmptyParts);
+    for (const QString &line : lines) {
+        const QStringList parts = line.simplified().split(' ', Qt::SkipEmptyParts);
+        if (parts.isEmpty())
+            continue;
+        EndpointConfig endpoint;
+        endpoint.url = parts.at(0);
+        if (parts.size() > 1)
+            endpoint.apiKey = parts.at(1);
+        endpoints.append(endpoint);
     }
-    QUrl proxyUrl(trimmed);
-    if (!proxyUrl.isValid()) {
-        QNetworkProxy proxy;
-        proxy.setType(QNetworkProxy::NoProxy);
-        manager->setProxy(proxy);
-        return;
+    return endpoints;
+}
+
+QString formatEndpointLines(const QList<EndpointConfig> &endpoints) {
+    QStringList lines;
+    for (const EndpointConfig &endpoint : endpoints) {
+        lines.append(endpoint.apiKey.isEmpty()
+                         ? endpoint.url
+                         : endpoint.url + ' ' + endpoint.apiKey);
     }
-    QNetworkProxy proxy(QNetworkProxy::HttpProxy, proxyUrl.host(), proxyUrl.port());
-    manager->setProxy(proxy);
+    return lines.join('\n');
 }
 
 class TaskTabBar : public QTabBar {
@@ -432,11 +440,9 @@ MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
       , ui(new Ui::MainWindow)
       , hotkeyCaptured(false)
-      , hotkeyManager(new HotkeyManager(this))
       , loadingConfig(false)
-      , trayIcon(nullptr)
-      , menuWindow(nullptr)
-      , modelNetworkManager(new QNetworkAccessManager(this)) {
+      , updatingModel(false)
+      , configModel(ConfigModel::instance()) {
     instance = this;
     ui->setupUi(this);
     // Include application name in the window title
@@ -470,13 +476,21 @@ MainWindow::MainWindow(QWidget *parent)
             this, &MainWindow::handleTaskTabClicked);
     ensureAddTab();
 
-    connect(ui->lineEditApiEndpoint, &QLineEdit::textChanged, this, &MainWindow::saveConfig);
+    connect(ui->lineEditApiEndpoint, &QLineEdit::textChanged, this, &MainWindow::saveSettings);
     connect(ui->comboBoxModelName, QOverload<int>::of(&QComboBox::currentIndexChanged),
-            this, &MainWindow::saveConfig);
-    connect(ui->lineEditApiKey, &QLineEdit::textChanged, this, &MainWindow::saveConfig);
-    connect(ui->lineEditProxy, &QLineEdit::textChanged, this, &MainWindow::saveConfig);
-    connect(ui->lineEditHotkey, &QLineEdit::textChanged, this, &MainWindow::saveConfig);
-    connect(ui->lineEditMaxChars, &QLineEdit::textChanged, this, &MainWindow::saveConfig);
+            this, &MainWindow::saveSettings);
+    connect(ui->lineEditApiKey, &QLineEdit::textChanged, this, &MainWindow::saveSettings);
+    connect(ui->lineEditProxy, &QLineEdit::textChanged, this, &MainWindow::saveSettings);
+    connect(ui->lineEditHotkey, &QLineEdit::textChanged, this, &MainWindow::saveSettings);
+    connect(ui->lineEditMaxChars, &QLineEdit::textChanged, this, &MainWindow::saveSettings);
+    connect(ui->checkBoxPreconnect, &QCheckBox::toggled, this, &MainWindow::saveSettings);
+    connect(ui->plainTextEditFallbackEndpoints, &QPlainTextEdit::textChanged,
+            this, &MainWindow::saveSettings);
+    for (QSpinBox *spin : {ui->spinBoxConnectTimeout, ui->spinBoxFirstByteTimeout,
+                           ui->spinBoxIdleTimeout, ui->spinBoxCacheSize, ui->spinBoxCacheTtl,
+                           ui->spinBoxRenderInterval}) {
+        connect(spin, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::saveSettings);
+    }
     connect(ui->toolButtonRefreshModels, &QToolButton::clicked,
             this, &MainWindow::requestModelList);
     connect(ui->pushButtonExportSettings, &QPushButton::clicked,
@@ -486,13 +500,13 @@ MainWindow::MainWindow(QWidget *parent)
 
     ui->lineEditHotkey->installEventFilter(this);
 
-    createTrayIcon();
+    connect(configModel, &ConfigModel::configReset, this, &MainWindow::applyModelConfig);
+    connect(configModel, &ConfigModel::settingsChanged, this, &MainWindow::handleSettingsChanged);
+    connect(configModel, &ConfigModel::taskChanged, this, &MainWindow::handleTaskChanged);
+    connect(configModel, &ConfigModel::taskInserted, this, &MainWindow::handleTaskInserted);
+    connect(configModel, &ConfigModel::taskRemoved, this, &MainWindow::handleTaskRemoved);
 
-    connect(hotkeyManager, &HotkeyManager::hotkeyPressed,
-            this, &MainWindow::handleGlobalHotkey);
-
-    loadConfig();
-    hotkeyManager->registerHotkey(ui->lineEditHotkey->text());
+    applyModelConfig();
 }
 
 MainWindow::~MainWindow() {
@@ -502,6 +516,11 @@ MainWindow::~MainWindow() {
 }
 
 bool MainWindow::eventFilter(QObject *obj, QEvent *ev) {
+    if (ev->type() == QEvent::Show) {
+        const int taskIndex = taskIndexOfPage(obj);
+        if (taskIndex >= 0)
+            ensureTaskWidget(taskIndex);
+    }
     if (obj == ui->lineEditHotkey) {
         if (ev->type() == QEvent::FocusIn) {
             prevHotkey = ui->lineEditHotkey->text();
@@ -525,40 +544,70 @@ void MainWindow::closeEvent(QCloseEvent *event) {
 void MainWindow::setHotkeyText(const QString &text) {
     ui->lineEditHotkey->setText(text);
     hotkeyCaptured = true;
-    saveConfig();
+    saveSettings();
 }
 
-void MainWindow::applyDefaultSettings() {
-    applyConfig(ConfigStore::defaultConfig());
+void MainWindow::applyModelConfig() {
+    const AppConfig &config = configModel->config();
+    QElapsedTimer timer;
+    timer.start();
+    loadingConfig = true;
+    applyConfig(config);
+    loadingConfig = false;
+    qCDebug(lcConfig) << "applied" << config.tasks.size() << "tasks to the settings window in"
+                      << timer.elapsed() << "ms";
 }
 
-void MainWindow::loadConfig() {
-    const QString path = ConfigStore::configFilePath();
-    if (!QFile::exists(path)) {
-        loadingConfig = true;
-        applyDefaultSettings();
-        loadingConfig = false;
-        saveConfig();
+void MainWindow::handleSettingsChanged() {
+    if (updatingModel)
         return;
-    }
+    loadingConfig = true;
+    applySettings(configModel->config().settings);
+    loadingConfig = false;
+}
 
-    AppConfig config;
-    if (!ConfigStore::loadFromFile(path, &config))
+void MainWindow::handleTaskChanged(int index) {
+    if (updatingModel || index >= taskTabs.size())
+        return;
+    updateTaskTabTitle(index);
+    TaskWidget *task = taskTabs.at(index).task;
+    if (!task)
         return;
+    loadingConfig = true;
+    task->applyDefinition(configModel->config().tasks.at(index));
+    task->setAvailableModels(availableModels);
+    loadingConfig = false;
+}
 
+void MainWindow::handleTaskInserted(int index) {
+    // Only merges insert from outside, and they append.
+    if (updatingModel || index != taskTabs.size())
+        return;
     loadingConfig = true;
-    applyConfig(config);
+    addTaskTab(index, configModel->config().tasks.at(index), false);
     loadingConfig = false;
 }
 
-void MainWindow::saveConfig() {
-    if (loadingConfig)
+void MainWindow::handleTaskRemoved(int index) {
+    if (updatingModel || index >= taskTabs.size())
         return;
+    QWidget *page = taskTabs.takeAt(index).page;
+    ui->tasksTabWidget->removeTab(ui->tasksTabWidget->indexOf(page));
+    page->deleteLater();
+}
 
-    const AppConfig config = buildConfigFromUi();
-    ConfigStore::saveToFile(ConfigStore::configFilePath(), config);
+void MainWindow::saveSettings() {
+    if (loadingConfig)
+        return;
+    QScopedValueRollback<bool> guard(updatingModel, true);
+    configModel->setSettings(settingsFromUi());
+}
 
-    hotkeyManager->registerHotkey(config.settings.hotkey);
+void MainWindow::saveTask(TaskWidget *task) {
+    if (loadingConfig)
+        return;
+    QScopedValueRollback<bool> guard(updatingModel, true);
+    configModel->setTask(taskIndexOf(task), task->toDefinition());
 }
 
 QString MainWindow::suggestedSettingsPath() const {
@@ -579,8 +628,7 @@ void MainWindow::exportSettings() {
     if (path.isEmpty())
         return;
 
-    const AppConfig config = buildConfigFromUi();
-    if (!ConfigStore::saveToFile(path, config)) {
+    if (!ConfigStore::saveToFile(path, configModel->config())) {
         QMessageBox::warning(this, tr("Export Settings"),
                              tr("Failed to export settings."));
     }
@@ -604,35 +652,82 @@ void MainWindow::importSettings() {
         return;
     }
 
-    loadingConfig = true;
-    applyConfig(config);
-    loadingConfig = false;
-    saveConfig();
+    configModel->setConfig(config);
+    ConfigWriter::instance()->save(ConfigStore::configFilePath(), configModel->config());
 }
 
 void MainWindow::handleTaskTabClicked(int index) {
     if (!isAddTabIndex(index))
         return;
 
+    // The model goes first: the new page is shown, and built, right away.
     TaskDefinition definition;
-    addTaskTab(definition, true);
-    saveConfig();
+    QScopedValueRollback<bool> guard(updatingModel, true);
+    const int index = configModel->packTaskStart();
+    configModel->insertTask(index, definition);
+    addTaskTab(index, definition, true);
 }
 
-void MainWindow::handleTaskTabMoved(int, int) {
+void MainWindow::handleTaskTabMoved(int from, int to) {
+    // Pack tasks stay in one group after the inline tasks; their order is
+    // not saved, so a move that would change it is undone.
+    if (!packTabsInPlace()) {
+        ui->tasksTabWidget->tabBar()->moveTab(to, from);
+        return;
+    }
     ensureAddTabLast();
-    saveConfig();
+    syncTaskOrder();
+}
+
+void MainWindow::syncTaskOrder() {
+    if (loadingConfig)
+        return;
+    QList<TaskTab> ordered;
+    QList<int> order;
+    bool moved = false;
+    for (int i = 0; i < ui->tasksTabWidget->count(); ++i) {
+        const int taskIndex = taskIndexOfPage(ui->tasksTabWidget->widget(i));
+        if (taskIndex < 0)
+            continue;
+        moved = moved || taskIndex != order.size();
+        ordered.append(taskTabs.at(taskIndex));
+        order.append(taskIndex);
+    }
+    if (!moved)
+        return;
+    taskTabs = ordered;
+    QScopedValueRollback<bool> guard(updatingModel, true);
+    configModel->reorderTasks(order);
+}
+
+bool MainWindow::packTabsInPlace() const {
+    const QList<TaskDefinition> &tasks = configModel->config().tasks;
+    for (int i = 0; i < ui->tasksTabWidget->count(); ++i) {
+        const int taskIndex = taskIndexOfPage(ui->tasksTabWidget->widget(i));
+        if (taskIndex >= 0 && taskIndex != i && taskIndex < tasks.size()
+            && !tasks.at(taskIndex).pack.isEmpty()) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void MainWindow::requestCloseTask(int index) {
     if (isAddTabIndex(index))
         return;
 
-    auto *task = qobject_cast<TaskWidget *>(ui->tasksTabWidget->widget(index));
-    if (!task)
+    const int taskIndex = taskIndexOfPage(ui->tasksTabWidget->widget(index));
+    if (taskIndex < 0)
         return;
+    const TaskDefinition &definition = configModel->config().tasks.at(taskIndex);
+    if (!definition.pack.isEmpty()) {
+        QMessageBox::information(this, tr("Remove Task"),
+                                 tr("This task comes from the task pack \"%1\" "
+                                    "and can only be removed from the pack.").arg(definition.pack));
+        return;
+    }
 
-    QString name = task->name().trimmed();
+    QString name = definition.name.trimmed();
     QString title = tr("Remove Task");
     QString message = name.isEmpty()
         ? tr("Do you want to remove this task?")
@@ -644,46 +739,25 @@ void MainWindow::requestCloseTask(int index) {
         return;
     }
 
-    removeTaskWidget(task);
+    removeTaskTab(taskIndex);
 }
 
-void MainWindow::removeTaskWidget(TaskWidget *task) {
-    int index = ui->tasksTabWidget->indexOf(task);
-    if (index != -1) {
-        QWidget *page = ui->tasksTabWidget->widget(index);
-        ui->tasksTabWidget->removeTab(index);
-        page->deleteLater();
-        saveConfig();
-    }
-}
-
-void MainWindow::updateTaskResponsePrefs(int taskIndex, const QSize &size, int zoom) {
-    if (taskIndex < 0 || taskIndex >= ui->tasksTabWidget->count())
-        return;
-    if (isAddTabIndex(taskIndex))
-        return;
-    auto *task = qobject_cast<TaskWidget *>(ui->tasksTabWidget->widget(taskIndex));
-    if (!task)
+void MainWindow::removeTaskTab(int taskIndex) {
+    if (taskIndex < 0 || taskIndex >= taskTabs.size())
         return;
-    task->setResponseWindowSize(size);
-    task->setResponseZoom(zoom);
-}
-
-void MainWindow::commitTaskResponsePrefs() {
-    saveConfig();
+    QWidget *page = taskTabs.takeAt(taskIndex).page;
+    ui->tasksTabWidget->removeTab(ui->tasksTabWidget->indexOf(page));
+    page->deleteLater();
+    QScopedValueRollback<bool> guard(updatingModel, true);
+    configModel->removeTask(taskIndex);
 }
 
 void MainWindow::applyConfig(const AppConfig &config) {
-    ui->lineEditApiEndpoint->setText(config.settings.apiEndpoint);
-    ui->lineEditApiKey->setText(config.settings.apiKey);
-    ui->lineEditProxy->setText(config.settings.proxy);
-    ui->lineEditHotkey->setText(config.settings.hotkey);
-    ui->lineEditMaxChars->setText(QString::number(config.settings.maxChars));
-    updateModelCombos(config.settings.modelName);
+    applySettings(config.settings);
 
     clearTasks();
-    for (const TaskDefinition &task : config.tasks)
-        addTaskTab(task, false);
+    for (int i = 0; i < config.tasks.size(); ++i)
+        addTaskTab(i, config.tasks.at(i), false);
 
     ensureAddTabLast();
     int addIndex = addTabIndex();
@@ -691,62 +765,115 @@ void MainWindow::applyConfig(const AppConfig &config) {
         ui->tasksTabWidget->setCurrentIndex(0);
 }
 
-AppConfig MainWindow::buildConfigFromUi() const {
-    AppConfig config;
-    config.settings.apiEndpoint = ui->lineEditApiEndpoint->text();
-    config.settings.modelName = currentDefaultModel();
-    config.settings.apiKey = ui->lineEditApiKey->text();
-    config.settings.proxy = ui->lineEditProxy->text();
-    config.settings.hotkey = ui->lineEditHotkey->text();
-    config.settings.maxChars = ui->lineEditMaxChars->text().toInt();
-    config.tasks = currentTaskDefinitions();
-    return config;
-}
-
-QList<TaskDefinition> MainWindow::currentTaskDefinitions() const {
-    QList<TaskDefinition> list;
-    for (int i = 0; i < ui->tasksTabWidget->count(); ++i) {
-        if (isAddTabIndex(i))
-            continue;
-        if (auto *task = qobject_cast<TaskWidget *>(ui->tasksTabWidget->widget(i)))
-            list.append(task->toDefinition());
+void MainWindow::applySettings(const AppSettings &settings) {
+    ui->lineEditApiEndpoint->setText(settings.apiEndpoint);
+    ui->lineEditApiKey->setText(settings.apiKey);
+    ui->lineEditProxy->setText(settings.proxy);
+    ui->lineEditHotkey->setText(settings.hotkey);
+    ui->lineEditMaxChars->setText(QString::number(settings.maxChars));
+    ui->checkBoxPreconnect->setChecked(settings.preconnect);
+    ui->plainTextEditFallbackEndpoints->setPlainText(
+        formatEndpointLines(settings.fallbackEndpoints));
+    ui->spinBoxConnectTimeout->setValue(settings.connectTimeoutMs);
+    ui->spinBoxFirstByteTimeout->setValue(settings.firstByteTimeoutMs);
+    ui->spinBoxIdleTimeout->setValue(settings.idleTimeoutMs);
+    ui->spinBoxCacheSize->setValue(settings.responseCacheMaxMb);
+    ui->spinBoxCacheTtl->setValue(settings.responseCacheTtlHours);
+    ui->spinBoxRenderInterval->setValue(settings.streamRenderIntervalMs);
+    updateModelCombos(settings.modelName);
+}
+
+AppSettings MainWindow::settingsFromUi() const {
+    AppSettings settings;
+    settings.apiEndpoint = ui->lineEditApiEndpoint->text();
+    settings.modelName = currentDefaultModel();
+    settings.apiKey = ui->lineEditApiKey->text();
+    settings.proxy = ui->lineEditProxy->text();
+    settings.hotkey = ui->lineEditHotkey->text();
+    settings.maxChars = ui->lineEditMaxChars->text().toInt();
+    settings.preconnect = ui->checkBoxPreconnect->isChecked();
+    settings.fallbackEndpoints =
+        parseEndpointLines(ui->plainTextEditFallbackEndpoints->toPlainText());
+    settings.connectTimeoutMs = ui->spinBoxConnectTimeout->value();
+    settings.firstByteTimeoutMs = ui->spinBoxFirstByteTimeout->value();
+    settings.idleTimeoutMs = ui->spinBoxIdleTimeout->value();
+    settings.responseCacheMaxMb = ui->spinBoxCacheSize->value();
+    settings.responseCacheTtlHours = ui->spinBoxCacheTtl->value();
+    settings.streamRenderIntervalMs = ui->spinBoxRenderInterval->value();
+    return settings;
+}
+
+void MainWindow::addTaskTab(int taskIndex, const TaskDefinition &definition, bool makeCurrent) {
+    auto *page = new QWidget;
+    page->installEventFilter(this);
+
+    QString tabLabel = definition.name.isEmpty() ? tr("<Unnamed>") : definition.name;
+    // Task tabs come first in config order, so a task's tab index is its
+    // config index.
+    taskTabs.insert(taskIndex, {page, nullptr});
+    int index = ui->tasksTabWidget->insertTab(taskIndex, page, tabLabel);
+    if (!definition.pack.isEmpty())
+        ui->tasksTabWidget->setTabToolTip(index, tr("Task pack: %1").arg(definition.pack));
+    if (makeCurrent)
+        ui->tasksTabWidget->setCurrentIndex(index);
+}
+
+int MainWindow::taskIndexOfPage(const QObject *page) const {
+    for (int i = 0; i < taskTabs.size(); ++i) {
+        if (taskTabs.at(i).page == page)
+            return i;
+    }
+    return -1;
+}
+
+int MainWindow::taskIndexOf(const TaskWidget *task) const {
+    for (int i = 0; i < taskTabs.size(); ++i) {
+        if (taskTabs.at(i).task == task)
+            return i;
     }
-    return list;
+    return -1;
 }
 
-void MainWindow::addTaskTab(const TaskDefinition &definition, bool makeCurrent) {
-    auto *task = new TaskWidget;
-    task->applyDefinition(definition);
+TaskWidget *MainWindow::ensureTaskWidget(int taskIndex) {
+    TaskTab &tab = taskTabs[taskIndex];
+    if (tab.task)
+        return tab.task;
+
+    auto *task = new TaskWidget(tab.page);
+    task->applyDefinition(configModel->config().tasks.at(taskIndex));
     task->setAvailableModels(availableModels);
+    task->setRefreshEnabled(ui->toolButtonRefreshModels->isEnabled());
     connectTaskSignals(task);
-
-    QString tabLabel = task->name().isEmpty() ? tr("<Unnamed>") : task->name();
-    int insertIndex = addTabIndex();
-    if (insertIndex < 0)
-        insertIndex = ui->tasksTabWidget->count();
-    int index = ui->tasksTabWidget->insertTab(insertIndex, task, tabLabel);
-    if (makeCurrent)
-        ui->tasksTabWidget->setCurrentIndex(index);
+    auto *layout = new QVBoxLayout(tab.page);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(task);
+    task->show();
+    tab.page->removeEventFilter(this);
+    tab.task = task;
+    return task;
 }
 
 void MainWindow::connectTaskSignals(TaskWidget *task) {
-    connect(task, &TaskWidget::configChanged, this, &MainWindow::saveConfig);
     connect(task, &TaskWidget::configChanged, this, [this, task]() {
-        updateTaskTabTitle(task);
+        saveTask(task);
+        updateTaskTabTitle(taskIndexOf(task));
     });
     connect(task, &TaskWidget::refreshModelsRequested,
             this, &MainWindow::requestModelList);
 }
 
-void MainWindow::updateTaskTabTitle(TaskWidget *task) {
-    int idx = ui->tasksTabWidget->indexOf(task);
+void MainWindow::updateTaskTabTitle(int taskIndex) {
+    if (taskIndex < 0 || taskIndex >= taskTabs.size())
+        return;
+    int idx = ui->tasksTabWidget->indexOf(taskTabs.at(taskIndex).page);
     if (idx != -1) {
-        QString label = task->name().isEmpty() ? tr("<Unnamed>") : task->name();
-        ui->tasksTabWidget->setTabText(idx, label);
+        const QString &name = configModel->config().tasks.at(taskIndex).name;
+        ui->tasksTabWidget->setTabText(idx, name.isEmpty() ? tr("<Unnamed>") : name);
     }
 }
 
 void MainWindow::clearTasks() {
+    taskTabs.clear();
     for (int i = ui->tasksTabWidget->count() - 1; i >= 0; --i) {
         if (isAddTabIndex(i))
             continue;
@@ -823,11 +950,9 @@ void MainWindow::updateModelCombos(const QString &defaultModel) {
         index = ui->comboBoxModelName->count() > 0 ? 0 : -1;
     ui->comboBoxModelName->setCurrentIndex(index);
 
-    for (int i = 0; i < ui->tasksTabWidget->count(); ++i) {
-        if (isAddTabIndex(i))
-            continue;
-        if (auto *task = qobject_cast<TaskWidget *>(ui->tasksTabWidget->widget(i)))
-            task->setAvailableModels(availableModels);
+    for (const TaskTab &tab : std::as_const(taskTabs)) {
+        if (tab.task)
+            tab.task->setAvailableModels(availableModels);
     }
 }
 
@@ -838,11 +963,9 @@ void MainWindow::applyModelList(const QStringList &models) {
 
 void MainWindow::setModelRefreshEnabled(bool enabled) {
     ui->toolButtonRefreshModels->setEnabled(enabled);
-    for (int i = 0; i < ui->tasksTabWidget->count(); ++i) {
-        if (isAddTabIndex(i))
-            continue;
-        if (auto *task = qobject_cast<TaskWidget *>(ui->tasksTabWidget->widget(i)))
-            task->setRefreshEnabled(enabled);
+    for (const TaskTab &tab : std::as_const(taskTabs)) {
+        if (tab.task)
+            tab.task->setRefreshEnabled(enabled);
     }
 }
 
@@ -853,7 +976,6 @@ void MainWindow::requestModelList() {
         return;
     }
 
-    applyProxyToManager(modelNetworkManager, ui->lineEditProxy->text());
     setModelRefreshEnabled(false);
 
     QNetworkRequest request(url);
@@ -861,7 +983,7 @@ void MainWindow::requestModelList() {
     if (!apiKey.isEmpty())
         request.setRawHeader("Authorization", "Bearer " + apiKey.toUtf8());
 
-    QNetworkReply *reply = modelNetworkManager->get(request);
+    QNetworkReply *reply = NetworkEngine::instance()->get(request, ui->lineEditProxy->text());
     connect(reply, &QNetworkReply::finished, this, [this, reply]() {
         setModelRefreshEnabled(true);
         const QByteArray payload = reply->readAll();
@@ -893,46 +1015,3 @@ void MainWindow::requestModelList() {
         reply->deleteLater();
     });
 }
-
-void MainWindow::handleGlobalHotkey() {
-    if (menuWindow) {
-        menuWindow->close();
-        menuWindow = nullptr;
-    }
-    const AppConfig config = buildConfigFromUi();
-    menuWindow = new TaskWindow(config.tasks, config.settings);
-    connect(menuWindow, &TaskWindow::taskResponsePrefsChanged,
-            this, &MainWindow::updateTaskResponsePrefs);
-    connect(menuWindow, &TaskWindow::taskResponsePrefsCommitRequested,
-            this, &MainWindow::commitTaskResponsePrefs);
-}
-
-void MainWindow::createTrayIcon() {
-    QMenu *trayMenu = new QMenu(this);
-    QAction *restoreAction = trayMenu->addAction(tr("Settings"));
-    QAction *quitAction = trayMenu->addAction(tr("Exit"));
-
-    connect(restoreAction, &QAction::triggered, this, [this]() {
-        showNormal();
-        raise();
-        activateWindow();
-    });
-    connect(quitAction, &QAction::triggered, qApp, &QApplication::quit);
-
-    trayIcon = new QSystemTrayIcon(this);
-    trayIcon->setIcon(QIcon(":/icons/app.png"));
-    trayIcon->setToolTip(QCoreApplication::applicationName());
-    trayIcon->setContextMenu(trayMenu);
-    connect(trayIcon, &QSystemTrayIcon::activated,
-            this, &MainWindow::onTrayIconActivated);
-    trayIcon->show();
-}
-
-void MainWindow::onTrayIconActivated(QSystemTrayIcon::ActivationReason reason) {
-    if (reason == QSystemTrayIcon::Trigger ||
-        reason == QSystemTrayIcon::DoubleClick) {
-        showNormal();
-        raise();
-        activateWindow();
-    }
-}
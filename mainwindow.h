@@ -5,22 +5,18 @@
 #include <QString>
 #include <QEvent>
 #include <QList>
-#include <QSystemTrayIcon>
 #include <QCloseEvent>
 #include <QPointer>
-#include <QSize>
 #include <QStringList>
 
-#include "hotkeymanager.h"
 #include "configstore.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
+class ConfigModel;
 class TaskWidget;
-class TaskWindow;
-class QNetworkAccessManager;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -33,20 +29,21 @@ public:
 
 public slots:
     void setHotkeyText(const QString &text);
-    void handleGlobalHotkey();
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
 
 private slots:
-    void onTrayIconActivated(QSystemTrayIcon::ActivationReason reason);
     void handleTaskTabClicked(int index);
     void handleTaskTabMoved(int from, int to);
     void requestCloseTask(int index);
-    void removeTaskWidget(TaskWidget *task);
-    void updateTaskResponsePrefs(int taskIndex, const QSize &size, int zoom);
-    void commitTaskResponsePrefs();
+    void removeTaskTab(int taskIndex);
+    void applyModelConfig();
+    void handleSettingsChanged();
+    void handleTaskChanged(int index);
+    void handleTaskInserted(int index);
+    void handleTaskRemoved(int index);
     void requestModelList();
     void exportSettings();
     void importSettings();
@@ -55,23 +52,32 @@ private:
     Ui::MainWindow *ui;
     QString prevHotkey;
     bool hotkeyCaptured;
-    HotkeyManager *hotkeyManager;
     bool loadingConfig;
-    QSystemTrayIcon *trayIcon;
-    QPointer<TaskWindow> menuWindow;
-    QNetworkAccessManager *modelNetworkManager;
+    // Set while this window pushes an edit, so the model's echo is ignored.
+    bool updatingModel;
+    ConfigModel *configModel;
+    // Task tabs in config order; the add tab is not included. Pages start
+    // empty and get their TaskWidget the first time they are shown.
+    struct TaskTab {
+        QWidget *page = nullptr;
+        TaskWidget *task = nullptr;
+    };
+    QList<TaskTab> taskTabs;
     QStringList availableModels;
 
-    void createTrayIcon();
-    void loadConfig();
-    void saveConfig();
-    void applyDefaultSettings();
+    void saveSettings();
+    void saveTask(TaskWidget *task);
+    void syncTaskOrder();
+    bool packTabsInPlace() const;
     void applyConfig(const AppConfig &config);
-    AppConfig buildConfigFromUi() const;
-    QList<TaskDefinition> currentTaskDefinitions() const;
-    void addTaskTab(const TaskDefinition &definition, bool makeCurrent);
+    void applySettings(const AppSettings &settings);
+    AppSettings settingsFromUi() const;
+    void addTaskTab(int taskIndex, const TaskDefinition &definition, bool makeCurrent);
+    int taskIndexOfPage(const QObject *page) const;
+    int taskIndexOf(const TaskWidget *task) const;
+    TaskWidget *ensureTaskWidget(int taskIndex);
     void connectTaskSignals(TaskWidget *task);
-    void updateTaskTabTitle(TaskWidget *task);
+    void updateTaskTabTitle(int taskIndex);
     void clearTasks();
     int addTabIndex() const;
     bool isAddTabIndex(int index) const;
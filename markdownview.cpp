@@ -0,0 +1,609 @@
+#include "markdownview.h"
+
+#include <QColor>
+#include <QCoreApplication>
+#include <QPointer>
+#include <QStringList>
+#include <QStringView>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextDocumentFragment>
+#include <QTextFragment>
+#include <QThreadPool>
+
+#include <climits>
+#include <utility>
+
+namespace {
+// Smaller updates are parsed in place; the round trip through the thread
+// pool costs more than they do.
+constexpr qsizetype kAsyncParseChars = 4096;
+constexpr QChar kPlaceholder(0x200B);
+} // namespace
+
+bool isCodeBlock(const QTextBlock &block) {
+    const QTextBlockFormat format = block.blockFormat();
+    if (format.hasProperty(QTextFormat::BlockCodeFence))
+        return true;
+    if (format.hasProperty(QTextFormat::BlockCodeLanguage))
+        return true;
+    return block.charFormat().fontFixedPitch();
+}
+
+bool isInlineCodeFormat(const QTextCharFormat &format) {
+    if (format.fontFixedPitch())
+        return true;
+    const QFont font = format.font();
+    if (font.fixedPitch())
+        return true;
+    const QString family = font.family();
+    if (family.contains("mono", Qt::CaseInsensitive)
+        || family.contains("courier", Qt::CaseInsensitive)
+        || family.contains("consolas", Qt::CaseInsensitive)) {
+        return true;
+    }
+    const QStringList families = format.fontFamilies().toStringList();
+    for (const QString &entry : families) {
+        if (entry.contains("mono", Qt::CaseInsensitive)
+            || entry.contains("courier", Qt::CaseInsensitive)
+            || entry.contains("consolas", Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    const QVariant hintProp = format.property(QTextFormat::FontStyleHint);
+    if (hintProp.isValid()) {
+        const int hint = hintProp.toInt();
+        if (hint == QFont::TypeWriter || hint == QFont::Monospace)
+            return true;
+    }
+    const QVariant familyProp = format.property(QTextFormat::FontFamily);
+    if (familyProp.isValid()) {
+        const QString propFamily = familyProp.toString();
+        if (propFamily.contains("mono", Qt::CaseInsensitive)
+            || propFamily.contains("courier", Qt::CaseInsensitive)
+            || propFamily.contains("consolas", Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QFont resolveBaseTextFont(QTextDocument *doc) {
+    if (!doc)
+        return QFont();
+    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next()) {
+        if (isCodeBlock(block))
+            continue;
+        for (auto it = block.begin(); !it.atEnd(); ++it) {
+            const QTextFragment fragment = it.fragment();
+            if (!fragment.isValid())
+                continue;
+            const QTextCharFormat format = fragment.charFormat();
+            if (isInlineCodeFormat(format))
+                continue;
+            const QFont font = format.font();
+            if (font.pointSizeF() > 0 || font.pixelSize() > 0)
+                return font;
+        }
+    }
+    return doc->defaultFont();
+}
+
+const QString &markdownCss() {
+    static const QString css =
+        "body {"
+        "  font-family: 'Segoe UI', 'Noto Sans', Helvetica, Arial;"
+        "  font-size: 12pt;"
+        "  color: #24292f;"
+        "}"
+        "a { color: #0969da; text-decoration: none; }"
+        "a:hover { text-decoration: underline; }"
+        "p { margin: 8px 0; }"
+        "h1 { font-size: 20pt; border-bottom: 1px solid #d0d7de; padding-bottom: 4px; }"
+        "h2 { font-size: 16pt; border-bottom: 1px solid #d0d7de; padding-bottom: 2px; }"
+        "h3 { font-size: 14pt; }"
+        "ul, ol { margin-left: 20px; }"
+        "pre { border: 1px solid #d0d7de; padding: 8px; margin: 12px 0; }"
+        "blockquote {"
+        "  color: #24292f;"
+        "  border-left: 4px solid #9ec5fe;"
+        "  background-color: #f2f7ff;"
+        "  margin: 8px 0;"
+        "  padding: 6px 10px;"
+        "  border-radius: 4px;"
+        "}"
+        "table { border-collapse: collapse; }"
+        "th, td { border: 1px solid #d0d7de; padding: 4px 8px; }"
+        "hr { border: 0; border-top: 1px solid #d0d7de; margin: 12px 0; }";
+    return css;
+}
+
+MarkdownCodeHighlighter::MarkdownCodeHighlighter(QTextDocument *parent)
+    : QSyntaxHighlighter(parent) {
+    keywordFormat.setForeground(QColor("#d73a49"));
+    keywordFormat.setFontWeight(QFont::Bold);
+
+    stringFormat.setForeground(QColor("#032f62"));
+
+    numberFormat.setForeground(QColor("#005cc5"));
+
+    commentFormat.setForeground(QColor("#6a737d"));
+}
+
+void MarkdownCodeHighlighter::highlightBlock(const QString &text) {
+    setCurrentBlockState(0);
+    const QTextBlock block = currentBlock();
+    if (!isCodeBlock(block))
+        return;
+
+    const QString fence = block.blockFormat().stringProperty(QTextFormat::BlockCodeLanguage);
+    if (fence != cachedFence) {
+        cachedFence = fence;
+        cachedLanguage = CodeLexer::languageForFence(fence);
+    }
+
+    // A block may hold several lines separated by U+2028.
+    int state = qMax(0, previousBlockState());
+    qsizetype lineStart = 0;
+    while (lineStart <= text.size()) {
+        qsizetype lineEnd = text.indexOf(QChar::LineSeparator, lineStart);
+        if (lineEnd < 0)
+            lineEnd = text.size();
+        tokens.clear();
+        state = CodeLexer::lexLine(QStringView(text).mid(lineStart, lineEnd - lineStart),
+                                   cachedLanguage, state, &tokens);
+        for (const CodeLexer::Token &token : std::as_const(tokens))
+            setFormat(int(lineStart) + token.start, token.length, formatFor(token.kind));
+        lineStart = lineEnd + 1;
+    }
+    setCurrentBlockState(state);
+}
+
+const QTextCharFormat &MarkdownCodeHighlighter::formatFor(CodeLexer::TokenKind kind) const {
+    switch (kind) {
+        case CodeLexer::TokenKind::Keyword: return keywordFormat;
+        case CodeLexer::TokenKind::String: return stringFormat;
+        case CodeLexer::TokenKind::Number: return numberFormat;
+        case CodeLexer::TokenKind::Comment: break;
+    }
+    return commentFormat;
+}
+
+MarkdownStyler::MarkdownStyler(QTextDocument *document)
+    : QObject(document)
+    , document(document)
+    , dirtyStart(0)
+    , dirtyEnd(INT_MAX) {
+    connect(document, &QTextDocument::contentsChange, this, &MarkdownStyler::handleContentsChange);
+}
+
+void MarkdownStyler::apply() {
+    if (dirtyStart < 0)
+        return;
+    if (!hasBaseFont)
+        updateCodeFormat();
+
+    const int last = qMin(dirtyEnd, document->characterCount() - 1);
+    QTextBlock block = document->findBlock(qMin(dirtyStart, last));
+    if (block.previous().isValid())
+        block = block.previous();
+    QTextBlock end = document->findBlock(last);
+    if (end.next().isValid())
+        end = end.next();
+    dirtyStart = -1;
+    dirtyEnd = -1;
+
+    // Our own format changes report contentsChange as well.
+    applying = true;
+    for (; block.isValid(); block = block.next()) {
+        styleBlock(block);
+        if (block == end)
+            break;
+    }
+    applying = false;
+}
+
+void MarkdownStyler::invalidate() {
+    hasBaseFont = false;
+    dirtyStart = 0;
+    dirtyEnd = INT_MAX;
+}
+
+void MarkdownStyler::handleContentsChange(int position, int charsRemoved, int charsAdded) {
+    if (applying)
+        return;
+    if (dirtyStart < 0) {
+        dirtyStart = position;
+        dirtyEnd = position + charsAdded;
+        return;
+    }
+    // Shift the end of the existing range by this edit before merging.
+    if (dirtyEnd != INT_MAX) {
+        if (dirtyEnd >= position + charsRemoved)
+            dirtyEnd += charsAdded - charsRemoved;
+        else if (dirtyEnd > position)
+            dirtyEnd = position + charsAdded;
+    }
+    dirtyStart = qMin(dirtyStart, position);
+    dirtyEnd = qMax(dirtyEnd, position + charsAdded);
+}
+
+void MarkdownStyler::updateCodeFormat() {
+    codeFormat = QTextCharFormat();
+    codeFormat.setFontFamilies(QStringList{"Consolas"});
+    codeFormat.setFontFixedPitch(true);
+    codeFormat.setBackground(QColor("#f6f8fa"));
+    const QFont baseFont = resolveBaseTextFont(document);
+    if (baseFont.pointSizeF() > 0) {
+        codeFormat.setFontPointSize(baseFont.pointSizeF());
+    } else if (baseFont.pixelSize() > 0) {
+        codeFormat.setProperty(QTextFormat::FontPixelSize, baseFont.pixelSize());
+    }
+    // An empty document only knows the default font; resolve again later.
+    hasBaseFont = !document->isEmpty();
+}
+
+void MarkdownStyler::styleBlock(const QTextBlock &block) {
+    const qreal codeBlockMargin = 8.0;
+    if (isCodeBlock(block)) {
+        QTextCursor blockCursor(block);
+        QTextBlockFormat blockFormat = block.blockFormat();
+        blockFormat.setBackground(QColor("#f6f8fa"));
+        const QTextBlock prevBlock = block.previous();
+        const QTextBlock nextBlock = block.next();
+        const bool isFirstBlock = !prevBlock.isValid() || !isCodeBlock(prevBlock);
+        const bool isLastBlock = !nextBlock.isValid() || !isCodeBlock(nextBlock);
+        blockFormat.setTopMargin(isFirstBlock ? codeBlockMargin : 0.0);
+        blockFormat.setBottomMargin(isLastBlock ? codeBlockMargin : 0.0);
+        blockCursor.setBlockFormat(blockFormat);
+
+        blockCursor.select(QTextCursor::BlockUnderCursor);
+        blockCursor.mergeCharFormat(codeFormat);
+        return;
+    }
+
+    for (auto it = block.begin(); !it.atEnd(); ++it) {
+        const QTextFragment fragment = it.fragment();
+        if (!fragment.isValid())
+            continue;
+        if (!isInlineCodeFormat(fragment.charFormat()))
+            continue;
+        QTextCursor cursor(document);
+        cursor.setPosition(fragment.position());
+        cursor.setPosition(fragment.position() + fragment.length(), QTextCursor::KeepAnchor);
+        cursor.mergeCharFormat(codeFormat);
+    }
+}
+
+struct MarkdownTranscript::ParsedMarkdown {
+    // Inserted into an empty document, where the first block takes the
+    // fragment's block format.
+    QTextDocumentFragment first;
+    // Starts with a placeholder paragraph that merges into the last block
+    // of a non-empty document, so the real blocks keep their formats; the
+    // placeholder character is removed after insertion.
+    QTextDocumentFragment appended;
+};
+
+struct MarkdownTranscript::ParseJob {
+    QStringList pieces;
+    // pieces from this index on belong to the streaming message
+    qsizetype streamPieceStart = 0;
+    quint64 streamId = 0;
+    bool hasTail = false;
+    QString tail;
+    qsizetype tailEnd = 0;
+    QList<ParsedMarkdown> parsedPieces;
+    ParsedMarkdown parsedTail;
+    // Set from the UI thread once the result is no longer wanted.
+    QAtomicInt tailCancelled;
+    bool streamDropped = false;
+};
+
+MarkdownTranscript::MarkdownTranscript(QTextDocument *document)
+    : QObject(document)
+    , document(document) {
+    // Every append would otherwise be kept on the undo stack.
+    document->setUndoRedoEnabled(false);
+}
+
+void MarkdownTranscript::appendMessage(const QString &markdown) {
+    if (markdown.trimmed().isEmpty())
+        return;
+    if (streaming)
+        finishStreaming(streamingText);
+    queuedMessages.append(markdown);
+    schedule();
+}
+
+void MarkdownTranscript::setStreamingText(const QString &markdown) {
+    if (streaming && !markdown.startsWith(streamingText)) {
+        // Frozen parts cannot be taken back piecemeal; start over.
+        discardStreaming();
+    }
+    if (!streaming) {
+        if (markdown.isEmpty())
+            return;
+        streaming = true;
+        ++streamId;
+        streamInDocument = false;
+        frozenChars = 0;
+    }
+    streamingText = markdown;
+    schedule();
+}
+
+void MarkdownTranscript::finishStreaming(const QString &finalText) {
+    if (finalText != streamingText || (!streaming && !finalText.isEmpty()))
+        setStreamingText(finalText);
+    if (!streaming)
+        return;
+    streaming = false;
+
+    const bool tailCurrent = !runningJob && tailRendered && renderedTailEnd == streamingText.size();
+    if (tailCurrent) {
+        // The tail already shows the final text, so it only changes hands.
+        tailRendered = false;
+        hasFrozen = !document->isEmpty();
+    } else {
+        if (runningJob)
+            runningJob->tailCancelled.storeRelaxed(1);
+        // Whatever was not frozen yet is appended as a finished message;
+        // the stale tail goes away with the next insertion.
+        const QString rest = streamingText.mid(frozenChars);
+        if (!rest.trimmed().isEmpty())
+            queuedMessages.append(rest);
+    }
+    streamingText.clear();
+    frozenChars = 0;
+    renderedTailEnd = -1;
+    schedule();
+}
+
+void MarkdownTranscript::discardStreaming() {
+    if (!streaming)
+        return;
+    streaming = false;
+    if (runningJob && runningJob->streamId == streamId) {
+        runningJob->streamDropped = true;
+        runningJob->tailCancelled.storeRelaxed(1);
+    }
+    if (streamInDocument) {
+        removeFrom(streamStart, frozenBeforeStream);
+        hasFrozen = frozenBeforeStream;
+        tailRendered = false;
+    }
+    streamInDocument = false;
+    streamingText.clear();
+    frozenChars = 0;
+    renderedTailEnd = -1;
+}
+
+void MarkdownTranscript::clear() {
+    if (runningJob) {
+        runningJob->streamDropped = true;
+        runningJob->tailCancelled.storeRelaxed(1);
+        runningJob.reset();
+    }
+    document->clear();
+    queuedMessages.clear();
+    hasFrozen = false;
+    streaming = false;
+    streamInDocument = false;
+    streamingText.clear();
+    frozenChars = 0;
+    tailStart = 0;
+    tailRendered = false;
+    renderedTailEnd = -1;
+}
+
+void MarkdownTranscript::schedule() {
+    // One parse at a time; states requested meanwhile are coalesced into
+    // the next job when it finishes.
+    if (runningJob)
+        return;
+
+    auto job = std::make_shared<ParseJob>();
+    job->pieces = std::exchange(queuedMessages, QStringList());
+    job->streamPieceStart = job->pieces.size();
+    if (streaming) {
+        job->streamId = streamId;
+        const qsizetype boundary = stableBoundary(streamingText, frozenChars);
+        if (boundary > frozenChars) {
+            job->pieces.append(streamingText.mid(frozenChars, boundary - frozenChars));
+            frozenChars = boundary;
+        }
+        if (job->pieces.size() > job->streamPieceStart || renderedTailEnd != streamingText.size()) {
+            job->hasTail = true;
+            job->tail = streamingText.mid(frozenChars);
+            job->tailEnd = streamingText.size();
+        }
+    }
+    if (job->pieces.isEmpty() && !job->hasTail)
+        return;
+
+    qsizetype size = job->tail.size();
+    for (const QString &piece : std::as_const(job->pieces))
+        size += piece.size();
+    if (size < kAsyncParseChars) {
+        parse(job.get());
+        apply(*job);
+        return;
+    }
+
+    runningJob = job;
+    QPointer<MarkdownTranscript> self(this);
+    QThreadPool::globalInstance()->start([self, job]() {
+        parse(job.get());
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, job]() {
+            if (self)
+                self->finishJob(job);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MarkdownTranscript::finishJob(const std::shared_ptr<ParseJob> &job) {
+    // Dropped by clear(); a newer job may already be running.
+    if (job != runningJob)
+        return;
+    runningJob.reset();
+    apply(*job);
+    emit rendered();
+    schedule();
+}
+
+void MarkdownTranscript::apply(ParseJob &job) {
+    const bool currentStream = streaming && job.streamId == streamId;
+    if (tailRendered) {
+        removeFrom(tailStart, hasFrozen);
+        tailRendered = false;
+    }
+    for (qsizetype i = 0; i < job.parsedPieces.size(); ++i) {
+        const bool streamPiece = i >= job.streamPieceStart;
+        if (streamPiece && job.streamDropped)
+            break;
+        if (streamPiece && currentStream)
+            markStreamStart();
+        insertParsed(job.parsedPieces.at(i));
+        hasFrozen = true;
+    }
+    tailStart = endPosition();
+    if (job.hasTail && currentStream && !job.tailCancelled.loadRelaxed()) {
+        markStreamStart();
+        insertParsed(job.parsedTail);
+        tailRendered = true;
+        renderedTailEnd = job.tailEnd;
+    }
+}
+
+void MarkdownTranscript::markStreamStart() {
+    if (streamInDocument)
+        return;
+    streamInDocument = true;
+    frozenBeforeStream = hasFrozen;
+    streamStart = endPosition();
+}
+
+void MarkdownTranscript::insertParsed(const ParsedMarkdown &parsed) {
+    if (parsed.first.isEmpty())
+        return;
+    QTextCursor cursor(document);
+    cursor.movePosition(QTextCursor::End);
+    if (!hasFrozen && !tailRendered) {
+        document->clear();
+        cursor = QTextCursor(document);
+        cursor.insertFragment(parsed.first);
+        return;
+    }
+    const int placeholder = cursor.position();
+    cursor.insertFragment(parsed.appended);
+    cursor.setPosition(placeholder);
+    cursor.setPosition(placeholder + 1, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+}
+
+MarkdownTranscript::ParsedMarkdown MarkdownTranscript::parseMarkdown(const QString &markdown) {
+    ParsedMarkdown parsed;
+    if (markdown.trimmed().isEmpty())
+        return parsed;
+    QTextDocument doc;
+    doc.setUndoRedoEnabled(false);
+    doc.setMarkdown(markdown, QTextDocument::MarkdownDialectGitHub);
+    parsed.first = QTextDocumentFragment(&doc);
+
+    // Move the content down one block and put the placeholder in front.
+    QTextCursor cursor(&doc);
+    cursor.insertBlock(cursor.blockFormat(), cursor.blockCharFormat());
+    cursor.movePosition(QTextCursor::Start);
+    cursor.setBlockFormat(QTextBlockFormat());
+    cursor.setBlockCharFormat(QTextCharFormat());
+    cursor.insertText(QString(kPlaceholder), QTextCharFormat());
+    parsed.appended = QTextDocumentFragment(&doc);
+    return parsed;
+}
+
+void MarkdownTranscript::parse(ParseJob *job) {
+    job->parsedPieces.reserve(job->pieces.size());
+    for (const QString &piece : std::as_const(job->pieces))
+        job->parsedPieces.append(parseMarkdown(piece));
+    if (job->hasTail && !job->tailCancelled.loadRelaxed())
+        job->parsedTail = parseMarkdown(job->tail);
+}
+
+int MarkdownTranscript::endPosition() const {
+    return document->characterCount() - 1;
+}
+
+void MarkdownTranscript::removeFrom(int position, bool keepsFrozen) {
+    if (!keepsFrozen) {
+        document->clear();
+        return;
+    }
+    if (position >= endPosition())
+        return;
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+}
+
+qsizetype MarkdownTranscript::stableBoundary(const QString &text, qsizetype from) {
+    qsizetype boundary = from;
+    bool previousBlank = false;
+    QChar fenceChar;
+    qsizetype fenceLength = 0;
+    qsizetype lineStart = from;
+    while (lineStart < text.size()) {
+        const qsizetype newline = text.indexOf(u'\n', lineStart);
+        // The last line may still be growing.
+        if (newline < 0)
+            break;
+        const QStringView line = QStringView(text).mid(lineStart, newline - lineStart);
+        const QStringView trimmed = line.trimmed();
+        const qsizetype nextLine = newline + 1;
+
+        qsizetype markerLength = 0;
+        if (!trimmed.isEmpty() && (trimmed.front() == u'`' || trimmed.front() == u'~')) {
+            while (markerLength < trimmed.size() && trimmed.at(markerLength) == trimmed.front())
+                ++markerLength;
+        }
+        if (fenceLength > 0) {
+            if (markerLength >= fenceLength && trimmed.front() == fenceChar
+                && trimmed.mid(markerLength).trimmed().isEmpty()) {
+                fenceLength = 0;
+            }
+            previousBlank = false;
+            lineStart = nextLine;
+            continue;
+        }
+        if (trimmed.isEmpty()) {
+            previousBlank = true;
+            lineStart = nextLine;
+            continue;
+        }
+
+        const QChar first = line.front();
+        bool startsBlock = first != u' ' && first != u'\t' && first != u'>' && first != u'|';
+        if (startsBlock && (first == u'-' || first == u'*' || first == u'+'))
+            startsBlock = line.size() < 2 || (line.at(1) != u' ' && line.at(1) != u'\t');
+        if (startsBlock && first.isDigit()) {
+            qsizetype i = 0;
+            while (i < line.size() && line.at(i).isDigit())
+                ++i;
+            const bool listItem = i + 1 < line.size()
+                                  && (line.at(i) == u'.' || line.at(i) == u')')
+                                  && line.at(i + 1) == u' ';
+            startsBlock = !listItem;
+        }
+        if (previousBlank && startsBlock)
+            boundary = lineStart;
+        if (markerLength >= 3) {
+            fenceChar = trimmed.front();
+            fenceLength = markerLength;
+        }
+        previousBlank = false;
+        lineStart = nextLine;
+    }
+    return boundary;
+}
@@ -0,0 +1,139 @@
+#ifndef MARKDOWNVIEW_H
+#define MARKDOWNVIEW_H
+
+#include <QFont>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QSyntaxHighlighter>
+#include <QTextCharFormat>
+
+#include <memory>
+
+#include "codelexer.h"
+
+class QTextBlock;
+class QTextDocument;
+
+bool isCodeBlock(const QTextBlock &block);
+bool isInlineCodeFormat(const QTextCharFormat &format);
+QFont resolveBaseTextFont(QTextDocument *doc);
+const QString &markdownCss();
+
+class MarkdownCodeHighlighter : public QSyntaxHighlighter {
+public:
+    explicit MarkdownCodeHighlighter(QTextDocument *parent);
+
+protected:
+    void highlightBlock(const QString &text) override;
+
+private:
+    QTextCharFormat keywordFormat;
+    QTextCharFormat stringFormat;
+    QTextCharFormat numberFormat;
+    QTextCharFormat commentFormat;
+    QString cachedFence;
+    CodeLexer::Language cachedLanguage = CodeLexer::Language::Generic;
+    QList<CodeLexer::Token> tokens;
+
+    const QTextCharFormat &formatFor(CodeLexer::TokenKind kind) const;
+};
+
+/**
+ * @brief Applies code styling to the blocks of a document that changed.
+ *
+ *  Positions reported by QTextDocument::contentsChange are accumulated into
+ *  one dirty range, and apply() restyles only the blocks inside it plus
+ *  their neighbours, whose code block margins depend on them. The base
+ *  text font is resolved once and kept until invalidate().
+ */
+class MarkdownStyler : public QObject {
+public:
+    explicit MarkdownStyler(QTextDocument *document);
+
+    void apply();
+    /// Forgets the base font and restyles the whole document, e.g. after zoom.
+    void invalidate();
+
+private:
+    QTextDocument *document;
+    int dirtyStart;
+    int dirtyEnd;
+    bool applying = false;
+    bool hasBaseFont = false;
+    QTextCharFormat codeFormat;
+
+    void handleContentsChange(int position, int charsRemoved, int charsAdded);
+    void updateCodeFormat();
+    void styleBlock(const QTextBlock &block);
+};
+
+/**
+ * @brief Renders a chat transcript into a QTextDocument incrementally.
+ *
+ *  Finished messages are converted once and appended as frozen blocks.
+ *  The message that is still streaming is split at its last stable block
+ *  boundary (a blank line outside a code fence that starts a new top-level
+ *  block): the part before it is frozen like a finished message, and only
+ *  the tail after it is removed and re-parsed on each update.
+ *
+ *  Large updates are parsed into detached documents on the global thread
+ *  pool and inserted as fragments, so the view keeps its zoom and scroll
+ *  position. Only one parse runs at a time; text that arrives meanwhile is
+ *  coalesced into the next one, and a tail that is no longer wanted is
+ *  skipped.
+ */
+class MarkdownTranscript : public QObject {
+    Q_OBJECT
+
+public:
+    explicit MarkdownTranscript(QTextDocument *document);
+
+    void appendMessage(const QString &markdown);
+    /// markdown normally extends the text passed on the previous call;
+    /// anything else restarts the streaming message.
+    void setStreamingText(const QString &markdown);
+    /// Freezes the streaming message; finalText is only re-parsed if it differs.
+    void finishStreaming(const QString &finalText);
+    /// Removes the streaming message, frozen parts included.
+    void discardStreaming();
+    void clear();
+
+signals:
+    /// The document changed after a background parse finished.
+    void rendered();
+
+private:
+    struct ParsedMarkdown;
+    struct ParseJob;
+
+    QTextDocument *document;
+    bool hasFrozen = false;
+    QStringList queuedMessages;
+    std::shared_ptr<ParseJob> runningJob;
+    // Streaming message state.
+    bool streaming = false;
+    quint64 streamId = 0;
+    QString streamingText;
+    qsizetype frozenChars = 0;
+    bool streamInDocument = false;
+    bool frozenBeforeStream = false;
+    int streamStart = 0;
+    int tailStart = 0;
+    bool tailRendered = false;
+    qsizetype renderedTailEnd = -1;
+
+    void schedule();
+    void finishJob(const std::shared_ptr<ParseJob> &job);
+    void apply(ParseJob &job);
+    void markStreamStart();
+    void insertParsed(const ParsedMarkdown &parsed);
+    int endPosition() const;
+    void removeFrom(int position, bool keepsFrozen);
+    static ParsedMarkdown parseMarkdown(const QString &markdown);
+    static void parse(ParseJob *job);
+    static qsizetype stableBoundary(const QString &text, qsizetype from);
+};
+
+#endif // MARKDOWNVIEW_H
@@ -0,0 +1,42 @@
+#include "mousehook.h"
+
+#include <QList>
+#include <QPair>
+
+namespace {
+HHOOK s_hook = nullptr;
+QList<QPair<const void *, MouseHook::Handler>> s_subscribers;
+} // namespace
+
+void MouseHook::subscribe(const void *owner, Handler handler) {
+    for (auto &subscriber : s_subscribers) {
+        if (subscriber.first == owner) {
+            subscriber.second = std::move(handler);
+            return;
+        }
+    }
+    s_subscribers.append({owner, std::move(handler)});
+    if (!s_hook)
+        s_hook = SetWindowsHookExW(WH_MOUSE_LL, LowLevelProc, GetModuleHandleW(nullptr), 0);
+}
+
+void MouseHook::unsubscribe(const void *owner) {
+    s_subscribers.removeIf([owner](const auto &subscriber) {
+        return subscriber.first == owner;
+    });
+    if (s_subscribers.isEmpty() && s_hook) {
+        UnhookWindowsHookEx(s_hook);
+        s_hook = nullptr;
+    }
+}
+
+LRESULT CALLBACK MouseHook::LowLevelProc(int nCode, WPARAM wParam, LPARAM lParam) {
+    if (nCode == HC_ACTION) {
+        const auto &data = *reinterpret_cast<const MSLLHOOKSTRUCT *>(lParam);
+        // A shared copy: handlers may unsubscribe while being called.
+        const auto subscribers = s_subscribers;
+        for (const auto &subscriber : subscribers)
+            subscriber.second(wParam, data);
+    }
+    return CallNextHookEx(nullptr, nCode, wParam, lParam);
+}
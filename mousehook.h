@@ -0,0 +1,29 @@
+#ifndef MOUSEHOOK_H
+#define MOUSEHOOK_H
+
+#include <functional>
+
+#include <windows.h>
+
+/**
+ * @brief The one process-wide WH_MOUSE_LL hook.
+ *
+ *  Everything that follows the mouse outside our windows (the task menu's
+ *  outside-click check, the loading indicator) subscribes here. The hook is
+ *  installed with the first subscriber and removed with the last, so it is
+ *  only active while one of them needs it.
+ */
+class MouseHook {
+public:
+    /// Runs inside the hook on the GUI thread; keep it short.
+    using Handler = std::function<void(WPARAM message, const MSLLHOOKSTRUCT &data)>;
+
+    /// Registers or replaces the handler of owner.
+    static void subscribe(const void *owner, Handler handler);
+    static void unsubscribe(const void *owner);
+
+private:
+    static LRESULT CALLBACK LowLevelProc(int nCode, WPARAM wParam, LPARAM lParam);
+};
+
+#endif // MOUSEHOOK_H
@@ -0,0 +1,299 @@
+#include "networkengine.h"
+#include "ratelimiter.h"
+
+#include <QCoreApplication>
+#include <QNetworkAccessManager>
+#include <QNetworkProxy>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QSslConfiguration>
+#include <QTimer>
+
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcNetwork, "dlh.network")
+
+namespace {
+// A request counts as warmed up if it starts this soon after a preconnect.
+constexpr qint64 kPreconnectWindowMs = 30000;
+// Weight of the newest sample in the latency and error averages.
+constexpr double kHealthSmoothing = 0.3;
+// An endpoint that failed this recently is tried after all others.
+constexpr qint64 kFailurePenaltyMs = 60000;
+// Window of first-byte samples kept per origin for quantiles.
+constexpr int kFirstByteWindow = 32;
+constexpr int kMinQuantileSamples = 5;
+
+const char *deadlineName(DeadlineKind kind) {
+    switch (kind) {
+        case DeadlineKind::Connect: return "connect";
+        case DeadlineKind::FirstByte: return "first-byte";
+        case DeadlineKind::Idle: return "idle";
+        case DeadlineKind::None: break;
+    }
+    return "none";
+}
+
+QNetworkProxy proxyFromText(const QString &proxyText) {
+    const QString trimmed = proxyText.trimmed();
+    if (trimmed.isEmpty())
+        return QNetworkProxy(QNetworkProxy::NoProxy);
+    const QUrl proxyUrl(trimmed);
+    if (!proxyUrl.isValid())
+        return QNetworkProxy(QNetworkProxy::NoProxy);
+    return QNetworkProxy(QNetworkProxy::HttpProxy, proxyUrl.host(), proxyUrl.port());
+}
+} // namespace
+
+NetworkEngine::NetworkEngine(QObject *parent)
+    : QObject(parent) {}
+
+NetworkEngine *NetworkEngine::instance() {
+    static QPointer<NetworkEngine> engine;
+    if (!engine)
+        engine = new NetworkEngine(QCoreApplication::instance());
+    return engine;
+}
+
+QNetworkReply *NetworkEngine::get(QNetworkRequest request, const QString &proxy) {
+    const QString key = managerKey(request.url(), proxy);
+    prepareRequest(&request, key);
+    QNetworkReply *reply = managerFor(key, proxy)->get(request);
+    track(reply, key);
+    return reply;
+}
+
+QNetworkReply *NetworkEngine::post(QNetworkRequest request,
+                                   const QByteArray &body,
+                                   const QString &proxy) {
+    const QString key = managerKey(request.url(), proxy);
+    prepareRequest(&request, key);
+    QNetworkReply *reply = managerFor(key, proxy)->post(request, body);
+    track(reply, key);
+    return reply;
+}
+
+void NetworkEngine::preconnect(const QUrl &url, const QString &proxy) {
+    if (!url.isValid() || url.host().isEmpty())
+        return;
+    const QString key = managerKey(url, proxy);
+    QNetworkAccessManager *manager = managerFor(key, proxy);
+    if (url.scheme() == QLatin1String("https")) {
+        manager->connectToHostEncrypted(url.host(), quint16(url.port(443)),
+                                        sslConfiguration(key, QSslConfiguration::defaultConfiguration()));
+    } else {
+        manager->connectToHost(url.host(), quint16(url.port(80)));
+    }
+    preconnects[key].start();
+    qCDebug(lcNetwork) << "preconnect" << url.host();
+}
+
+void NetworkEngine::watchDeadlines(QNetworkReply *reply, const RequestDeadlines &deadlines) {
+    if (!reply || !trackedReplies.contains(reply))
+        return;
+    TrackedReply &tracked = trackedReplies[reply];
+    tracked.deadlines = deadlines;
+    tracked.deadlineTimer = new QTimer(reply);
+    tracked.deadlineTimer->setSingleShot(true);
+    connect(tracked.deadlineTimer, &QTimer::timeout, this, [this, reply]() {
+        TrackedReply &entry = trackedReplies[reply];
+        entry.stats.expiredDeadline = entry.pendingDeadline;
+        qCDebug(lcNetwork) << reply->url().host() << deadlineName(entry.pendingDeadline)
+                           << "deadline expired";
+        reply->abort();
+    });
+    connect(reply, &QNetworkReply::requestSent, this, [this, reply]() {
+        if (trackedReplies.value(reply).pendingDeadline == DeadlineKind::Connect)
+            armDeadline(reply, DeadlineKind::FirstByte);
+    });
+    connect(reply, &QNetworkReply::metaDataChanged, this, [this, reply]() {
+        armDeadline(reply, DeadlineKind::Idle);
+    });
+    connect(reply, &QNetworkReply::readyRead, this, [this, reply]() {
+        armDeadline(reply, DeadlineKind::Idle);
+    });
+    connect(reply, &QNetworkReply::finished, tracked.deadlineTimer, &QTimer::stop);
+
+    armDeadline(reply, deadlines.connectMs > 0 ? DeadlineKind::Connect : DeadlineKind::FirstByte);
+}
+
+QList<int> NetworkEngine::rankEndpoints(const QList<QUrl> &urls) const {
+    QList<int> order;
+    for (int i = 0; i < urls.size(); ++i)
+        order.append(i);
+    QList<double> scores;
+    for (const QUrl &url : urls)
+        scores.append(healthScore(originKey(url)));
+    std::stable_sort(order.begin(), order.end(), [&scores](int a, int b) {
+        return scores.at(a) < scores.at(b);
+    });
+    return order;
+}
+
+int NetworkEngine::firstByteQuantile(const QUrl &url, double quantile) const {
+    const auto it = health.constFind(originKey(url));
+    if (it == health.constEnd() || it->firstByteSamples.size() < kMinQuantileSamples)
+        return -1;
+    QList<qint64> sorted = it->firstByteSamples;
+    std::sort(sorted.begin(), sorted.end());
+    const qsizetype index = qBound(qsizetype(0), qsizetype(quantile * sorted.size()),
+                                   sorted.size() - 1);
+    return int(sorted.at(index));
+}
+
+ConnectionStats NetworkEngine::connectionStats(const QNetworkReply *reply) const {
+    const auto it = trackedReplies.constFind(reply);
+    if (it == trackedReplies.constEnd())
+        return ConnectionStats();
+    return it->stats;
+}
+
+QString NetworkEngine::managerKey(const QUrl &url, const QString &proxy) {
+    const int defaultPort = url.scheme() == QLatin1String("https") ? 443 : 80;
+    return url.scheme() + "://" + url.host() + ':' + QString::number(url.port(defaultPort))
+           + '|' + proxy.trimmed();
+}
+
+QString NetworkEngine::originKey(const QUrl &url) {
+    return managerKey(url, QString());
+}
+
+QNetworkAccessManager *NetworkEngine::managerFor(const QString &key, const QString &proxy) {
+    QNetworkAccessManager *manager = managers.value(key);
+    if (manager)
+        return manager;
+    manager = new QNetworkAccessManager(this);
+    manager->setProxy(proxyFromText(proxy));
+    managers.insert(key, manager);
+    return manager;
+}
+
+QSslConfiguration NetworkEngine::sslConfiguration(const QString &key, QSslConfiguration base) const {
+    // Same ALPN list for preconnects and requests, otherwise an HTTP/2
+    // request would not pick up a preconnected socket.
+    base.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2,
+                                  QSslConfiguration::NextProtocolHttp1_1});
+    // Needed for sessionTicket() to be filled after the handshake.
+    base.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    const QByteArray ticket = sessionTickets.value(key);
+    if (!ticket.isEmpty())
+        base.setSessionTicket(ticket);
+    return base;
+}
+
+void NetworkEngine::prepareRequest(QNetworkRequest *request, const QString &key) const {
+    if (request->url().scheme() != QLatin1String("https"))
+        return;
+    request->setSslConfiguration(sslConfiguration(key, request->sslConfiguration()));
+}
+
+void NetworkEngine::track(QNetworkReply *reply, const QString &key) {
+    TrackedReply &tracked = trackedReplies[reply];
+    tracked.timer.start();
+    const auto preconnect = preconnects.constFind(key);
+    if (preconnect != preconnects.constEnd()) {
+        tracked.stats.preconnected = preconnect->elapsed() < kPreconnectWindowMs;
+        preconnects.erase(preconnect);
+    }
+
+    connect(reply, &QNetworkReply::socketStartedConnecting, this, [this, reply]() {
+        trackedReplies[reply].stats.newConnection = true;
+    });
+    connect(reply, &QNetworkReply::requestSent, this, [this, reply]() {
+        TrackedReply &entry = trackedReplies[reply];
+        entry.stats.requestSentMs = entry.timer.elapsed();
+    });
+    connect(reply, &QNetworkReply::encrypted, this, [this, reply, key]() {
+        trackedReplies[reply].stats.tlsHandshake = true;
+        const QByteArray ticket = reply->sslConfiguration().sessionTicket();
+        if (!ticket.isEmpty())
+            sessionTickets.insert(key, ticket);
+    });
+    connect(reply, &QNetworkReply::metaDataChanged, this, [this, reply]() {
+        TrackedReply &entry = trackedReplies[reply];
+        if (entry.stats.firstByteMs < 0) {
+            entry.stats.firstByteMs = entry.timer.elapsed();
+            RateLimiter::instance()->observe(reply);
+        }
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        TrackedReply &entry = trackedReplies[reply];
+        entry.stats.totalMs = entry.timer.elapsed();
+        entry.stats.http2 = reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool();
+        qCDebug(lcNetwork).nospace()
+            << reply->url().host() << ": reused=" << !entry.stats.newConnection
+            << " tls=" << entry.stats.tlsHandshake << " h2=" << entry.stats.http2
+            << " preconnected=" << entry.stats.preconnected
+            << " sent=" << entry.stats.requestSentMs << "ms"
+            << " firstByte=" << entry.stats.firstByteMs << "ms"
+            << " total=" << entry.stats.totalMs << "ms";
+        recordHealth(reply, entry.stats);
+        emit requestFinished(reply->url(), entry.stats);
+    });
+    connect(reply, &QObject::destroyed, this, [this, reply]() {
+        trackedReplies.remove(reply);
+    });
+}
+
+void NetworkEngine::armDeadline(QNetworkReply *reply, DeadlineKind kind) {
+    const auto it = trackedReplies.find(reply);
+    if (it == trackedReplies.end() || !it->deadlineTimer)
+        return;
+    int timeoutMs = 0;
+    switch (kind) {
+        case DeadlineKind::Connect: timeoutMs = it->deadlines.connectMs; break;
+        case DeadlineKind::FirstByte: timeoutMs = it->deadlines.firstByteMs; break;
+        case DeadlineKind::Idle: timeoutMs = it->deadlines.idleMs; break;
+        case DeadlineKind::None: break;
+    }
+    it->pendingDeadline = kind;
+    if (timeoutMs > 0)
+        it->deadlineTimer->start(timeoutMs);
+    else
+        it->deadlineTimer->stop();
+}
+
+void NetworkEngine::recordHealth(const QNetworkReply *reply, const ConnectionStats &stats) {
+    const QNetworkReply::NetworkError error = reply->error();
+    // A user abort says nothing about the endpoint.
+    if (error == QNetworkReply::OperationCanceledError
+        && stats.expiredDeadline == DeadlineKind::None) {
+        return;
+    }
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const bool failed = stats.expiredDeadline != DeadlineKind::None
+                        || (error != QNetworkReply::NoError && (status == 0 || status >= 500));
+
+    EndpointHealth &entry = health[originKey(reply->url())];
+    const double latency = stats.firstByteMs >= 0 ? double(stats.firstByteMs) : double(stats.totalMs);
+    if (entry.samples == 0) {
+        entry.latencyMs = latency;
+        entry.errorRate = failed ? 1.0 : 0.0;
+    } else {
+        entry.latencyMs += kHealthSmoothing * (latency - entry.latencyMs);
+        entry.errorRate += kHealthSmoothing * ((failed ? 1.0 : 0.0) - entry.errorRate);
+    }
+    ++entry.samples;
+    if (failed) {
+        entry.lastFailure.start();
+    } else if (stats.firstByteMs >= 0) {
+        if (entry.firstByteSamples.size() < kFirstByteWindow)
+            entry.firstByteSamples.append(stats.firstByteMs);
+        else
+            entry.firstByteSamples[entry.nextSample] = stats.firstByteMs;
+        entry.nextSample = (entry.nextSample + 1) % kFirstByteWindow;
+    }
+}
+
+double NetworkEngine::healthScore(const QString &origin) const {
+    const auto it = health.constFind(origin);
+    // No history: after every healthy endpoint, before recent failures.
+    constexpr double kUnknownScore = 1.0e6;
+    if (it == health.constEnd() || it->samples == 0)
+        return kUnknownScore;
+    double score = it->latencyMs * (1.0 + 4.0 * it->errorRate);
+    if (it->lastFailure.isValid() && it->lastFailure.elapsed() < kFailurePenaltyMs)
+        score += 2.0 * kUnknownScore;
+    return score;
+}
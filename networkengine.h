@@ -0,0 +1,118 @@
+#ifndef NETWORKENGINE_H
+#define NETWORKENGINE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QLoggingCategory>
+#include <QObject>
+#include <QSslConfiguration>
+#include <QString>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QNetworkRequest;
+class QTimer;
+
+Q_DECLARE_LOGGING_CATEGORY(lcNetwork)
+
+enum class DeadlineKind {
+    None,
+    Connect,
+    FirstByte,
+    Idle
+};
+
+struct RequestDeadlines {
+    int connectMs = 0;
+    int firstByteMs = 0;
+    int idleMs = 0;
+};
+
+struct ConnectionStats {
+    bool newConnection = false;
+    bool tlsHandshake = false;
+    bool http2 = false;
+    bool preconnected = false;
+    DeadlineKind expiredDeadline = DeadlineKind::None;
+    qint64 requestSentMs = -1;
+    qint64 firstByteMs = -1;
+    qint64 totalMs = -1;
+};
+
+/**
+ * @brief App-wide owner of QNetworkAccessManager instances.
+ *
+ *  One manager is kept per endpoint origin and proxy, so keep-alive
+ *  connections, HTTP/2 sessions and TLS session tickets survive between
+ *  tasks. Every reply is tracked to tell warm requests from requests that
+ *  had to open a socket or run a TLS handshake.
+ */
+class NetworkEngine : public QObject {
+    Q_OBJECT
+
+public:
+    static NetworkEngine *instance();
+
+    QNetworkReply *get(QNetworkRequest request, const QString &proxy);
+    QNetworkReply *post(QNetworkRequest request, const QByteArray &body, const QString &proxy);
+    /// Opens (and for https, handshakes) a connection ahead of the first request.
+    void preconnect(const QUrl &url, const QString &proxy);
+
+    /// Aborts the reply when one of the non-zero deadlines expires.
+    void watchDeadlines(QNetworkReply *reply, const RequestDeadlines &deadlines);
+
+    /// Valid until the reply is destroyed.
+    ConnectionStats connectionStats(const QNetworkReply *reply) const;
+
+    /// Indexes of urls, healthiest first. Endpoints without history keep
+    /// their relative order after healthy ones; recently failed ones go last.
+    QList<int> rankEndpoints(const QList<QUrl> &urls) const;
+
+    /// Quantile of recent successful time-to-first-byte samples for the
+    /// url's origin, or -1 while there are too few samples.
+    int firstByteQuantile(const QUrl &url, double quantile) const;
+
+signals:
+    void requestFinished(const QUrl &url, const ConnectionStats &stats);
+
+private:
+    explicit NetworkEngine(QObject *parent = nullptr);
+
+    struct TrackedReply {
+        QElapsedTimer timer;
+        ConnectionStats stats;
+        RequestDeadlines deadlines;
+        DeadlineKind pendingDeadline = DeadlineKind::None;
+        QTimer *deadlineTimer = nullptr;
+    };
+
+    struct EndpointHealth {
+        double latencyMs = 0.0;
+        double errorRate = 0.0;
+        int samples = 0;
+        QElapsedTimer lastFailure;
+        QList<qint64> firstByteSamples;
+        int nextSample = 0;
+    };
+
+    QHash<QString, QNetworkAccessManager *> managers;
+    QHash<QString, QByteArray> sessionTickets;
+    QHash<const QNetworkReply *, TrackedReply> trackedReplies;
+    QHash<QString, QElapsedTimer> preconnects;
+    QHash<QString, EndpointHealth> health;
+
+    static QString managerKey(const QUrl &url, const QString &proxy);
+    static QString originKey(const QUrl &url);
+    QNetworkAccessManager *managerFor(const QString &key, const QString &proxy);
+    QSslConfiguration sslConfiguration(const QString &key, QSslConfiguration base) const;
+    void prepareRequest(QNetworkRequest *request, const QString &key) const;
+    void track(QNetworkReply *reply, const QString &key);
+    void armDeadline(QNetworkReply *reply, DeadlineKind kind);
+    void recordHealth(const QNetworkReply *reply, const ConnectionStats &stats);
+    double healthScore(const QString &origin) const;
+};
+
+#endif // NETWORKENGINE_H
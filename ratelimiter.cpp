@@ -0,0 +1,250 @@
+#include "ratelimiter.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTimer>
+
+#include <climits>
+#include <cmath>
+#include <utility>
+
+namespace {
+constexpr qint64 kBaseBackoffMs = 1000;
+constexpr qint64 kMaxBackoffMs = 60000;
+// Refill assumed when a bucket is full and the reset time says nothing.
+constexpr qint64 kDefaultWindowMs = 60000;
+
+qint64 nowMs() {
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+// Parses "1s", "6m0s", "250ms", "1h2m3.5s", bare seconds or an absolute
+// RFC 3339 / HTTP date. Returns -1 when the value is not understood.
+qint64 parseResetMs(const QByteArray &raw, qint64 now) {
+    const QString value = QString::fromLatin1(raw).trimmed();
+    if (value.isEmpty())
+        return -1;
+    bool ok = false;
+    const double seconds = value.toDouble(&ok);
+    if (ok)
+        return seconds >= 0 ? qint64(seconds * 1000.0) : -1;
+
+    qint64 total = 0;
+    qsizetype pos = 0;
+    bool matched = false;
+    while (pos < value.size()) {
+        const qsizetype numberStart = pos;
+        while (pos < value.size() && (value.at(pos).isDigit() || value.at(pos) == u'.'))
+            ++pos;
+        const double amount = value.mid(numberStart, pos - numberStart).toDouble(&ok);
+        if (!ok)
+            break;
+        if (value.mid(pos, 2) == QLatin1String("ms")) {
+            total += qint64(amount);
+            pos += 2;
+        } else if (pos < value.size() && value.at(pos) == u'h') {
+            total += qint64(amount * 3600000.0);
+            ++pos;
+        } else if (pos < value.size() && value.at(pos) == u'm') {
+            total += qint64(amount * 60000.0);
+            ++pos;
+        } else if (pos < value.size() && value.at(pos) == u's') {
+            total += qint64(amount * 1000.0);
+            ++pos;
+        } else {
+            break;
+        }
+        matched = pos == value.size();
+    }
+    if (matched)
+        return total;
+
+    QDateTime at = QDateTime::fromString(value, Qt::ISODateWithMs);
+    if (!at.isValid())
+        at = QDateTime::fromString(value, Qt::RFC2822Date);
+    if (!at.isValid())
+        return -1;
+    return qMax<qint64>(0, at.toMSecsSinceEpoch() - now);
+}
+
+double headerNumber(const QNetworkReply *reply, const char *name) {
+    bool ok = false;
+    const double value = reply->rawHeader(name).trimmed().toDouble(&ok);
+    return ok ? value : -1.0;
+}
+
+QString formatWait(qint64 ms) {
+    if (ms >= 60000)
+        return QCoreApplication::translate("RateLimiter", "%1 min").arg((ms + 59999) / 60000);
+    return QCoreApplication::translate("RateLimiter", "%1 s").arg((ms + 999) / 1000);
+}
+} // namespace
+
+void RateLimiter::Bucket::refill(qint64 now) {
+    if (capacity < 0)
+        return;
+    available = qMin(capacity, available + double(now - updatedMs) * refillPerMs);
+    updatedMs = now;
+}
+
+qint64 RateLimiter::Bucket::waitFor(double amount, qint64 now) {
+    if (capacity < 0)
+        return 0;
+    refill(now);
+    // A single request larger than the bucket waits for a full bucket only.
+    const double needed = qMin(amount, capacity);
+    if (available >= needed)
+        return 0;
+    if (refillPerMs <= 0)
+        return kDefaultWindowMs;
+    return qint64(std::ceil((needed - available) / refillPerMs));
+}
+
+void RateLimiter::Bucket::observe(double limit, double remaining, qint64 resetMs, qint64 now) {
+    if (limit > 0)
+        capacity = limit;
+    if (capacity < 0 || remaining < 0)
+        return;
+    available = qMin(capacity, remaining);
+    updatedMs = now;
+    const double missing = capacity - available;
+    if (resetMs > 0 && missing > 0)
+        refillPerMs = missing / double(resetMs);
+    else if (refillPerMs <= 0)
+        refillPerMs = capacity / double(kDefaultWindowMs);
+}
+
+RateLimiter::RateLimiter(QObject *parent)
+    : QObject(parent)
+    , blockTimer(new QTimer(this)) {
+    blockTimer->setSingleShot(true);
+    connect(blockTimer, &QTimer::timeout, this, [this]() {
+        emit stateChanged();
+        scheduleBlockExpiry();
+    });
+}
+
+RateLimiter *RateLimiter::instance() {
+    static QPointer<RateLimiter> limiter;
+    if (!limiter)
+        limiter = new RateLimiter(QCoreApplication::instance());
+    return limiter;
+}
+
+qint64 RateLimiter::reserve(const QUrl &url, int tokens) {
+    OriginState &state = origins[originKey(url)];
+    const qint64 now = nowMs();
+    qint64 wait = qMax<qint64>(0, state.blockedUntilMs - now);
+    wait = qMax(wait, state.requests.waitFor(1.0, now));
+    wait = qMax(wait, state.tokens.waitFor(double(tokens), now));
+    if (wait > 0) {
+        emit stateChanged();
+        return wait;
+    }
+    if (state.requests.capacity >= 0)
+        state.requests.available -= 1.0;
+    if (state.tokens.capacity >= 0)
+        state.tokens.available = qMax(0.0, state.tokens.available - double(tokens));
+    return 0;
+}
+
+void RateLimiter::observe(QNetworkReply *reply) {
+    if (!reply)
+        return;
+    const qint64 now = nowMs();
+    OriginState &state = origins[originKey(reply->url())];
+    state.requests.observe(headerNumber(reply, "x-ratelimit-limit-requests"),
+                           headerNumber(reply, "x-ratelimit-remaining-requests"),
+                           parseResetMs(reply->rawHeader("x-ratelimit-reset-requests"), now),
+                           now);
+    state.tokens.observe(headerNumber(reply, "x-ratelimit-limit-tokens"),
+                         headerNumber(reply, "x-ratelimit-remaining-tokens"),
+                         parseResetMs(reply->rawHeader("x-ratelimit-reset-tokens"), now),
+                         now);
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    qint64 retryAfterMs = -1;
+    if (reply->hasRawHeader("retry-after-ms"))
+        retryAfterMs = qint64(headerNumber(reply, "retry-after-ms"));
+    else if (reply->hasRawHeader("Retry-After"))
+        retryAfterMs = parseResetMs(reply->rawHeader("Retry-After"), now);
+
+    if (status == 429) {
+        ++state.rateLimitedReplies;
+        if (retryAfterMs < 0)
+            retryAfterMs = parseResetMs(reply->rawHeader("x-ratelimit-reset-requests"), now);
+        if (retryAfterMs < 0)
+            retryAfterMs = parseResetMs(reply->rawHeader("x-ratelimit-reset-tokens"), now);
+    } else if (status > 0 && status < 400) {
+        state.rateLimitedReplies = 0;
+    }
+    if (retryAfterMs > 0 && (status == 429 || status == 503))
+        state.blockedUntilMs = qMax(state.blockedUntilMs, now + retryAfterMs);
+    scheduleBlockExpiry();
+    emit stateChanged();
+}
+
+qint64 RateLimiter::retryDelay(const QUrl &url) {
+    OriginState &state = origins[originKey(url)];
+    const int attempt = qBound(1, state.rateLimitedReplies, 16);
+    // Half fixed, half random: retries from several windows do not line up.
+    const qint64 ceiling = qMin(kMaxBackoffMs, kBaseBackoffMs << (attempt - 1));
+    const qint64 jittered = ceiling / 2 + QRandomGenerator::global()->bounded(ceiling / 2 + 1);
+    const qint64 blocked = state.blockedUntilMs - nowMs();
+    return qMax(jittered, blocked);
+}
+
+QString RateLimiter::summary() const {
+    QStringList lines;
+    const qint64 now = nowMs();
+    for (auto it = origins.constBegin(); it != origins.constEnd(); ++it) {
+        const OriginState &state = it.value();
+        const QString host = QUrl(it.key()).host();
+        if (state.blockedUntilMs > now) {
+            lines.append(tr("%1: rate limited, retry in %2")
+                             .arg(host, formatWait(state.blockedUntilMs - now)));
+            continue;
+        }
+        QStringList parts;
+        if (state.requests.capacity >= 0) {
+            Bucket requests = state.requests;
+            requests.refill(now);
+            parts.append(tr("%1/%2 requests")
+                             .arg(qint64(requests.available))
+                             .arg(qint64(requests.capacity)));
+        }
+        if (state.tokens.capacity >= 0) {
+            Bucket tokens = state.tokens;
+            tokens.refill(now);
+            parts.append(tr("%1/%2 tokens")
+                             .arg(qint64(tokens.available))
+                             .arg(qint64(tokens.capacity)));
+        }
+        if (!parts.isEmpty())
+            lines.append(host + ": " + parts.join(", "));
+    }
+    return lines.join('\n');
+}
+
+void RateLimiter::scheduleBlockExpiry() {
+    const qint64 now = nowMs();
+    qint64 nextExpiry = 0;
+    for (const OriginState &state : std::as_const(origins)) {
+        if (state.blockedUntilMs > now && (nextExpiry == 0 || state.blockedUntilMs < nextExpiry))
+            nextExpiry = state.blockedUntilMs;
+    }
+    if (nextExpiry == 0)
+        blockTimer->stop();
+    else
+        blockTimer->start(int(qMin<qint64>(nextExpiry - now, INT_MAX)));
+}
+
+QString RateLimiter::originKey(const QUrl &url) {
+    return url.adjusted(QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment
+                        | QUrl::RemoveUserInfo).toString();
+}
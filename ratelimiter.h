@@ -0,0 +1,71 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+
+class QNetworkReply;
+class QTimer;
+
+/**
+ * @brief Client-side rate limiting per endpoint origin.
+ *
+ *  Two token buckets are kept per origin, one for requests and one for
+ *  LLM tokens, and both are resynchronized from the provider's
+ *  x-ratelimit-* headers on every reply. A 429 or Retry-After blocks the
+ *  origin until the given time. Callers reserve capacity before sending
+ *  and wait for the returned delay instead of failing the request.
+ */
+class RateLimiter : public QObject {
+    Q_OBJECT
+
+public:
+    static RateLimiter *instance();
+
+    /// Returns 0 and consumes capacity when the request may go now,
+    /// otherwise the number of milliseconds to wait before asking again.
+    qint64 reserve(const QUrl &url, int tokens);
+    /// Reads rate-limit headers; call once the reply headers are available.
+    void observe(QNetworkReply *reply);
+    /// Delay before retrying a request that got 429, with jittered backoff.
+    qint64 retryDelay(const QUrl &url);
+
+    /// One line per limited origin, for the tray tooltip.
+    QString summary() const;
+
+signals:
+    void stateChanged();
+
+private:
+    explicit RateLimiter(QObject *parent = nullptr);
+
+    struct Bucket {
+        double capacity = -1.0; // unknown until the provider reports a limit
+        double available = 0.0;
+        double refillPerMs = 0.0;
+        qint64 updatedMs = 0;
+
+        void refill(qint64 now);
+        qint64 waitFor(double amount, qint64 now);
+        void observe(double limit, double remaining, qint64 resetMs, qint64 now);
+    };
+
+    struct OriginState {
+        Bucket requests;
+        Bucket tokens;
+        qint64 blockedUntilMs = 0;
+        int rateLimitedReplies = 0;
+    };
+
+    QHash<QString, OriginState> origins;
+    // Fires when the earliest block ends, so the tooltip does not keep
+    // showing a limit that has already expired.
+    QTimer *blockTimer;
+
+    void scheduleBlockExpiry();
+    static QString originKey(const QUrl &url);
+};
+
+#endif // RATELIMITER_H
@@ -0,0 +1,75 @@
+#include "replyattempt.h"
+#include "deltaextractor.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+void appendStreamDelta(const SseEvent &event, QString *text) {
+    if (event.data.isEmpty() || event.data == "[DONE]")
+        return;
+    *text += DeltaExtractor::extractContent(event.data);
+}
+
+QString extractResponseTextFromJson(const QByteArray &data) {
+    const QJsonDocument respDoc = QJsonDocument::fromJson(data);
+    if (!respDoc.isObject())
+        return QString();
+    const QJsonObject respObj = respDoc.object();
+    const QJsonArray choices = respObj.value("choices").toArray();
+    if (choices.isEmpty())
+        return QString();
+    const QJsonObject msg = choices.first().toObject()
+        .value("message")
+        .toObject();
+    return msg.value("content").toString();
+}
+} // namespace
+
+void ReplyAttempt::feed(QByteArrayView chunk, const QByteArray &contentType, QString *text) {
+    if (chunk.isEmpty())
+        return;
+    if (replyFormat != ReplyFormat::EventStream)
+        responseBody.append(chunk.data(), chunk.size());
+    if (replyFormat == ReplyFormat::Unknown)
+        detectFormat(contentType);
+    if (replyFormat == ReplyFormat::Json)
+        return;
+
+    streamParser.feed(chunk, [text](const SseEvent &event) {
+        appendStreamDelta(event, text);
+    });
+
+    if (replyFormat == ReplyFormat::Unknown && streamParser.sawData()) {
+        // Raw bytes are only needed for the JSON fallback.
+        replyFormat = ReplyFormat::EventStream;
+        responseBody = QByteArray();
+    }
+}
+
+void ReplyAttempt::finish(bool failed, QString *text) {
+    if (replyFormat != ReplyFormat::Json) {
+        streamParser.finish([text](const SseEvent &event) {
+            appendStreamDelta(event, text);
+        });
+    }
+    if (!failed && replyFormat != ReplyFormat::EventStream && text->isEmpty())
+        *text = extractResponseTextFromJson(responseBody);
+    responseBody = QByteArray();
+}
+
+void ReplyAttempt::detectFormat(const QByteArray &contentType) {
+    if (contentType.contains("text/event-stream")) {
+        replyFormat = ReplyFormat::EventStream;
+        responseBody = QByteArray();
+        return;
+    }
+    if (contentType.contains("json")) {
+        replyFormat = ReplyFormat::Json;
+        return;
+    }
+    const QByteArray head = responseBody.left(64).trimmed();
+    if (head.startsWith('{') || head.startsWith('['))
+        replyFormat = ReplyFormat::Json;
+}
@@ -0,0 +1,51 @@
+#ifndef REPLYATTEMPT_H
+#define REPLYATTEMPT_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+
+#include "configstore.h"
+#include "ssestreamparser.h"
+
+enum class ReplyFormat {
+    Unknown,
+    EventStream,
+    Json
+};
+
+/**
+ * @brief State of one reply while it competes with hedged replies.
+ *
+ *  Raw bytes are kept only until the format is known: an event stream is
+ *  decoded as it arrives, and only a plain JSON reply is buffered whole.
+ */
+struct ReplyAttempt {
+    SseStreamParser streamParser;
+    QByteArray responseBody;
+    ReplyFormat replyFormat = ReplyFormat::Unknown;
+    QString text;
+    EndpointConfig endpoint;
+    QString label;
+    QString model; // empty unless a hedge overrides the task model
+    bool hedge = false;
+
+    /**
+     * Decodes a chunk and appends any new answer text to @p text.
+     * @p contentType is the lowercased Content-Type header; it is only read
+     * while the format is still unknown.
+     */
+    void feed(QByteArrayView chunk, const QByteArray &contentType, QString *text);
+    /// Flushes the stream, or decodes a buffered JSON reply when @p failed is false.
+    void finish(bool failed, QString *text);
+
+    /// Bytes held besides the decoded text.
+    qsizetype bufferedBytes() const {
+        return responseBody.capacity() + streamParser.bufferedBytes();
+    }
+
+private:
+    void detectFormat(const QByteArray &contentType);
+};
+
+#endif // REPLYATTEMPT_H
@@ -0,0 +1,420 @@
+#include "responsecache.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <utility>
+
+Q_LOGGING_CATEGORY(lcCache, "dlh.cache")
+
+namespace {
+constexpr quint32 kIndexMagic = 0x58444C44; // "DLDX"
+constexpr quint32 kRecordMagic = 0x52444C44; // "DLDR"
+constexpr quint32 kIndexVersion = 1;
+constexpr int kKeySize = 16;
+constexpr quint32 kMinCapacity = 1024;
+// Compaction keeps this share of maxBytes so it does not rerun on the next insert.
+constexpr double kCompactTarget = 0.75;
+
+struct RecordHeader {
+    quint32 magic;
+    quint32 length;
+    uchar key[kKeySize];
+    qint64 createdMs;
+};
+static_assert(sizeof(RecordHeader) == 32, "record layout is part of the file format");
+
+QString cacheDir() {
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                        + QDir::separator() + "responses";
+    QDir().mkpath(dir);
+    return dir;
+}
+
+quint64 keyHash(const uchar *key) {
+    quint64 hash = 0;
+    std::memcpy(&hash, key, sizeof(hash));
+    return hash;
+}
+} // namespace
+
+struct ResponseCache::IndexHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 capacity;
+    quint32 count;
+    qint64 logSize;
+    qint64 reserved;
+};
+
+struct ResponseCache::IndexSlot {
+    uchar key[kKeySize];
+    qint64 offset; // of the record header in the log
+    qint64 createdMs;
+    qint64 lastUsedMs;
+    quint32 length;
+    quint32 used;
+};
+
+ResponseCache *ResponseCache::instance() {
+    static ResponseCache cache;
+    return &cache;
+}
+
+ResponseCache::ResponseCache() {
+    pool.setMaxThreadCount(1);
+    // The instance outlives the application; finish queued writes while
+    // the event loop and Qt are still up.
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        QObject::connect(app, &QCoreApplication::aboutToQuit, app, [this]() {
+            pool.waitForDone();
+        });
+    }
+}
+
+ResponseCache::~ResponseCache() {
+    pool.waitForDone();
+    close();
+}
+
+QByteArray ResponseCache::makeKey(const QString &endpoint,
+                                  const QString &model,
+                                  const QJsonArray &messages,
+                                  int maxTokens,
+                                  double temperature) {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(endpoint.toUtf8());
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(model.toUtf8());
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(QJsonDocument(messages).toJson(QJsonDocument::Compact));
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(QByteArray::number(maxTokens));
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(QByteArray::number(temperature, 'g', 17));
+    return hash.result().left(kKeySize);
+}
+
+void ResponseCache::setLimits(qint64 maxBytes, qint64 ttlMs) {
+    this->maxBytes = qMax<qint64>(1024 * 1024, maxBytes);
+    this->ttlMs = qMax<qint64>(0, ttlMs);
+}
+
+bool ResponseCache::lookup(const QByteArray &key, QString *text) {
+    if (key.size() != kKeySize)
+        return false;
+    // Waiting out a compaction would cost more than asking the endpoint.
+    std::unique_lock<QMutex> locker(mutex, std::try_to_lock);
+    if (!locker.owns_lock()) {
+        qCDebug(lcCache) << "lookup skipped while the cache is being written";
+        return false;
+    }
+    if (!ensureOpen())
+        return false;
+    IndexSlot *slot = findSlot(key, false);
+    if (!slot)
+        return false;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (isExpired(*slot, now))
+        return false;
+    QByteArray payload;
+    if (!readPayload(*slot, &payload))
+        return false;
+    slot->lastUsedMs = now;
+    *text = QString::fromUtf8(payload);
+    return true;
+}
+
+void ResponseCache::insert(const QByteArray &key, const QString &text) {
+    if (key.size() != kKeySize || text.isEmpty())
+        return;
+    pool.start([this, key, text]() {
+        QMutexLocker locker(&mutex);
+        append(key, text.toUtf8());
+    });
+}
+
+void ResponseCache::append(const QByteArray &key, const QByteArray &payload) {
+    if (payload.size() > maxBytes / 4 || !ensureOpen())
+        return;
+
+    RecordHeader record = {};
+    record.magic = kRecordMagic;
+    record.length = quint32(payload.size());
+    std::memcpy(record.key, key.constData(), kKeySize);
+    record.createdMs = QDateTime::currentMSecsSinceEpoch();
+
+    const qint64 offset = logFile.size();
+    if (!logFile.seek(offset)
+        || logFile.write(reinterpret_cast<const char *>(&record), sizeof(record)) != sizeof(record)
+        || logFile.write(payload) != payload.size()
+        || !logFile.flush()) {
+        qCWarning(lcCache) << "cannot append to" << logFile.fileName() << logFile.errorString();
+        return;
+    }
+
+    if (header()->count + 1 > header()->capacity / 10 * 7 && !growIndex())
+        return;
+    storeSlot(key, offset, record.length, record.createdMs, record.createdMs);
+    header()->logSize = logFile.size();
+
+    if (header()->logSize > maxBytes)
+        compact();
+}
+
+bool ResponseCache::ensureOpen() {
+    if (opened)
+        return true;
+    if (failed)
+        return false;
+    const QString dir = cacheDir();
+    logFile.setFileName(dir + QDir::separator() + "responses.log");
+    indexFile.setFileName(dir + QDir::separator() + "responses.idx");
+    if (!logFile.open(QIODevice::ReadWrite) || !indexFile.open(QIODevice::ReadWrite)) {
+        qCWarning(lcCache) << "cache disabled:" << logFile.errorString() << indexFile.errorString();
+        close();
+        failed = true;
+        return false;
+    }
+
+    bool valid = indexFile.size() >= qint64(sizeof(IndexHeader));
+    if (valid) {
+        indexMap = indexFile.map(0, indexFile.size());
+        const IndexHeader *head = indexMap ? header() : nullptr;
+        valid = head && head->magic == kIndexMagic && head->version == kIndexVersion
+                && indexFile.size() == qint64(sizeof(IndexHeader))
+                                           + qint64(head->capacity) * qint64(sizeof(IndexSlot))
+                && head->logSize <= logFile.size();
+    }
+    if (!valid && !rebuildIndex()) {
+        close();
+        failed = true;
+        return false;
+    }
+    // Records appended after the index was last updated, e.g. after a crash.
+    if (header()->logSize < logFile.size() && !scanLog(header()->logSize)) {
+        close();
+        failed = true;
+        return false;
+    }
+    opened = true;
+    return true;
+}
+
+void ResponseCache::close() {
+    if (indexMap) {
+        indexFile.unmap(indexMap);
+        indexMap = nullptr;
+    }
+    indexFile.close();
+    logFile.close();
+    opened = false;
+}
+
+bool ResponseCache::createIndex(quint32 capacity) {
+    if (indexMap) {
+        indexFile.unmap(indexMap);
+        indexMap = nullptr;
+    }
+    const qint64 size = qint64(sizeof(IndexHeader)) + qint64(capacity) * qint64(sizeof(IndexSlot));
+    // resize() keeps old bytes, so clear the file first.
+    if (!indexFile.resize(0) || !indexFile.resize(size)) {
+        qCWarning(lcCache) << "cannot resize" << indexFile.fileName() << indexFile.errorString();
+        return false;
+    }
+    indexMap = indexFile.map(0, size);
+    if (!indexMap) {
+        qCWarning(lcCache) << "cannot map" << indexFile.fileName() << indexFile.errorString();
+        return false;
+    }
+    std::memset(indexMap, 0, size_t(size));
+    IndexHeader *head = header();
+    head->magic = kIndexMagic;
+    head->version = kIndexVersion;
+    head->capacity = capacity;
+    return true;
+}
+
+bool ResponseCache::rebuildIndex() {
+    return createIndex(kMinCapacity) && scanLog(0);
+}
+
+bool ResponseCache::scanLog(qint64 from) {
+    qint64 offset = from;
+    RecordHeader record;
+    while (logFile.seek(offset)
+           && logFile.read(reinterpret_cast<char *>(&record), sizeof(record)) == sizeof(record)) {
+        const qint64 end = offset + qint64(sizeof(record)) + record.length;
+        if (record.magic != kRecordMagic || end > logFile.size())
+            break;
+        if (header()->count + 1 > header()->capacity / 10 * 7 && !growIndex())
+            return false;
+        storeSlot(QByteArray(reinterpret_cast<const char *>(record.key), kKeySize),
+                  offset, record.length, record.createdMs, record.createdMs);
+        offset = end;
+    }
+    // A torn record at the end is dropped; later appends start after the valid part.
+    if (offset < logFile.size())
+        logFile.resize(offset);
+    header()->logSize = offset;
+    return true;
+}
+
+bool ResponseCache::growIndex() {
+    const QList<IndexSlot> entries = liveSlots();
+    const qint64 logSize = header()->logSize;
+    if (!createIndex(header()->capacity * 2)) {
+        close();
+        failed = true;
+        return false;
+    }
+    for (const IndexSlot &entry : entries) {
+        storeSlot(QByteArray(reinterpret_cast<const char *>(entry.key), kKeySize),
+                  entry.offset, entry.length, entry.createdMs, entry.lastUsedMs);
+    }
+    header()->logSize = logSize;
+    return true;
+}
+
+void ResponseCache::compact() {
+    QList<IndexSlot> entries = liveSlots();
+    std::sort(entries.begin(), entries.end(), [](const IndexSlot &a, const IndexSlot &b) {
+        return a.lastUsedMs > b.lastUsedMs;
+    });
+
+    const qint64 budget = qint64(maxBytes * kCompactTarget);
+    QFile compacted(logFile.fileName() + ".tmp");
+    if (!compacted.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(lcCache) << "cannot compact:" << compacted.errorString();
+        return;
+    }
+    QList<IndexSlot> kept;
+    qint64 written = 0;
+    for (IndexSlot entry : std::as_const(entries)) {
+        const qint64 recordSize = qint64(sizeof(RecordHeader)) + entry.length;
+        if (written + recordSize > budget)
+            break;
+        if (!logFile.seek(entry.offset))
+            continue;
+        const QByteArray record = logFile.read(recordSize);
+        if (record.size() != recordSize || compacted.write(record) != recordSize)
+            continue;
+        entry.offset = written;
+        written += recordSize;
+        kept.append(entry);
+    }
+    if (!compacted.flush()) {
+        compacted.remove();
+        return;
+    }
+    compacted.close();
+
+    const QString logPath = logFile.fileName();
+    const QString indexPath = indexFile.fileName();
+    const qint64 before = header()->logSize;
+    close();
+    if (!QFile::remove(logPath) || !compacted.rename(logPath)) {
+        qCWarning(lcCache) << "cannot replace" << logPath;
+        failed = true;
+        return;
+    }
+    QFile::remove(indexPath);
+    if (!logFile.open(QIODevice::ReadWrite) || !indexFile.open(QIODevice::ReadWrite)) {
+        close();
+        failed = true;
+        return;
+    }
+
+    quint32 capacity = kMinCapacity;
+    while (qsizetype(capacity) / 10 * 7 < kept.size())
+        capacity *= 2;
+    if (!createIndex(capacity)) {
+        close();
+        failed = true;
+        return;
+    }
+    for (const IndexSlot &entry : std::as_const(kept)) {
+        storeSlot(QByteArray(reinterpret_cast<const char *>(entry.key), kKeySize),
+                  entry.offset, entry.length, entry.createdMs, entry.lastUsedMs);
+    }
+    header()->logSize = written;
+    opened = true;
+    qCDebug(lcCache) << "compacted" << before << "->" << written << "bytes," << kept.size()
+                     << "entries";
+}
+
+ResponseCache::IndexHeader *ResponseCache::header() const {
+    return reinterpret_cast<IndexHeader *>(indexMap);
+}
+
+ResponseCache::IndexSlot *ResponseCache::slotTable() const {
+    return reinterpret_cast<IndexSlot *>(indexMap + sizeof(IndexHeader));
+}
+
+ResponseCache::IndexSlot *ResponseCache::findSlot(const QByteArray &key, bool forInsert) const {
+    const quint32 capacity = header()->capacity;
+    const auto *keyBytes = reinterpret_cast<const uchar *>(key.constData());
+    // Capacity is a power of two and the table is never full.
+    quint32 index = quint32(keyHash(keyBytes)) & (capacity - 1);
+    for (quint32 probe = 0; probe < capacity; ++probe) {
+        IndexSlot *slot = slotTable() + index;
+        if (!slot->used)
+            return forInsert ? slot : nullptr;
+        if (std::memcmp(slot->key, keyBytes, kKeySize) == 0)
+            return slot;
+        index = (index + 1) & (capacity - 1);
+    }
+    return nullptr;
+}
+
+void ResponseCache::storeSlot(const QByteArray &key, qint64 offset, quint32 length,
+                              qint64 createdMs, qint64 lastUsedMs) {
+    IndexSlot *slot = findSlot(key, true);
+    if (!slot)
+        return;
+    if (!slot->used) {
+        std::memcpy(slot->key, key.constData(), kKeySize);
+        slot->used = 1;
+        ++header()->count;
+    }
+    slot->offset = offset;
+    slot->length = length;
+    slot->createdMs = createdMs;
+    slot->lastUsedMs = lastUsedMs;
+}
+
+bool ResponseCache::readPayload(const IndexSlot &slot, QByteArray *payload) {
+    RecordHeader record;
+    if (!logFile.seek(slot.offset)
+        || logFile.read(reinterpret_cast<char *>(&record), sizeof(record)) != sizeof(record)
+        || record.magic != kRecordMagic || record.length != slot.length
+        || std::memcmp(record.key, slot.key, kKeySize) != 0) {
+        return false;
+    }
+    *payload = logFile.read(record.length);
+    return payload->size() == qsizetype(record.length);
+}
+
+bool ResponseCache::isExpired(const IndexSlot &slot, qint64 now) const {
+    return ttlMs > 0 && now - slot.createdMs > ttlMs;
+}
+
+QList<ResponseCache::IndexSlot> ResponseCache::liveSlots() const {
+    QList<IndexSlot> entries;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const IndexSlot *begin = slotTable();
+    const IndexSlot *end = begin + header()->capacity;
+    for (const IndexSlot *slot = begin; slot != end; ++slot) {
+        if (slot->used && !isExpired(*slot, now))
+            entries.append(*slot);
+    }
+    return entries;
+}
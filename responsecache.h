@@ -0,0 +1,87 @@
+#ifndef RESPONSECACHE_H
+#define RESPONSECACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QJsonArray>
+#include <QList>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+#include <atomic>
+
+Q_DECLARE_LOGGING_CATEGORY(lcCache)
+
+/**
+ * @brief Disk-backed LRU cache of final LLM answers.
+ *
+ *  Answers are appended to a log file and located through a fixed-size
+ *  open-addressing hash table kept in a memory-mapped index file, so a
+ *  lookup is one probe sequence in mapped memory plus one read from the
+ *  log. Replaced and expired records stay in the log until it outgrows
+ *  the size limit; the log is then rewritten with the most recently used
+ *  entries only.
+ *
+ *  Inserts, and the compactions they trigger, run on a single worker
+ *  thread. A lookup made while the worker holds the files is a miss
+ *  rather than a wait.
+ */
+class ResponseCache {
+public:
+    static ResponseCache *instance();
+
+    /// 16-byte key over everything that determines a deterministic answer.
+    static QByteArray makeKey(const QString &endpoint,
+                              const QString &model,
+                              const QJsonArray &messages,
+                              int maxTokens,
+                              double temperature);
+
+    /// maxBytes bounds the log file; ttlMs of 0 keeps entries until evicted.
+    void setLimits(qint64 maxBytes, qint64 ttlMs);
+    bool lookup(const QByteArray &key, QString *text);
+    /// Queues the answer for the worker thread and returns immediately.
+    void insert(const QByteArray &key, const QString &text);
+
+private:
+    ResponseCache();
+    ~ResponseCache();
+    ResponseCache(const ResponseCache &) = delete;
+    ResponseCache &operator=(const ResponseCache &) = delete;
+
+    struct IndexHeader;
+    struct IndexSlot;
+
+    QThreadPool pool;
+    // Guards the files and the mapped index below.
+    QMutex mutex;
+    QFile logFile;
+    QFile indexFile;
+    uchar *indexMap = nullptr;
+    bool opened = false;
+    bool failed = false;
+    std::atomic<qint64> maxBytes = 64 * 1024 * 1024;
+    std::atomic<qint64> ttlMs = 0;
+
+    void append(const QByteArray &key, const QByteArray &payload);
+    bool ensureOpen();
+    void close();
+    bool createIndex(quint32 capacity);
+    bool rebuildIndex();
+    bool scanLog(qint64 from);
+    bool growIndex();
+    void compact();
+
+    IndexHeader *header() const;
+    IndexSlot *slotTable() const;
+    IndexSlot *findSlot(const QByteArray &key, bool forInsert) const;
+    void storeSlot(const QByteArray &key, qint64 offset, quint32 length,
+                   qint64 createdMs, qint64 lastUsedMs);
+    bool readPayload(const IndexSlot &slot, QByteArray *payload);
+    bool isExpired(const IndexSlot &slot, qint64 now) const;
+    QList<IndexSlot> liveSlots() const;
+};
+
+#endif // RESPONSECACHE_H
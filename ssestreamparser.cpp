@@ -0,0 +1,153 @@
+#include "ssestreamparser.h"
+
+void SseStreamParser::feed(QByteArrayView chunk, const EventHandler &handler) {
+    if (chunk.isEmpty())
+        return;
+
+    compact();
+    buffer.append(chunk.data(), chunk.size());
+
+    const char *data = buffer.constData();
+    const qsizetype size = buffer.size();
+
+    if (skipLeadingLf) {
+        skipLeadingLf = false;
+        if (data[cursor] == '\n')
+            ++cursor;
+        if (scanPos < cursor)
+            scanPos = cursor;
+    }
+
+    qsizetype pos = scanPos;
+    while (pos < size) {
+        const char c = data[pos];
+        if (c != '\n' && c != '\r') {
+            ++pos;
+            continue;
+        }
+        processLine(cursor, pos, handler);
+        if (c == '\r') {
+            if (pos + 1 < size) {
+                if (data[pos + 1] == '\n')
+                    ++pos;
+            } else {
+                skipLeadingLf = true;
+            }
+        }
+        cursor = pos + 1;
+        pos = cursor;
+        if (dataLines == 0 && typeSpan.start < 0 && idSpan.start < 0)
+            eventStart = cursor;
+    }
+    scanPos = pos;
+}
+
+void SseStreamParser::finish(const EventHandler &handler) {
+    if (cursor < buffer.size()) {
+        processLine(cursor, buffer.size(), handler);
+        cursor = buffer.size();
+    }
+    dispatch(handler);
+    const bool seen = dataSeen;
+    reset();
+    dataSeen = seen;
+}
+
+void SseStreamParser::reset() {
+    buffer.clear();
+    cursor = 0;
+    scanPos = 0;
+    eventStart = 0;
+    skipLeadingLf = false;
+    dataSeen = false;
+    clearEvent();
+}
+
+void SseStreamParser::processLine(qsizetype start, qsizetype end, const EventHandler &handler) {
+    if (start == end) {
+        dispatch(handler);
+        return;
+    }
+
+    const QByteArrayView line(buffer.constData() + start, end - start);
+    if (line.front() == ':')
+        return;
+
+    qsizetype colon = line.indexOf(':');
+    QByteArrayView field = line;
+    Span value{end, 0};
+    if (colon >= 0) {
+        field = line.first(colon);
+        qsizetype valueStart = start + colon + 1;
+        if (valueStart < end && buffer.at(valueStart) == ' ')
+            ++valueStart;
+        value = Span{valueStart, end - valueStart};
+    }
+
+    if (field == "data") {
+        dataSeen = true;
+        if (dataLines == 0) {
+            dataSpan = value;
+        } else {
+            if (dataLines == 1)
+                joinedData = view(dataSpan).toByteArray();
+            joinedData.append('\n');
+            joinedData.append(view(value));
+        }
+        ++dataLines;
+    } else if (field == "event") {
+        typeSpan = value;
+    } else if (field == "id") {
+        if (!view(value).contains('\0'))
+            idSpan = value;
+    }
+}
+
+void SseStreamParser::dispatch(const EventHandler &handler) {
+    if (dataLines > 0 && handler) {
+        SseEvent event;
+        event.type = view(typeSpan);
+        event.id = view(idSpan);
+        event.data = dataLines > 1 ? QByteArrayView(joinedData) : view(dataSpan);
+        handler(event);
+    }
+    clearEvent();
+}
+
+void SseStreamParser::clearEvent() {
+    typeSpan = Span();
+    idSpan = Span();
+    dataSpan = Span();
+    dataLines = 0;
+    joinedData.clear();
+}
+
+void SseStreamParser::compact() {
+    if (eventStart == 0)
+        return;
+    if (eventStart == buffer.size()) {
+        buffer.truncate(0);
+        cursor = 0;
+        scanPos = 0;
+        eventStart = 0;
+        return;
+    }
+    if (eventStart < buffer.size() / 2)
+        return;
+
+    const qsizetype shift = eventStart;
+    buffer.remove(0, shift);
+    cursor -= shift;
+    scanPos -= shift;
+    eventStart = 0;
+    for (Span *span : {&typeSpan, &idSpan, &dataSpan}) {
+        if (span->start >= 0)
+            span->start -= shift;
+    }
+}
+
+QByteArrayView SseStreamParser::view(const Span &span) const {
+    if (span.start < 0 || span.length <= 0)
+        return QByteArrayView();
+    return QByteArrayView(buffer.constData() + span.start, span.length);
+}
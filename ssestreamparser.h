@@ -0,0 +1,65 @@
+#ifndef SSESTREAMPARSER_H
+#define SSESTREAMPARSER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+#include <functional>
+
+struct SseEvent {
+    QByteArrayView type;
+    QByteArrayView id;
+    QByteArrayView data;
+};
+
+/**
+ * @brief Incremental text/event-stream parser.
+ *
+ *  Chunks are appended to one buffer and scanned with a read cursor, so
+ *  every byte is visited once. Consumed bytes are dropped only after more
+ *  than half of the buffer has been read, which keeps compaction amortized
+ *  O(1) per byte. Event fields are handed out as views into the buffer and
+ *  stay valid only for the duration of the handler call; multi-line data
+ *  is the only case that needs a copy.
+ */
+class SseStreamParser {
+public:
+    using EventHandler = std::function<void(const SseEvent &)>;
+
+    void feed(QByteArrayView chunk, const EventHandler &handler);
+    /// Dispatches an event left without a terminating blank line at EOF.
+    void finish(const EventHandler &handler);
+    void reset();
+
+    /// true once at least one "data:" field has been seen.
+    bool sawData() const { return dataSeen; }
+    /// Bytes reserved for unread and partially read events.
+    qsizetype bufferedBytes() const { return buffer.capacity() + joinedData.capacity(); }
+
+private:
+    struct Span {
+        qsizetype start = -1;
+        qsizetype length = 0;
+    };
+
+    QByteArray buffer;
+    qsizetype cursor = 0;
+    qsizetype scanPos = 0;
+    qsizetype eventStart = 0;
+    bool skipLeadingLf = false;
+    bool dataSeen = false;
+
+    Span typeSpan;
+    Span idSpan;
+    Span dataSpan;
+    int dataLines = 0;
+    QByteArray joinedData;
+
+    void processLine(qsizetype start, qsizetype end, const EventHandler &handler);
+    void dispatch(const EventHandler &handler);
+    void clearEvent();
+    void compact();
+    QByteArrayView view(const Span &span) const;
+};
+
+#endif // SSESTREAMPARSER_H
@@ -0,0 +1,189 @@
+#include "taskfilter.h"
+
+#include <QDateTime>
+#include <QPair>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <utility>
+
+namespace {
+constexpr int kMatchScore = 16;
+constexpr int kWordStartBonus = 12;
+constexpr int kRunBonus = 8;
+constexpr int kPrefixBonus = 8;
+constexpr int kGapPenalty = 1;
+// A task used 16 times today gets about one word start's worth of bonus;
+// the bonus halves every two weeks without use.
+constexpr double kUsageWeight = 3.0;
+constexpr double kUsageHalfLifeDays = 14.0;
+constexpr qint64 kMsPerDay = 24 * 3600 * 1000;
+
+bool isWordStart(QStringView text, qsizetype i) {
+    if (i == 0)
+        return true;
+    const QChar prev = text.at(i - 1);
+    const QChar cur = text.at(i);
+    if (!prev.isLetterOrNumber())
+        return cur.isLetterOrNumber();
+    return prev.isLower() && cur.isUpper();
+}
+}
+
+void TaskFilter::setTasks(const QStringList &taskNames) {
+    names = taskNames;
+    entries.clear();
+    entries.reserve(names.size());
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < names.size(); ++i) {
+        const QString &name = names.at(i);
+        Entry entry;
+        entry.folded = name.toCaseFolded();
+        entry.wordStarts.resize(name.size());
+        for (qsizetype c = 0; c < name.size(); ++c)
+            entry.wordStarts[c] = isWordStart(name, c) ? 1 : 0;
+        entry.charMask = charMask(entry.folded);
+        entries.append(entry);
+        updateUsageBonus(i, now);
+    }
+    lastQuery.clear();
+    lastMatches.clear();
+}
+
+void TaskFilter::setUsage(const QHash<QString, Usage> &usage) {
+    usageByName = usage;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < entries.size(); ++i)
+        updateUsageBonus(i, now);
+}
+
+void TaskFilter::recordUse(int task) {
+    if (task < 0 || task >= names.size())
+        return;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    Usage &usage = usageByName[names.at(task)];
+    ++usage.count;
+    usage.lastUsedMs = now;
+    updateUsageBonus(task, now);
+}
+
+QList<int> TaskFilter::filter(const QString &query) {
+    const QString folded = query.toCaseFolded();
+    QList<int> matches;
+    if (folded.isEmpty()) {
+        matches.reserve(entries.size());
+        for (int i = 0; i < entries.size(); ++i)
+            matches.append(i);
+        lastQuery.clear();
+        lastMatches = matches;
+        return matches;
+    }
+
+    // Every match of the longer query is also a match of its prefix.
+    QList<int> candidates;
+    const bool narrowing = !lastQuery.isEmpty() && folded.startsWith(lastQuery);
+    if (!narrowing) {
+        candidates.reserve(entries.size());
+        for (int i = 0; i < entries.size(); ++i)
+            candidates.append(i);
+    }
+    const QList<int> &scan = narrowing ? lastMatches : candidates;
+
+    const quint64 mask = charMask(folded);
+    QList<QPair<int, int>> scored;
+    for (int task : scan) {
+        const Entry &entry = entries.at(task);
+        if ((entry.charMask & mask) != mask)
+            continue;
+        const int score = matchScore(entry, folded);
+        if (score != INT_MIN)
+            scored.append({score + entry.usageBonus, task});
+    }
+    std::stable_sort(scored.begin(), scored.end(),
+                     [](const QPair<int, int> &a, const QPair<int, int> &b) {
+                         return a.first > b.first;
+                     });
+    matches.reserve(scored.size());
+    for (const QPair<int, int> &item : std::as_const(scored))
+        matches.append(item.second);
+
+    lastQuery = folded;
+    lastMatches = matches;
+    return matches;
+}
+
+void TaskFilter::updateUsageBonus(int task, qint64 nowMs) {
+    Entry &entry = entries[task];
+    const auto it = usageByName.constFind(names.at(task));
+    if (it == usageByName.constEnd() || it->count <= 0) {
+        entry.usageBonus = 0;
+        return;
+    }
+    const double ageDays = qMax<qint64>(0, nowMs - it->lastUsedMs) / double(kMsPerDay);
+    const double decay = std::exp2(-ageDays / kUsageHalfLifeDays);
+    entry.usageBonus = int(kUsageWeight * std::log2(1.0 + it->count) * decay + 0.5);
+}
+
+quint64 TaskFilter::charMask(QStringView text) {
+    quint64 mask = 0;
+    for (const QChar ch : text) {
+        const char16_t c = ch.unicode();
+        int bit;
+        if (c >= 'a' && c <= 'z')
+            bit = c - 'a';
+        else if (c >= '0' && c <= '9')
+            bit = 26 + (c - '0');
+        else
+            bit = 36 + c % 28;
+        mask |= quint64(1) << bit;
+    }
+    return mask;
+}
+
+int TaskFilter::matchScore(const Entry &entry, QStringView query) {
+    const QString &text = entry.folded;
+    const qsizetype n = text.size();
+    const qsizetype m = query.size();
+
+    // Forward pass: the first position where the whole query has matched.
+    qsizetype q = 0;
+    qsizetype end = -1;
+    for (qsizetype i = 0; i < n; ++i) {
+        if (text.at(i) == query.at(q) && ++q == m) {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0)
+        return INT_MIN;
+
+    // Backward pass: the latest start that still matches up to end.
+    q = m - 1;
+    qsizetype start = end;
+    for (qsizetype i = end; i >= 0; --i) {
+        if (text.at(i) == query.at(q) && --q < 0) {
+            start = i;
+            break;
+        }
+    }
+
+    int score = 0;
+    qsizetype prev = -2;
+    q = 0;
+    for (qsizetype i = start; i <= end && q < m; ++i) {
+        if (text.at(i) != query.at(q))
+            continue;
+        score += kMatchScore;
+        if (entry.wordStarts.at(i))
+            score += kWordStartBonus;
+        if (i == prev + 1)
+            score += kRunBonus;
+        prev = i;
+        ++q;
+    }
+    score -= int(end - start + 1 - m) * kGapPenalty;
+    if (start == 0)
+        score += kPrefixBonus;
+    return score;
+}
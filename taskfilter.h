@@ -0,0 +1,56 @@
+#ifndef TASKFILTER_H
+#define TASKFILTER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+#include "configstore.h"
+
+/**
+ * @brief Fuzzy type-ahead filter over task names.
+ *
+ *  Names are case folded once, together with their word starts and a
+ *  bitmask of the characters they contain, so most non-matching names are
+ *  rejected with one AND. The query must appear in the name as a
+ *  subsequence; the tightest window containing it is scored by matched
+ *  characters, word starts, runs and gaps, and how often and how recently
+ *  the task was used is added on top. A query that extends the previous
+ *  one only re-checks the previous matches.
+ */
+class TaskFilter {
+public:
+    using Usage = TaskUsage;
+
+    void setTasks(const QStringList &names);
+    /// Usage by task name, so it survives reordering and edits elsewhere.
+    void setUsage(const QHash<QString, Usage> &usage);
+    const QHash<QString, Usage> &usage() const { return usageByName; }
+    void recordUse(int task);
+
+    /// Matching task indices, best first; an empty query keeps the task order.
+    QList<int> filter(const QString &query);
+
+private:
+    struct Entry {
+        QString folded;
+        QByteArray wordStarts;
+        quint64 charMask = 0;
+        int usageBonus = 0;
+    };
+
+    QStringList names;
+    QList<Entry> entries;
+    QHash<QString, Usage> usageByName;
+    QString lastQuery;
+    QList<int> lastMatches;
+
+    void updateUsageBonus(int task, qint64 nowMs);
+    static quint64 charMask(QStringView text);
+    static int matchScore(const Entry &entry, QStringView query);
+};
+
+#endif // TASKFILTER_H
@@ -0,0 +1,493 @@
+#include "taskmenu.h"
+#include "configwriter.h"
+#include "mousehook.h"
+#include "networkengine.h"
+
+#include <QAbstractListModel>
+#include <QColor>
+#include <QElapsedTimer>
+#include <QFontMetrics>
+#include <QGraphicsDropShadowEffect>
+#include <QGuiApplication>
+#include <QLabel>
+#include <QListView>
+#include <QLoggingCategory>
+#include <QScreen>
+#include <QVBoxLayout>
+
+#include <utility>
+
+Q_LOGGING_CATEGORY(lcMenu, "dlh.menu")
+
+namespace {
+constexpr int kMaxVisibleRows = 15;
+constexpr int kMinMenuWidth = 160;
+constexpr int kMaxMenuWidth = 480;
+// Item padding, borders and the scroll bar.
+constexpr int kRowChrome = 40;
+
+QPoint clampToScreen(const QPoint &pos, const QSize &size, const QRect &available) {
+    int x = pos.x();
+    int y = pos.y();
+    const int maxX = available.x() + available.width() - size.width();
+    const int maxY = available.y() + available.height() - size.height();
+    if (x > maxX)
+        x = maxX;
+    if (y > maxY)
+        y = maxY;
+    if (x < available.x())
+        x = available.x();
+    if (y < available.y())
+        y = available.y();
+    return QPoint(x, y);
+}
+}
+
+class TaskListModel : public QAbstractListModel {
+public:
+    explicit TaskListModel(const QStringList *names, QObject *parent)
+        : QAbstractListModel(parent)
+        , names(names) {}
+
+    void setRows(const QList<int> &taskRows) {
+        beginResetModel();
+        rows = taskRows;
+        endResetModel();
+    }
+
+    int taskAt(int row) const { return row >= 0 && row < rows.size() ? rows.at(row) : -1; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : int(rows.size());
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override {
+        if (role != Qt::DisplayRole || !index.isValid() || index.row() >= rows.size())
+            return QVariant();
+        return names->at(rows.at(index.row()));
+    }
+
+private:
+    const QStringList *names;
+    QList<int> rows;
+};
+
+TaskMenu *TaskMenu::s_activeMenu = nullptr;
+HHOOK TaskMenu::s_keyboardHook = nullptr;
+
+TaskMenu::TaskMenu(QWidget *parent)
+    : QWidget(parent,
+              Qt::Tool | Qt::WindowStaysOnTopHint | Qt::CustomizeWindowHint
+              | Qt::FramelessWindowHint)
+    , container(nullptr)
+    , filterLabel(nullptr)
+    , listView(nullptr)
+    , model(nullptr)
+    , taskNameWidth(0)
+    , menuActiveIndex(-1) {
+    setAttribute(Qt::WA_TranslucentBackground, true);
+    setAttribute(Qt::WA_ShowWithoutActivating, true);
+    setFocusPolicy(Qt::NoFocus);
+
+    auto *mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(10, 10, 10, 10);
+    mainLayout->setSpacing(0);
+
+    container = new QWidget(this);
+    container->setObjectName("container");
+    container->setStyleSheet("QWidget#container { "
+                             "  background-color: white; "
+                             "  border-radius: 0; "
+                             "}"
+                             "QLabel { padding: 2px 8px; color: #6e7781; }"
+                             "QListView { border: 0; background-color: white; outline: 0; }"
+                             "QListView::item {"
+                             "   padding: 2px 8px;"
+                             "   margin: 1px 0;"
+                             "   border: 1px solid #adadad;"
+                             "   background-color: #e1e1e1;"
+                             "   color: black;"
+                             "}"
+                             "QListView::item:selected, QListView::item:hover {"
+                             "   border: 1px solid #0078d7;"
+                             "   background-color: #e5f1fb;"
+                             "   color: black;"
+                             "}");
+
+    auto *shadow = new QGraphicsDropShadowEffect(container);
+    shadow->setBlurRadius(10);
+    shadow->setColor(QColor(0, 0, 0, 160));
+    shadow->setOffset(0, 0);
+    container->setGraphicsEffect(shadow);
+
+    auto *layout = new QVBoxLayout(container);
+    layout->setContentsMargins(2, 2, 2, 2);
+    layout->setSpacing(2);
+
+    filterLabel = new QLabel(tr("Type to filter"), container);
+    layout->addWidget(filterLabel);
+
+    model = new TaskListModel(&taskNames, this);
+    listView = new QListView(container);
+    listView->setModel(model);
+    listView->setUniformItemSizes(true);
+    listView->setSelectionMode(QAbstractItemView::SingleSelection);
+    listView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    listView->setFocusPolicy(Qt::NoFocus);
+    listView->setMouseTracking(true);
+    listView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    listView->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    connect(listView, &QListView::entered, this, [this](const QModelIndex &index) {
+        setMenuActiveIndex(index.row());
+    });
+    connect(listView, &QListView::clicked, this, [this](const QModelIndex &index) {
+        activateRow(index.row());
+    });
+    layout->addWidget(listView);
+
+    mainLayout->addWidget(container);
+
+    filter.setUsage(ConfigStore::loadUsage(ConfigStore::usageFilePath()));
+    setQuery(QString());
+    // Create the native window up front so the first popup only has to
+    // move and show it.
+    applyNoActivateStyle();
+}
+
+TaskMenu::~TaskMenu() {
+    removeMenuHooks();
+}
+
+void TaskMenu::setTasks(const QList<TaskDefinition> &tasks) {
+    QStringList names;
+    names.reserve(tasks.size());
+    for (const TaskDefinition &task : tasks)
+        names.append(task.name.isEmpty() ? tr("<Unnamed>") : task.name);
+    if (names == taskNames)
+        return;
+    taskNames = names;
+    rebuildTaskList();
+}
+
+void TaskMenu::setTaskName(int index, const QString &name) {
+    if (index < 0 || index >= taskNames.size())
+        return;
+    const QString label = name.isEmpty() ? tr("<Unnamed>") : name;
+    if (taskNames.at(index) == label)
+        return;
+    taskNames[index] = label;
+    rebuildTaskList();
+}
+
+void TaskMenu::rebuildTaskList() {
+    const QFontMetrics metrics(listView->font());
+    taskNameWidth = 0;
+    for (const QString &name : std::as_const(taskNames))
+        taskNameWidth = qMax(taskNameWidth, metrics.horizontalAdvance(name));
+    filter.setTasks(taskNames);
+    setQuery(QString());
+}
+
+void TaskMenu::setPreconnect(const QUrl &url, const QString &proxy) {
+    preconnectUrl = url;
+    preconnectProxy = proxy;
+}
+
+void TaskMenu::popup(const QPoint &cursorPos) {
+    popupTimer.start();
+    QScreen *screen = QGuiApplication::screenAt(cursorPos);
+    if (!screen)
+        screen = QGuiApplication::primaryScreen();
+    move(clampToScreen(cursorPos, size(), screen->availableGeometry()));
+    if (isVisible())
+        setQuery(QString());
+    show();
+    raise();
+}
+
+void TaskMenu::keyPressEvent(QKeyEvent *ev) {
+    if (ev->key() == Qt::Key_Escape)
+        hide();
+    else
+        QWidget::keyPressEvent(ev);
+}
+
+void TaskMenu::showEvent(QShowEvent *event) {
+    QWidget::showEvent(event);
+    const HWND hwnd = reinterpret_cast<HWND>(winId());
+    if (hwnd)
+        ShowWindow(hwnd, SW_SHOWNOACTIVATE);
+    setMenuActiveIndex(-1);
+    installMenuHooks();
+    if (preconnectUrl.isValid())
+        NetworkEngine::instance()->preconnect(preconnectUrl, preconnectProxy);
+}
+
+void TaskMenu::hideEvent(QHideEvent *event) {
+    removeMenuHooks();
+    // Reset while hidden so the next popup is ready to paint.
+    if (!query.isEmpty())
+        setQuery(QString());
+    QWidget::hideEvent(event);
+}
+
+void TaskMenu::paintEvent(QPaintEvent *event) {
+    QWidget::paintEvent(event);
+    if (popupTimer.isValid()) {
+        qCDebug(lcMenu) << "hotkey to paint" << popupTimer.elapsed() << "ms";
+        popupTimer.invalidate();
+    }
+}
+
+bool TaskMenu::nativeEvent(const QByteArray &eventType, void *message, qintptr *result) {
+    if (eventType == "windows_generic_MSG" || eventType == "windows_dispatcher_MSG") {
+        auto *msg = static_cast<MSG *>(message);
+        if (msg && msg->message == WM_MOUSEACTIVATE) {
+            if (result)
+                *result = MA_NOACTIVATE;
+            return true;
+        }
+    }
+    return QWidget::nativeEvent(eventType, message, result);
+}
+
+void TaskMenu::installMenuHooks() {
+    s_activeMenu = this;
+    if (!s_keyboardHook) {
+        s_keyboardHook = SetWindowsHookExW(WH_KEYBOARD_LL, LowLevelKeyboardProc,
+                                           GetModuleHandleW(nullptr), 0);
+    }
+    MouseHook::subscribe(this, [this](WPARAM message, const MSLLHOOKSTRUCT &data) {
+        switch (message) {
+            case WM_LBUTTONDOWN:
+            case WM_RBUTTONDOWN:
+            case WM_MBUTTONDOWN:
+            case WM_XBUTTONDOWN:
+                if (s_activeMenu == this)
+                    handleHookMouseClick(data.pt);
+                break;
+            default:
+                break;
+        }
+    });
+}
+
+void TaskMenu::removeMenuHooks() {
+    if (s_activeMenu != this)
+        return;
+    s_activeMenu = nullptr;
+    if (s_keyboardHook) {
+        UnhookWindowsHookEx(s_keyboardHook);
+        s_keyboardHook = nullptr;
+    }
+    MouseHook::unsubscribe(this);
+}
+
+LRESULT CALLBACK TaskMenu::LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
+    if (nCode == HC_ACTION && s_activeMenu) {
+        const auto *data = reinterpret_cast<KBDLLHOOKSTRUCT *>(lParam);
+        if (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) {
+            if (s_activeMenu->handleHookKey(static_cast<UINT>(data->vkCode),
+                                            static_cast<UINT>(data->scanCode))) {
+                return 1;
+            }
+        }
+    }
+    return CallNextHookEx(nullptr, nCode, wParam, lParam);
+}
+
+bool TaskMenu::handleHookKey(UINT vk, UINT scanCode) {
+    if (!isVisible())
+        return false;
+    // Shortcuts keep working while the menu is open.
+    if ((GetAsyncKeyState(VK_CONTROL) & 0x8000) || (GetAsyncKeyState(VK_MENU) & 0x8000)
+        || (GetAsyncKeyState(VK_LWIN) & 0x8000) || (GetAsyncKeyState(VK_RWIN) & 0x8000)) {
+        return false;
+    }
+    const bool shift = (GetAsyncKeyState(VK_SHIFT) & 0x8000) != 0;
+    switch (vk) {
+        case VK_ESCAPE:
+            if (query.isEmpty())
+                hide();
+            else
+                setQuery(QString());
+            return true;
+        case VK_TAB:
+            if (shift)
+                selectPreviousMenuItem();
+            else
+                selectNextMenuItem();
+            return true;
+        case VK_LEFT:
+        case VK_UP:
+            selectPreviousMenuItem();
+            return true;
+        case VK_RIGHT:
+        case VK_DOWN:
+            selectNextMenuItem();
+            return true;
+        case VK_RETURN:
+            activateMenuItem();
+            return true;
+        case VK_SPACE:
+            if (query.isEmpty()) {
+                activateMenuItem();
+                return true;
+            }
+            break;
+        case VK_BACK:
+            if (!query.isEmpty())
+                setQuery(query.chopped(1));
+            return true;
+        default:
+            break;
+    }
+    const QString text = hookKeyText(vk, scanCode);
+    if (text.isEmpty())
+        return false;
+    setQuery(query + text);
+    return true;
+}
+
+QString TaskMenu::hookKeyText(UINT vk, UINT scanCode) {
+    // The hook runs before the focused window's input state is updated, so
+    // the modifier state is read from the hardware.
+    BYTE state[256] = {};
+    if (GetAsyncKeyState(VK_SHIFT) & 0x8000)
+        state[VK_SHIFT] = 0x80;
+    if (GetKeyState(VK_CAPITAL) & 0x0001)
+        state[VK_CAPITAL] = 0x01;
+    const HKL layout = GetKeyboardLayout(GetWindowThreadProcessId(GetForegroundWindow(), nullptr));
+    wchar_t buffer[4] = {};
+    // Flag 0x4 leaves the dead-key state of the focused application alone.
+    const int count = ToUnicodeEx(vk, scanCode, state, buffer, 4, 0x4, layout);
+    if (count <= 0)
+        return QString();
+    const QString text = QString::fromWCharArray(buffer, count);
+    for (const QChar ch : text) {
+        if (!ch.isPrint())
+            return QString();
+    }
+    return text;
+}
+
+void TaskMenu::handleHookMouseClick(const POINT &pt) {
+    if (!isVisible())
+        return;
+    if (!isPointInsideMenu(pt))
+        hide();
+}
+
+bool TaskMenu::isPointInsideMenu(const POINT &pt) const {
+    const HWND hwnd = reinterpret_cast<HWND>(winId());
+    if (!hwnd)
+        return false;
+    RECT rect{};
+    if (!GetWindowRect(hwnd, &rect))
+        return false;
+    return PtInRect(&rect, pt) != 0;
+}
+
+void TaskMenu::setMenuActiveIndex(int row) {
+    if (row < -1 || row >= model->rowCount())
+        return;
+    if (menuActiveIndex == row)
+        return;
+    menuActiveIndex = row;
+    if (row < 0) {
+        listView->clearSelection();
+        listView->setCurrentIndex(QModelIndex());
+        return;
+    }
+    const QModelIndex index = model->index(row);
+    listView->setCurrentIndex(index);
+    listView->scrollTo(index);
+}
+
+void TaskMenu::selectNextMenuItem() {
+    const int rows = model->rowCount();
+    if (rows == 0)
+        return;
+    if (menuActiveIndex < 0)
+        setMenuActiveIndex(0);
+    else
+        setMenuActiveIndex((menuActiveIndex + 1) % rows);
+}
+
+void TaskMenu::selectPreviousMenuItem() {
+    const int rows = model->rowCount();
+    if (rows == 0)
+        return;
+    if (menuActiveIndex < 0)
+        setMenuActiveIndex(rows - 1);
+    else
+        setMenuActiveIndex((menuActiveIndex - 1 + rows) % rows);
+}
+
+void TaskMenu::activateMenuItem() {
+    activateRow(menuActiveIndex);
+}
+
+void TaskMenu::applyNoActivateStyle() {
+    const HWND hwnd = reinterpret_cast<HWND>(winId());
+    if (!hwnd)
+        return;
+    const LONG_PTR exStyle = GetWindowLongPtrW(hwnd, GWL_EXSTYLE);
+    const LONG_PTR desired = exStyle | WS_EX_NOACTIVATE | WS_EX_TOOLWINDOW;
+    if (desired != exStyle)
+        SetWindowLongPtrW(hwnd, GWL_EXSTYLE, desired);
+    SetWindowPos(hwnd, nullptr, 0, 0, 0, 0,
+                 SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE | SWP_FRAMECHANGED);
+}
+
+void TaskMenu::setQuery(const QString &text) {
+    query = text;
+    QElapsedTimer timer;
+    timer.start();
+    const QList<int> rows = filter.filter(query);
+    const qint64 filterUs = timer.nsecsElapsed() / 1000;
+    model->setRows(rows);
+    menuActiveIndex = -1;
+    // With a query the best match is picked by Enter.
+    setMenuActiveIndex(query.isEmpty() || rows.isEmpty() ? -1 : 0);
+    if (!query.isEmpty()) {
+        qCDebug(lcMenu) << "filtered" << taskNames.size() << "tasks in" << filterUs << "us,"
+                        << rows.size() << "matches";
+    }
+
+    if (query.isEmpty()) {
+        filterLabel->setText(tr("Type to filter"));
+        filterLabel->setStyleSheet(QString());
+    } else {
+        filterLabel->setText(query);
+        filterLabel->setStyleSheet("QLabel { color: black; }");
+    }
+    updateMenuSize();
+}
+
+void TaskMenu::updateMenuSize() {
+    const int rows = qMin(model->rowCount(), kMaxVisibleRows);
+    const int rowHeight = model->rowCount() > 0
+        ? listView->sizeHintForRow(0)
+        : listView->fontMetrics().height();
+    listView->setFixedSize(qBound(kMinMenuWidth, taskNameWidth + kRowChrome, kMaxMenuWidth),
+                           qMax(1, rows) * rowHeight + 2 * listView->frameWidth());
+    adjustSize();
+    // Keep the menu on screen when it grows back after a filter.
+    if (isVisible()) {
+        QScreen *screen = QGuiApplication::screenAt(pos());
+        if (!screen)
+            screen = QGuiApplication::primaryScreen();
+        move(clampToScreen(pos(), size(), screen->availableGeometry()));
+    }
+}
+
+void TaskMenu::activateRow(int row) {
+    const int task = model->taskAt(row);
+    if (task < 0)
+        return;
+    hide();
+    filter.recordUse(task);
+    emit taskTriggered(task);
+    ConfigWriter::instance()->saveUsage(ConfigStore::usageFilePath(), filter.usage());
+}
@@ -0,0 +1,93 @@
+#ifndef TASKMENU_H
+#define TASKMENU_H
+
+#include <QWidget>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QKeyEvent>
+#include <QList>
+#include <QPoint>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+
+#include <windows.h>
+
+#include "configstore.h"
+#include "taskfilter.h"
+
+class QHideEvent;
+class QLabel;
+class QListView;
+class QPaintEvent;
+class QShowEvent;
+class TaskListModel;
+
+/**
+ * @brief Task picker shown at the cursor by the global hotkey.
+ *
+ *  Built once and kept hidden between uses; the list is rebuilt only when
+ *  the task names change. It never takes focus: typing, navigation and
+ *  outside clicks come from low-level hooks installed while visible.
+ *  Typed text filters the tasks through TaskFilter, and the results are
+ *  shown in a QListView so only the visible rows are laid out.
+ */
+class TaskMenu : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit TaskMenu(QWidget *parent = nullptr);
+    ~TaskMenu() override;
+
+    void setTasks(const QList<TaskDefinition> &tasks);
+    void setTaskName(int index, const QString &name);
+    /// Endpoint warmed up whenever the menu opens; empty to disable.
+    void setPreconnect(const QUrl &url, const QString &proxy);
+    void popup(const QPoint &cursorPos);
+
+signals:
+    void taskTriggered(int index);
+
+protected:
+    void keyPressEvent(QKeyEvent *ev) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+    bool nativeEvent(const QByteArray &eventType, void *message, qintptr *result) override;
+
+private:
+    QWidget *container;
+    QLabel *filterLabel;
+    QListView *listView;
+    TaskListModel *model;
+    QStringList taskNames;
+    int taskNameWidth;
+    TaskFilter filter;
+    QString query;
+    int menuActiveIndex;
+    QUrl preconnectUrl;
+    QString preconnectProxy;
+    QElapsedTimer popupTimer;
+
+    static TaskMenu *s_activeMenu;
+    static HHOOK s_keyboardHook;
+    static LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
+
+    void installMenuHooks();
+    void removeMenuHooks();
+    bool handleHookKey(UINT vk, UINT scanCode);
+    static QString hookKeyText(UINT vk, UINT scanCode);
+    void handleHookMouseClick(const POINT &pt);
+    bool isPointInsideMenu(const POINT &pt) const;
+    void setMenuActiveIndex(int row);
+    void selectNextMenuItem();
+    void selectPreviousMenuItem();
+    void activateMenuItem();
+    void applyNoActivateStyle();
+    void rebuildTaskList();
+    void setQuery(const QString &text);
+    void updateMenuSize();
+    void activateRow(int row);
+};
+
+#endif // TASKMENU_H
@@ -4,6 +4,7 @@
 #include <QLineEdit>
 #include <QTextEdit>
 #include <QRadioButton>
+#include <QCheckBox>
 #include <QSpinBox>
 #include <QDoubleSpinBox>
 #include <QComboBox>
@@ -27,6 +28,20 @@ TaskWidget::TaskWidget(QWidget *parent)
     connect(ui->textEditPrompt, &QTextEdit::textChanged, this, &TaskWidget::configChanged);
     connect(ui->radioInsert, &QRadioButton::toggled, this, &TaskWidget::configChanged);
     connect(ui->radioWindow, &QRadioButton::toggled, this, &TaskWidget::configChanged);
+    connect(ui->radioInsert, &QRadioButton::toggled, this, &TaskWidget::updateStreamInsertControls);
+    connect(ui->checkBoxStreamInsert, &QCheckBox::toggled, this, &TaskWidget::configChanged);
+    connect(ui->checkBoxStreamInsert, &QCheckBox::toggled,
+            this, &TaskWidget::updateStreamInsertControls);
+    connect(ui->spinBoxInsertBatchChars, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &TaskWidget::configChanged);
+    connect(ui->spinBoxInsertDebounce, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &TaskWidget::configChanged);
+    connect(ui->checkBoxHedge, &QCheckBox::toggled, this, &TaskWidget::configChanged);
+    connect(ui->checkBoxHedge, &QCheckBox::toggled, this, &TaskWidget::updateHedgeControls);
+    connect(ui->lineEditHedgeModel, &QLineEdit::textChanged, this, &TaskWidget::configChanged);
+    connect(ui->spinBoxHedgeDelay, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &TaskWidget::configChanged);
+    connect(ui->checkBoxCacheResponses, &QCheckBox::toggled, this, &TaskWidget::configChanged);
 
     connect(ui->spinBoxMaxTokens, QOverload<int>::of(&QSpinBox::valueChanged),
             this, &TaskWidget::configChanged);
@@ -46,6 +61,8 @@ TaskWidget::TaskWidget(QWidget *parent)
     ui->horizontalLayoutModel->setStretch(2, 0);
 
     ui->comboBoxModel->addItem(tr(kDefaultModelLabel), QString());
+    updateStreamInsertControls();
+    updateHedgeControls();
 }
 
 TaskWidget::~TaskWidget() {
@@ -110,6 +127,76 @@ void TaskWidget::setInsertMode(bool insert) {
         ui->radioWindow->setChecked(true);
 }
 
+bool TaskWidget::streamInsert() const {
+    return ui->checkBoxStreamInsert->isChecked();
+}
+
+int TaskWidget::insertBatchChars() const {
+    return ui->spinBoxInsertBatchChars->value();
+}
+
+int TaskWidget::insertDebounceMs() const {
+    return ui->spinBoxInsertDebounce->value();
+}
+
+void TaskWidget::setStreamInsert(bool enabled) {
+    ui->checkBoxStreamInsert->setChecked(enabled);
+}
+
+void TaskWidget::setInsertBatchChars(int chars) {
+    ui->spinBoxInsertBatchChars->setValue(chars);
+}
+
+void TaskWidget::setInsertDebounceMs(int ms) {
+    ui->spinBoxInsertDebounce->setValue(ms);
+}
+
+void TaskWidget::updateStreamInsertControls() {
+    const bool insert = !readOnly && ui->radioInsert->isChecked();
+    ui->checkBoxStreamInsert->setEnabled(insert);
+    const bool batching = insert && ui->checkBoxStreamInsert->isChecked();
+    ui->spinBoxInsertBatchChars->setEnabled(batching);
+    ui->spinBoxInsertDebounce->setEnabled(batching);
+}
+
+bool TaskWidget::hedge() const {
+    return ui->checkBoxHedge->isChecked();
+}
+
+QString TaskWidget::hedgeModel() const {
+    return ui->lineEditHedgeModel->text().trimmed();
+}
+
+int TaskWidget::hedgeDelayMs() const {
+    return ui->spinBoxHedgeDelay->value();
+}
+
+void TaskWidget::setHedge(bool enabled) {
+    ui->checkBoxHedge->setChecked(enabled);
+}
+
+void TaskWidget::setHedgeModel(const QString &modelName) {
+    ui->lineEditHedgeModel->setText(modelName);
+}
+
+void TaskWidget::setHedgeDelayMs(int ms) {
+    ui->spinBoxHedgeDelay->setValue(ms);
+}
+
+bool TaskWidget::cacheResponses() const {
+    return ui->checkBoxCacheResponses->isChecked();
+}
+
+void TaskWidget::setCacheResponses(bool enabled) {
+    ui->checkBoxCacheResponses->setChecked(enabled);
+}
+
+void TaskWidget::updateHedgeControls() {
+    const bool hedging = !readOnly && ui->checkBoxHedge->isChecked();
+    ui->lineEditHedgeModel->setEnabled(hedging);
+    ui->spinBoxHedgeDelay->setEnabled(hedging);
+}
+
 int TaskWidget::maxTokens() const {
     return ui->spinBoxMaxTokens->value();
 }
@@ -164,14 +251,24 @@ void TaskWidget::setResponseZoom(int zoom) {
 TaskDefinition TaskWidget::toDefinition() const {
     TaskDefinition def;
     def.name = name();
-    def.prompt = prompt();
+    // A file-backed prompt stays on disk instead of in the config.
+    def.prompt = promptFilePath.isEmpty() ? prompt() : QString();
     def.modelName = modelName();
     def.insertMode = insertMode();
+    def.streamInsert = streamInsert();
+    def.insertBatchChars = insertBatchChars();
+    def.insertDebounceMs = insertDebounceMs();
+    def.hedge = hedge();
+    def.hedgeModel = hedgeModel();
+    def.hedgeDelayMs = hedgeDelayMs();
+    def.cacheResponses = cacheResponses();
     def.maxTokens = maxTokens();
     def.temperature = temperature();
     def.responseWidth = responseWidth;
     def.responseHeight = responseHeight;
     def.responseZoom = responseZoomValue;
+    def.pack = packName;
+    def.promptFile = promptFilePath;
     return def;
 }
 
@@ -180,9 +277,56 @@ void TaskWidget::applyDefinition(const TaskDefinition &definition) {
     setPrompt(definition.prompt);
     setModelName(definition.modelName);
     setInsertMode(definition.insertMode);
+    setStreamInsert(definition.streamInsert);
+    setInsertBatchChars(definition.insertBatchChars);
+    setInsertDebounceMs(definition.insertDebounceMs);
+    setHedge(definition.hedge);
+    setHedgeModel(definition.hedgeModel);
+    setHedgeDelayMs(definition.hedgeDelayMs);
+    setCacheResponses(definition.cacheResponses);
     setMaxTokens(definition.maxTokens);
     setTemperature(definition.temperature);
     responseWidth = definition.responseWidth;
     responseHeight = definition.responseHeight;
     responseZoomValue = definition.responseZoom;
+    packName = definition.pack;
+    promptFilePath = definition.promptFile;
+    promptPending = !promptFilePath.isEmpty();
+    setReadOnly(!packName.isEmpty());
+    if (isVisible())
+        loadPendingPrompt();
+}
+
+void TaskWidget::setReadOnly(bool enabled) {
+    readOnly = enabled;
+    ui->lineEditName->setReadOnly(enabled);
+    ui->textEditPrompt->setReadOnly(enabled);
+    for (QWidget *widget : {static_cast<QWidget *>(ui->comboBoxModel),
+                            static_cast<QWidget *>(ui->spinBoxMaxTokens),
+                            static_cast<QWidget *>(ui->doubleSpinBoxTemperature),
+                            static_cast<QWidget *>(ui->radioInsert),
+                            static_cast<QWidget *>(ui->radioWindow),
+                            static_cast<QWidget *>(ui->checkBoxHedge),
+                            static_cast<QWidget *>(ui->checkBoxCacheResponses)}) {
+        widget->setEnabled(!enabled);
+    }
+    updateStreamInsertControls();
+    updateHedgeControls();
+}
+
+QString TaskWidget::pack() const {
+    return packName;
+}
+
+void TaskWidget::showEvent(QShowEvent *event) {
+    loadPendingPrompt();
+    QWidget::showEvent(event);
+}
+
+void TaskWidget::loadPendingPrompt() {
+    if (!promptPending)
+        return;
+    promptPending = false;
+    QSignalBlocker blocker(ui->textEditPrompt);
+    setPrompt(ConfigStore::loadPrompt(promptFilePath));
 }
@@ -10,6 +10,7 @@ namespace Ui {
     class TaskWidget;
 }
 
+class QShowEvent;
 struct TaskDefinition;
 
 class TaskWidget : public QWidget {
@@ -27,6 +28,20 @@ public:
     void setPrompt(const QString &prompt);
     void setModelName(const QString &modelName);
     void setInsertMode(bool insert);
+    bool streamInsert() const;
+    int insertBatchChars() const;
+    int insertDebounceMs() const;
+    void setStreamInsert(bool enabled);
+    void setInsertBatchChars(int chars);
+    void setInsertDebounceMs(int ms);
+    bool hedge() const;
+    QString hedgeModel() const;
+    int hedgeDelayMs() const;
+    void setHedge(bool enabled);
+    void setHedgeModel(const QString &modelName);
+    void setHedgeDelayMs(int ms);
+    bool cacheResponses() const;
+    void setCacheResponses(bool enabled);
 
     int maxTokens() const;
     double temperature() const;
@@ -40,6 +55,12 @@ public:
 
     TaskDefinition toDefinition() const;
     void applyDefinition(const TaskDefinition &definition);
+    /// Pack tasks are shown but cannot be edited.
+    void setReadOnly(bool enabled);
+    QString pack() const;
+
+protected:
+    void showEvent(QShowEvent *event) override;
 
 signals:
     void configChanged();
@@ -47,9 +68,17 @@ signals:
 
 private:
     Ui::TaskWidget *ui;
+    void updateStreamInsertControls();
+    void updateHedgeControls();
+    void loadPendingPrompt();
     int responseWidth = 600;
     int responseHeight = 200;
     int responseZoomValue = 0;
+    QString packName;
+    QString promptFilePath;
+    // The prompt file is read the first time the page is shown.
+    bool promptPending = false;
+    bool readOnly = false;
 };
 
 #endif // TASKWIDGET_H
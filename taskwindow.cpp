@@ -1,4 +1,9 @@
 #include "taskwindow.h"
+#include "mousehook.h"
+#include "networkengine.h"
+#include "ratelimiter.h"
+#include "responsecache.h"
+#include "transcriptview.h"
 
 #include <QClipboard>
 #include <QAbstractTextDocumentLayout>
@@ -10,45 +15,45 @@
 #include <QEventLoop>
 #include <QFont>
 #include <QFontMetrics>
-#include <QGraphicsDropShadowEffect>
 #include <QGuiApplication>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QKeyEvent>
 #include <QLabel>
+#include <QLoggingCategory>
 #include <QMessageBox>
-#include <QNetworkAccessManager>
-#include <QNetworkProxy>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QPalette>
 #include <QPushButton>
-#include <QRegularExpression>
 #include <QResizeEvent>
 #include <QScreen>
-#include <QScrollBar>
-#include <QStyle>
 #include <QStringList>
-#include <QSyntaxHighlighter>
 #include <QTextBlock>
-#include <QTextBrowser>
 #include <QTextDocument>
-#include <QTextFormat>
-#include <QTextCursor>
-#include <QTextFragment>
 #include <QTextLayout>
 #include <QTimer>
 #include <QUrl>
 #include <QVBoxLayout>
 #include <QPlainTextEdit>
 
-#include <functional>
+#include <algorithm>
+#include <utility>
 
 #include <windows.h>
 
+Q_LOGGING_CATEGORY(lcTask, "dlh.task")
+
 namespace {
 constexpr const char kDefaultModelLabel[] = "Default";
+// The target application reads the clipboard asynchronously after Ctrl+V.
+constexpr int kMinPasteIntervalMs = 60;
+constexpr int kMaxRateLimitRetries = 4;
+// Hedge delay used until the primary endpoint has enough latency samples.
+constexpr int kDefaultHedgeDelayMs = 1500;
+constexpr qreal kFallbackRefreshRate = 60.0;
+constexpr qint64 kLoadingProgressIntervalMs = 250;
 
 QUrl buildApiUrl(const QString &baseUrl, const QString &pathSuffix) {
     QUrl url(baseUrl.trimmed());
@@ -64,238 +69,22 @@ QUrl buildApiUrl(const QString &baseUrl, const QString &pathSuffix) {
     return url;
 }
 
+QString deadlineDescription(DeadlineKind kind) {
+    switch (kind) {
+        case DeadlineKind::Connect: return QObject::tr("connect");
+        case DeadlineKind::FirstByte: return QObject::tr("waiting for the first byte");
+        case DeadlineKind::Idle: return QObject::tr("stream stalled");
+        case DeadlineKind::None: break;
+    }
+    return QString();
+}
+
 QString normalizeModelName(const QString &name) {
     if (name == QLatin1String(kDefaultModelLabel))
         return QString();
     return name;
 }
 
-bool isCodeBlock(const QTextBlock &block) {
-    const QTextBlockFormat format = block.blockFormat();
-    if (format.hasProperty(QTextFormat::BlockCodeFence))
-        return true;
-    if (format.hasProperty(QTextFormat::BlockCodeLanguage))
-        return true;
-    return block.charFormat().fontFixedPitch();
-}
-
-bool isInlineCodeFormat(const QTextCharFormat &format) {
-    if (format.fontFixedPitch())
-        return true;
-    const QFont font = format.font();
-    if (font.fixedPitch())
-        return true;
-    const QString family = font.family();
-    if (family.contains("mono", Qt::CaseInsensitive)
-        || family.contains("courier", Qt::CaseInsensitive)
-        || family.contains("consolas", Qt::CaseInsensitive)) {
-        return true;
-    }
-    const QStringList families = format.fontFamilies().toStringList();
-    for (const QString &entry : families) {
-        if (entry.contains("mono", Qt::CaseInsensitive)
-            || entry.contains("courier", Qt::CaseInsensitive)
-            || entry.contains("consolas", Qt::CaseInsensitive)) {
-            return true;
-        }
-    }
-    const QVariant hintProp = format.property(QTextFormat::FontStyleHint);
-    if (hintProp.isValid()) {
-        const int hint = hintProp.toInt();
-        if (hint == QFont::TypeWriter || hint == QFont::Monospace)
-            return true;
-    }
-    const QVariant familyProp = format.property(QTextFormat::FontFamily);
-    if (familyProp.isValid()) {
-        const QString propFamily = familyProp.toString();
-        if (propFamily.contains("mono", Qt::CaseInsensitive)
-            || propFamily.contains("courier", Qt::CaseInsensitive)
-            || propFamily.contains("consolas", Qt::CaseInsensitive)) {
-            return true;
-        }
-    }
-    return false;
-}
-
-QFont resolveBaseTextFont(QTextDocument *doc) {
-    if (!doc)
-        return QFont();
-    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next()) {
-        if (isCodeBlock(block))
-            continue;
-        for (auto it = block.begin(); !it.atEnd(); ++it) {
-            const QTextFragment fragment = it.fragment();
-            if (!fragment.isValid())
-                continue;
-            const QTextCharFormat format = fragment.charFormat();
-            if (isInlineCodeFormat(format))
-                continue;
-            const QFont font = format.font();
-            if (font.pointSizeF() > 0 || font.pixelSize() > 0)
-                return font;
-        }
-    }
-    return doc->defaultFont();
-}
-
-class MarkdownTextBrowser : public QTextBrowser {
-public:
-    explicit MarkdownTextBrowser(QWidget *parent = nullptr)
-        : QTextBrowser(parent) {}
-
-    void setZoomCallback(std::function<void()> callback) {
-        zoomCallback = std::move(callback);
-    }
-
-    void setZoomDeltaCallback(std::function<void(int)> callback) {
-        zoomDeltaCallback = std::move(callback);
-    }
-
-protected:
-    void wheelEvent(QWheelEvent *event) override {
-        if (event->modifiers().testFlag(Qt::ControlModifier)) {
-            int delta = event->angleDelta().y();
-            if (delta == 0)
-                delta = event->pixelDelta().y();
-            if (delta == 0) {
-                event->accept();
-                return;
-            }
-            int steps = qAbs(delta) / 120;
-            if (steps == 0)
-                steps = 1;
-            if (delta > 0) {
-                zoomIn(steps);
-                if (zoomDeltaCallback)
-                    zoomDeltaCallback(steps);
-            } else {
-                zoomOut(steps);
-                if (zoomDeltaCallback)
-                    zoomDeltaCallback(-steps);
-            }
-            if (zoomCallback)
-                zoomCallback();
-            event->accept();
-            return;
-        }
-        QTextBrowser::wheelEvent(event);
-    }
-
-private:
-    std::function<void()> zoomCallback;
-    std::function<void(int)> zoomDeltaCallback;
-};
-
-class MarkdownCodeHighlighter : public QSyntaxHighlighter {
-public:
-    explicit MarkdownCodeHighlighter(QTextDocument *parent)
-        : QSyntaxHighlighter(parent) {
-        keywordFormat.setForeground(QColor("#d73a49"));
-        keywordFormat.setFontWeight(QFont::Bold);
-
-        stringFormat.setForeground(QColor("#032f62"));
-
-        numberFormat.setForeground(QColor("#005cc5"));
-
-        commentFormat.setForeground(QColor("#6a737d"));
-
-        keywordPatterns = {
-            QRegularExpression("\\b(auto|bool|break|case|catch|class|const|continue|def|default|"
-                               "delete|do|else|enum|export|extends|false|final|finally|for|"
-                               "foreach|from|function|if|implements|import|inline|interface|"
-                               "lambda|let|namespace|new|nullptr|null|operator|private|protected|"
-                               "public|return|static|struct|switch|template|this|throw|true|try|"
-                               "typedef|typename|using|var|virtual|void|volatile|while)\\b")
-        };
-
-        stringPatterns = {
-            QRegularExpression(R"("([^"\\]|\\.)*")"),
-            QRegularExpression(R"('([^'\\]|\\.)*')")
-        };
-
-        numberPattern = QRegularExpression("\\b\\d+(?:\\.\\d+)?\\b");
-        singleLineCommentPatterns = {
-            QRegularExpression("//[^\\n]*"),
-            QRegularExpression("#[^\\n]*")
-        };
-        multiLineCommentStart = QRegularExpression("/\\*");
-        multiLineCommentEnd = QRegularExpression("\\*/");
-    }
-
-protected:
-    void highlightBlock(const QString &text) override {
-        setCurrentBlockState(0);
-        if (!isCodeBlock(currentBlock()))
-            return;
-
-        for (const QRegularExpression &pattern : keywordPatterns) {
-            auto it = pattern.globalMatch(text);
-            while (it.hasNext()) {
-                const QRegularExpressionMatch match = it.next();
-                setFormat(match.capturedStart(), match.capturedLength(), keywordFormat);
-            }
-        }
-
-        for (const QRegularExpression &pattern : stringPatterns) {
-            auto it = pattern.globalMatch(text);
-            while (it.hasNext()) {
-                const QRegularExpressionMatch match = it.next();
-                setFormat(match.capturedStart(), match.capturedLength(), stringFormat);
-            }
-        }
-
-        auto numberIt = numberPattern.globalMatch(text);
-        while (numberIt.hasNext()) {
-            const QRegularExpressionMatch match = numberIt.next();
-            setFormat(match.capturedStart(), match.capturedLength(), numberFormat);
-        }
-
-        for (const QRegularExpression &pattern : singleLineCommentPatterns) {
-            auto it = pattern.globalMatch(text);
-            while (it.hasNext()) {
-                const QRegularExpressionMatch match = it.next();
-                setFormat(match.capturedStart(), match.capturedLength(), commentFormat);
-            }
-        }
-
-        int startIndex = 0;
-        if (previousBlockState() == 1) {
-            startIndex = 0;
-        } else {
-            const QRegularExpressionMatch match = multiLineCommentStart.match(text);
-            startIndex = match.hasMatch() ? match.capturedStart() : -1;
-        }
-
-        while (startIndex >= 0) {
-            const QRegularExpressionMatch endMatch = multiLineCommentEnd.match(text, startIndex);
-            int commentLength = 0;
-            if (endMatch.hasMatch()) {
-                commentLength = endMatch.capturedEnd() - startIndex;
-                setFormat(startIndex, commentLength, commentFormat);
-            } else {
-                setCurrentBlockState(1);
-                commentLength = text.length() - startIndex;
-                setFormat(startIndex, commentLength, commentFormat);
-            }
-            const QRegularExpressionMatch nextStart = multiLineCommentStart.match(text,
-                                                                                  startIndex + commentLength);
-            startIndex = nextStart.hasMatch() ? nextStart.capturedStart() : -1;
-        }
-    }
-
-private:
-    QTextCharFormat keywordFormat;
-    QTextCharFormat stringFormat;
-    QTextCharFormat numberFormat;
-    QTextCharFormat commentFormat;
-    QList<QRegularExpression> keywordPatterns;
-    QList<QRegularExpression> stringPatterns;
-    QRegularExpression numberPattern;
-    QList<QRegularExpression> singleLineCommentPatterns;
-    QRegularExpression multiLineCommentStart;
-    QRegularExpression multiLineCommentEnd;
-};
-
 QPoint clampToScreen(const QPoint &pos, const QSize &size, const QRect &available) {
     int x = pos.x();
     int y = pos.y();
@@ -312,6 +101,16 @@ QPoint clampToScreen(const QPoint &pos, const QSize &size, const QRect &availabl
     return QPoint(x, y);
 }
 
+qsizetype utf8Length(QStringView text) {
+    qsizetype bytes = 0;
+    for (const QChar c : text) {
+        const char16_t unit = c.unicode();
+        // A surrogate pair is four bytes, two per half.
+        bytes += unit < 0x80 ? 1 : (unit < 0x800 || c.isSurrogate()) ? 2 : 3;
+    }
+    return bytes;
+}
+
 void moveNearCursor(QWidget *widget, const QPoint &cursorPos) {
     QScreen *screen = QGuiApplication::screenAt(cursorPos);
     if (!screen)
@@ -319,155 +118,66 @@ void moveNearCursor(QWidget *widget, const QPoint &cursorPos) {
     const QRect available = screen->availableGeometry();
     widget->move(clampToScreen(cursorPos, widget->size(), available));
 }
-
-const QString &markdownCss() {
-    static const QString css =
-        "body {"
-        "  font-family: 'Segoe UI', 'Noto Sans', Helvetica, Arial;"
-        "  font-size: 12pt;"
-        "  color: #24292f;"
-        "}"
-        "a { color: #0969da; text-decoration: none; }"
-        "a:hover { text-decoration: underline; }"
-        "p { margin: 8px 0; }"
-        "h1 { font-size: 20pt; border-bottom: 1px solid #d0d7de; padding-bottom: 4px; }"
-        "h2 { font-size: 16pt; border-bottom: 1px solid #d0d7de; padding-bottom: 2px; }"
-        "h3 { font-size: 14pt; }"
-        "ul, ol { margin-left: 20px; }"
-        "pre { border: 1px solid #d0d7de; padding: 8px; margin: 12px 0; }"
-        "blockquote {"
-        "  color: #24292f;"
-        "  border-left: 4px solid #9ec5fe;"
-        "  background-color: #f2f7ff;"
-        "  margin: 8px 0;"
-        "  padding: 6px 10px;"
-        "  border-radius: 4px;"
-        "}"
-        "table { border-collapse: collapse; }"
-        "th, td { border: 1px solid #d0d7de; padding: 4px 8px; }"
-        "hr { border: 0; border-top: 1px solid #d0d7de; margin: 12px 0; }";
-    return css;
-}
 }
 
-TaskWindow *TaskWindow::s_activeMenu = nullptr;
-HHOOK TaskWindow::s_keyboardHook = nullptr;
-HHOOK TaskWindow::s_mouseHook = nullptr;
-
-TaskWindow::TaskWindow(const QList<TaskDefinition> &taskList,
-                       const AppSettings &settings,
-                       QWidget *parent)
-    : QWidget(parent,
-              Qt::Tool | Qt::WindowStaysOnTopHint | Qt::CustomizeWindowHint
-              | Qt::FramelessWindowHint)
-    , tasks(taskList)
+
+TaskWindow::TaskWindow(const ConfigSnapshot &snapshot, QObject *parent)
+    : QObject(parent)
+    , config(snapshot)
+    , settings(config->settings)
     , activeTaskIndex(-1)
-    , settings(settings)
-    , networkManager(new QNetworkAccessManager(this))
     , loadingWindow(nullptr)
-    , loadingTimer(nullptr)
     , loadingLabel(nullptr)
-    , animationTimer(nullptr)
-    , dotCount(0)
+    , loadingMovePending(false)
+    , lastProgressMs(0)
+    , responseUtf8Bytes(0)
     , responseWindow(nullptr)
     , responseView(nullptr)
     , followUpInput(nullptr)
-    , sawStreamFormat(false)
     , requestInFlight(false)
-    , menuActiveIndex(-1) {
-    setAttribute(Qt::WA_DeleteOnClose, true);
-    setAttribute(Qt::WA_TranslucentBackground, true);
-    setAttribute(Qt::WA_ShowWithoutActivating, true);
-    setFocusPolicy(Qt::NoFocus);
-
-    if (!this->settings.proxy.isEmpty()) {
-        QUrl proxyUrl(this->settings.proxy);
-        if (proxyUrl.isValid()) {
-            QNetworkProxy proxy;
-            proxy.setType(QNetworkProxy::HttpProxy);
-            proxy.setHostName(proxyUrl.host());
-            proxy.setPort(proxyUrl.port());
-            networkManager->setProxy(proxy);
-        }
-    }
+    , nextEndpoint(0)
+    , requestTokenEstimate(0)
+    , requestGeneration(0)
+    , queuedAttempts(0)
+    , rateLimitRetries(0)
+    , hedgeTimer(new QTimer(this))
+    , renderTimer(new QTimer(this))
+    , insertCooldownTimer(new QTimer(this))
+    , streamInsertActive(false)
+    , streamInsertDone(false) {
+    hedgeTimer->setSingleShot(true);
+    connect(hedgeTimer, &QTimer::timeout, this, &TaskWindow::startHedge);
+    renderTimer->setSingleShot(true);
+    renderTimer->setTimerType(Qt::PreciseTimer);
+    connect(renderTimer, &QTimer::timeout, this, &TaskWindow::updateResponseView);
+    insertCooldownTimer->setSingleShot(true);
+    connect(insertCooldownTimer, &QTimer::timeout, this, &TaskWindow::flushStreamInsert);
+}
 
-    auto *mainLayout = new QVBoxLayout(this);
-    mainLayout->setContentsMargins(10, 10, 10, 10);
-    mainLayout->setSpacing(0);
-
-    auto *container = new QWidget(this);
-    container->setObjectName("container");
-    container->setStyleSheet("QWidget#container { "
-                             "  background-color: white; "
-                             "  border-radius: 0; "
-                             "}");
-
-    auto *shadow = new QGraphicsDropShadowEffect(container);
-    shadow->setBlurRadius(10);
-    shadow->setColor(QColor(0, 0, 0, 160));
-    shadow->setOffset(0, 0);
-    container->setGraphicsEffect(shadow);
-
-    auto *layout = new QVBoxLayout(container);
-    layout->setContentsMargins(2, 2, 2, 2);
-    layout->setSpacing(2);
-
-    for (int i = 0; i < tasks.size(); ++i) {
-        const TaskDefinition &task = tasks.at(i);
-        QString text = task.name.isEmpty() ? tr("<Unnamed>") : task.name;
-        auto *btn = new QPushButton(text, container);
-        btn->setStyleSheet(
-            "QPushButton {"
-            "   text-align: left;"
-            "   padding: 2px 8px;"
-            "   border: 1px solid #adadad;"
-            "   background-color: #e1e1e1;"
-            "}"
-            "QPushButton:focus, QPushButton:hover, QPushButton[menuActive=\"true\"] {"
-            "   outline: 0;"
-            "   border: 1px solid #0078d7;"
-            "   background-color: #e5f1fb;"
-            "}"
-        );
-        btn->setProperty("menuIndex", i);
-        btn->setMouseTracking(true);
-        btn->installEventFilter(this);
-        menuButtons.append(btn);
-        connect(btn, &QPushButton::clicked, this, [this, i]() {
-            activeTaskIndex = i;
-            hide();
-            showLoadingIndicator();
-
-            const QString original = captureSelectedText();
-            if (original.isEmpty()) {
-                hideLoadingIndicator();
-                return;
-            }
+TaskWindow::~TaskWindow() {
+    hideLoadingIndicator();
+    delete responseWindow.data();
+}
 
-            QClipboard *clipboard = QGuiApplication::clipboard();
-            const TaskDefinition task = tasks.at(i);
-            clipboard->setText(task.prompt + original);
+void TaskWindow::start(int taskIndex) {
+    if (taskIndex < 0 || taskIndex >= config->tasks.size())
+        return;
+    activeTaskIndex = taskIndex;
+    activeTask = config->tasks.at(taskIndex);
+    activeTask.prompt = ConfigStore::taskPrompt(activeTask);
+    showLoadingIndicator();
 
-            startConversation(task, original);
-        });
-        layout->addWidget(btn);
+    const QString original = captureSelectedText();
+    if (original.isEmpty()) {
+        hideLoadingIndicator();
+        return;
     }
 
-    mainLayout->addWidget(container);
-
-    adjustSize();
-
-    const QPoint cursorPos = QCursor::pos();
-    moveNearCursor(this, cursorPos);
+    QClipboard *clipboard = QGuiApplication::clipboard();
+    const TaskDefinition task = activeTask;
+    clipboard->setText(task.prompt + original);
 
-    applyNoActivateStyle();
-    show();
-    raise();
-}
-
-TaskWindow::~TaskWindow() {
-    removeMenuHooks();
-    hideLoadingIndicator();
+    startConversation(task, original);
 }
 
 QString TaskWindow::captureSelectedText() {
@@ -513,11 +223,12 @@ void TaskWindow::startConversation(const TaskDefinition &task, const QString &or
 void TaskWindow::sendRequestWithHistory(const TaskDefinition &task) {
     resetRequestState();
     setRequestInFlight(true);
-
-    const QUrl requestUrl = buildApiUrl(settings.apiEndpoint, "chat/completions");
-    QNetworkRequest request(requestUrl);
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-    request.setRawHeader("Authorization", "Bearer " + settings.apiKey.toUtf8());
+    requestTimer.start();
+    streamInsertActive = task.insertMode && task.streamInsert;
+    if (streamInsertActive) {
+        insertBatcher.setMinBatchChars(task.insertBatchChars);
+        insertCooldownTimer->setInterval(qMax(kMinPasteIntervalMs, task.insertDebounceMs));
+    }
 
     QJsonArray messagesArray;
     for (const ChatMessage &msg : messageHistory) {
@@ -536,12 +247,91 @@ void TaskWindow::sendRequestWithHistory(const TaskDefinition &task) {
     body["messages"] = messagesArray;
     body["max_tokens"] = task.maxTokens;
     body["temperature"] = task.temperature;
-    if (!task.insertMode)
+    if (!task.insertMode || task.streamInsert)
         body["stream"] = true;
-    QJsonDocument bodyDoc(body);
+    requestBody = body;
+    // Rough prompt size (4 bytes per token) plus the completion budget.
+    requestTokenEstimate = int(QJsonDocument(messagesArray).toJson(QJsonDocument::Compact).size() / 4)
+                           + task.maxTokens;
+
+    requestCacheKey.clear();
+    requestCacheEndpoint.clear();
+    if (task.cacheResponses) {
+        ResponseCache *cache = ResponseCache::instance();
+        cache->setLimits(qint64(settings.responseCacheMaxMb) * 1024 * 1024,
+                         qint64(settings.responseCacheTtlHours) * 3600 * 1000);
+        requestCacheEndpoint = settings.apiEndpoint;
+        requestCacheKey = ResponseCache::makeKey(requestCacheEndpoint, modelName, messagesArray,
+                                                 task.maxTokens, task.temperature);
+        QString cached;
+        if (cache->lookup(requestCacheKey, &cached)) {
+            qCDebug(lcTask) << "cache hit after" << requestTimer.elapsed() << "ms";
+            requestCacheKey.clear();
+            hideLoadingIndicator();
+            streamInsertActive = false;
+            pendingResponseText = cached;
+            completeResponse(task);
+            return;
+        }
+    }
 
-    QNetworkReply *reply = networkManager->post(request, bodyDoc.toJson());
-    currentReply = reply;
+    const QList<EndpointConfig> endpoints = ConfigStore::endpointList(settings);
+    QList<QUrl> urls;
+    for (const EndpointConfig &endpoint : endpoints)
+        urls.append(buildApiUrl(endpoint.url, "chat/completions"));
+    attemptEndpoints.clear();
+    for (int index : NetworkEngine::instance()->rankEndpoints(urls))
+        attemptEndpoints.append(endpoints.at(index));
+    nextEndpoint = 0;
+
+    if (attemptEndpoints.isEmpty()) {
+        hideLoadingIndicator();
+        QMessageBox::critical(responseWindow, tr("Error"), tr("No API endpoint is configured."));
+        setRequestInFlight(false);
+        return;
+    }
+    startAttempt(task, attemptEndpoints.at(nextEndpoint++), QString(), false);
+    if (task.hedge)
+        scheduleHedge(task);
+}
+
+void TaskWindow::startAttempt(const TaskDefinition &task,
+                              const EndpointConfig &endpoint,
+                              const QString &model,
+                              bool hedge) {
+    // Hedges are pointless once a reply has won.
+    if (hedge && winningReply)
+        return;
+    const qint64 waitMs = RateLimiter::instance()->reserve(
+        buildApiUrl(endpoint.url, "chat/completions"), requestTokenEstimate);
+    if (waitMs > 0) {
+        qCDebug(lcTask) << "rate limit: delaying request by" << waitMs << "ms";
+        queueAttempt(task, endpoint, model, hedge, waitMs);
+        return;
+    }
+
+    QNetworkRequest request(buildApiUrl(endpoint.url, "chat/completions"));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    request.setRawHeader("Authorization", "Bearer " + endpoint.apiKey.toUtf8());
+
+    QJsonObject body = requestBody;
+    if (!model.isEmpty())
+        body["model"] = model;
+
+    NetworkEngine *engine = NetworkEngine::instance();
+    QNetworkReply *reply = engine->post(request, QJsonDocument(body).toJson(), settings.proxy);
+    RequestDeadlines deadlines;
+    deadlines.connectMs = settings.connectTimeoutMs;
+    deadlines.firstByteMs = settings.firstByteTimeoutMs;
+    deadlines.idleMs = settings.idleTimeoutMs;
+    engine->watchDeadlines(reply, deadlines);
+
+    ReplyAttempt &attempt = replyAttempts[reply];
+    attempt.endpoint = endpoint;
+    attempt.hedge = hedge;
+    attempt.model = model;
+    attempt.label = model.isEmpty() ? request.url().host()
+                                    : request.url().host() + '/' + model;
     connect(reply, &QNetworkReply::readyRead, this, [this, task, reply]() {
         handleReplyReadyRead(task, reply);
     });
@@ -550,10 +340,94 @@ void TaskWindow::sendRequestWithHistory(const TaskDefinition &task) {
     });
 }
 
+void TaskWindow::queueAttempt(const TaskDefinition &task,
+                              const EndpointConfig &endpoint,
+                              const QString &model,
+                              bool hedge,
+                              qint64 delayMs) {
+    ++queuedAttempts;
+    const quint64 generation = requestGeneration;
+    QTimer::singleShot(delayMs, this, [this, task, endpoint, model, hedge, generation]() {
+        if (generation != requestGeneration)
+            return;
+        --queuedAttempts;
+        startAttempt(task, endpoint, model, hedge);
+    });
+}
+
+void TaskWindow::scheduleHedge(const TaskDefinition &task) {
+    // Without a hedge model the race needs a second endpoint.
+    if (task.hedgeModel.isEmpty() && nextEndpoint >= attemptEndpoints.size())
+        return;
+    int delayMs = task.hedgeDelayMs;
+    if (delayMs < 0) {
+        const QUrl primaryUrl = buildApiUrl(attemptEndpoints.first().url, "chat/completions");
+        delayMs = NetworkEngine::instance()->firstByteQuantile(primaryUrl, 0.95);
+        if (delayMs < 0)
+            delayMs = kDefaultHedgeDelayMs;
+    }
+    hedgeTimer->start(delayMs);
+}
+
+void TaskWindow::startHedge() {
+    if (activeTaskIndex < 0 || winningReply)
+        return;
+    const TaskDefinition &task = activeTask;
+    qCDebug(lcTask) << "starting hedge after" << requestTimer.elapsed() << "ms";
+    if (!task.hedgeModel.isEmpty())
+        startAttempt(task, attemptEndpoints.first(), normalizeModelName(task.hedgeModel), true);
+    else if (nextEndpoint < attemptEndpoints.size())
+        startAttempt(task, attemptEndpoints.at(nextEndpoint++), QString(), true);
+}
+
+void TaskWindow::declareWinner(QNetworkReply *reply, ReplyAttempt *attempt) {
+    winningReply = reply;
+    hedgeTimer->stop();
+    qCDebug(lcTask).nospace() << (attempt->hedge ? "hedge " : "primary ") << attempt->label
+                              << " won after " << requestTimer.elapsed() << "ms";
+    // Recorded only when a hedge was still in the race.
+    const bool raced = std::any_of(replyAttempts.cbegin(), replyAttempts.cend(),
+                                   [](const ReplyAttempt &other) { return other.hedge; });
+    if (raced) {
+        emit hedgeRaceDecided(tr("%1 %2 (%3 ms)")
+                                  .arg(attempt->hedge ? tr("hedge") : tr("primary"),
+                                       attempt->label)
+                                  .arg(requestTimer.elapsed()));
+    }
+    pendingResponseText = std::exchange(attempt->text, QString());
+    abortReplies(reply);
+}
+
+void TaskWindow::abortReplies(QNetworkReply *keep) {
+    const QList<QNetworkReply *> replies = replyAttempts.keys();
+    for (QNetworkReply *reply : replies) {
+        if (reply == keep)
+            continue;
+        replyAttempts.remove(reply);
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+bool TaskWindow::canFailOver(QNetworkReply *reply) const {
+    if (nextEndpoint >= attemptEndpoints.size())
+        return false;
+    // Once text has reached the user a retry would duplicate it.
+    if (!pendingResponseText.isEmpty() || !streamInsertText.isEmpty())
+        return false;
+    if (NetworkEngine::instance()->connectionStats(reply).expiredDeadline != DeadlineKind::None)
+        return true;
+    if (reply->error() == QNetworkReply::OperationCanceledError)
+        return false;
+    const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return statusCode == 0 || statusCode == 429 || statusCode >= 500;
+}
+
 void TaskWindow::sendFollowUpMessage() {
     if (requestInFlight || !followUpInput)
         return;
-    if (activeTaskIndex < 0 || activeTaskIndex >= tasks.size())
+    if (activeTaskIndex < 0)
         return;
 
     const QString rawText = followUpInput->toPlainText();
@@ -563,88 +437,158 @@ void TaskWindow::sendFollowUpMessage() {
 
     const QString sendText = applyCharLimit(trimmed);
     appendMessageToHistory("user", sendText);
-    appendTranscriptBlock(formatUserMessageBlock(sendText));
+    const QString userBlock = formatUserMessageBlock(sendText);
+    appendTranscriptBlock(userBlock);
+    if (responseView)
+        responseView->appendMessage(userBlock);
     followUpInput->clear();
     updateResponseView();
 
     showLoadingIndicator();
-    sendRequestWithHistory(tasks.at(activeTaskIndex));
+    sendRequestWithHistory(activeTask);
 }
 
 void TaskWindow::handleReplyReadyRead(const TaskDefinition &task, QNetworkReply *reply) {
+    const auto it = replyAttempts.find(reply);
+    if (it == replyAttempts.end())
+        return;
+    ReplyAttempt &attempt = it.value();
     const QByteArray chunk = reply->readAll();
     if (chunk.isEmpty())
         return;
 
-    responseBody.append(chunk);
-    streamBuffer.append(chunk);
-
-    bool appended = false;
-    while (true) {
-        const int lineEnd = streamBuffer.indexOf('\n');
-        if (lineEnd < 0)
-            break;
-        const QByteArray line = streamBuffer.left(lineEnd);
-        streamBuffer.remove(0, lineEnd + 1);
-        const QString delta = parseStreamDelta(line);
-        if (!delta.isEmpty()) {
-            pendingResponseText += delta;
-            appended = true;
-        }
-    }
+    // The winner streams straight into the answer; competitors keep their own text.
+    const bool won = reply == winningReply;
+    QString *text = won ? &pendingResponseText : &attempt.text;
+    const qsizetype textLength = text->size();
+    QByteArray contentType;
+    if (attempt.replyFormat == ReplyFormat::Unknown)
+        contentType = reply->header(QNetworkRequest::ContentTypeHeader).toByteArray().toLower();
+    attempt.feed(chunk, contentType, text);
 
-    if (sawStreamFormat) {
+    if (text->size() == textLength)
+        return;
+    if (!won)
+        declareWinner(reply, &attempt);
+    const qsizetype deltaStart = won ? textLength : 0;
+    // A new winner replaces the answer so far.
+    if (deltaStart == 0)
+        responseUtf8Bytes = 0;
+    responseUtf8Bytes += utf8Length(QStringView(pendingResponseText).sliced(deltaStart));
+
+    if (task.insertMode)
+        updateLoadingProgress();
+    else
         hideLoadingIndicator();
-        if (!task.insertMode)
-            ensureResponseWindow();
-    }
-
-    if (appended && !task.insertMode)
-        updateResponseView();
+    if (!task.insertMode)
+        ensureResponseWindow();
+    if (streamInsertActive)
+        queueStreamInsert(pendingResponseText.mid(deltaStart));
+    if (!task.insertMode)
+        scheduleResponseRender();
 }
 
 void TaskWindow::handleReplyFinished(const TaskDefinition &task, QNetworkReply *reply) {
-    if (reply == currentReply)
-        currentReply = nullptr;
-    hideLoadingIndicator();
+    const auto it = replyAttempts.find(reply);
+    if (it == replyAttempts.end())
+        return;
+    ReplyAttempt attempt = std::move(it.value());
+    replyAttempts.erase(it);
+    reply->deleteLater();
+
+    const bool failed = reply->error() != QNetworkReply::NoError;
+    bool won = reply == winningReply;
+    QString *text = won ? &pendingResponseText : &attempt.text;
+    qsizetype textLength = text->size();
+    attempt.finish(failed, text);
+
+    if (!won) {
+        if (!failed && !attempt.text.isEmpty()) {
+            declareWinner(reply, &attempt);
+            won = true;
+            textLength = 0;
+        } else if (!replyAttempts.isEmpty() || queuedAttempts > 0 || hedgeTimer->isActive()) {
+            // Another competitor is still running; a failure here just
+            // brings the hedge forward.
+            if (failed && hedgeTimer->isActive()) {
+                hedgeTimer->stop();
+                startHedge();
+            }
+            return;
+        }
+    }
+
+    if (won && streamInsertActive && pendingResponseText.size() != textLength)
+        queueStreamInsert(pendingResponseText.mid(textLength));
 
-    if (!streamBuffer.isEmpty()) {
-        const QString delta = parseStreamDelta(streamBuffer);
-        if (!delta.isEmpty())
-            pendingResponseText += delta;
-        streamBuffer.clear();
+    if (failed && canFailOver(reply)) {
+        qCDebug(lcTask) << "failing over from" << attempt.label;
+        startAttempt(task, attemptEndpoints.at(nextEndpoint++), QString(), false);
+        return;
     }
 
-    if (reply->error() != QNetworkReply::NoError) {
-        if (reply->error() == QNetworkReply::OperationCanceledError) {
-            reply->deleteLater();
+    const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (failed && statusCode == 429 && rateLimitRetries < kMaxRateLimitRetries
+        && pendingResponseText.isEmpty() && streamInsertText.isEmpty()) {
+        ++rateLimitRetries;
+        const qint64 delayMs = RateLimiter::instance()->retryDelay(reply->url());
+        qCDebug(lcTask) << "rate limited by" << attempt.label << "- retry" << rateLimitRetries
+                        << "in" << delayMs << "ms";
+        queueAttempt(task, attempt.endpoint, attempt.model, attempt.hedge, delayMs);
+        return;
+    }
+
+    hideLoadingIndicator();
+
+    if (failed) {
+        // Batches already pasted stay; nothing more is inserted.
+        streamInsertActive = false;
+        const DeadlineKind deadline =
+            NetworkEngine::instance()->connectionStats(reply).expiredDeadline;
+        if (reply->error() == QNetworkReply::OperationCanceledError
+            && deadline == DeadlineKind::None) {
             setRequestInFlight(false);
             return;
         }
-        const QString errStr = reply->errorString();
-        const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-        QMessageBox::critical(this,
-                              tr("Error"),
-                              tr("LLM request failed (%1): HTTP status %2")
-                                  .arg(errStr)
-                                  .arg(statusCode));
-        reply->deleteLater();
+        if (deadline != DeadlineKind::None) {
+            QMessageBox::critical(responseWindow,
+                                  tr("Error"),
+                                  tr("LLM request timed out (%1).")
+                                      .arg(deadlineDescription(deadline)));
+        } else {
+            const QString errStr = reply->errorString();
+            QMessageBox::critical(responseWindow,
+                                  tr("Error"),
+                                  tr("LLM request failed (%1): HTTP status %2")
+                                      .arg(errStr)
+                                      .arg(statusCode));
+        }
         setRequestInFlight(false);
         return;
     }
 
-    if (!sawStreamFormat && pendingResponseText.isEmpty()) {
-        pendingResponseText = extractResponseTextFromJson(responseBody);
+    // A hedge on another model answered a different question, and a
+    // fallback endpoint's answer does not belong under the primary's key.
+    if (!requestCacheKey.isEmpty() && attempt.model.isEmpty()
+        && attempt.endpoint.url == requestCacheEndpoint && !pendingResponseText.isEmpty()) {
+        ResponseCache::instance()->insert(requestCacheKey, pendingResponseText);
     }
+    completeResponse(task);
+}
 
-    reply->deleteLater();
-
+void TaskWindow::completeResponse(const TaskDefinition &task) {
     if (!pendingResponseText.isEmpty())
         appendMessageToHistory("assistant", pendingResponseText);
 
     if (task.insertMode) {
-        if (!pendingResponseText.isEmpty())
+        if (streamInsertActive) {
+            streamInsertDone = true;
+            if (!insertCooldownTimer->isActive())
+                flushStreamInsert();
+        } else if (!pendingResponseText.isEmpty()) {
+            qCDebug(lcTask) << "insert after" << requestTimer.elapsed() << "ms";
             insertResponse(pendingResponseText);
+        }
         pendingResponseText.clear();
         setRequestInFlight(false);
         return;
@@ -654,6 +598,8 @@ void TaskWindow::handleReplyFinished(const TaskDefinition &task, QNetworkReply *
         ensureResponseWindow();
         if (!pendingResponseText.isEmpty()) {
             appendTranscriptBlock(pendingResponseText);
+            if (responseView)
+                responseView->finishStreaming(pendingResponseText);
             pendingResponseText.clear();
         }
         updateResponseView();
@@ -679,35 +625,49 @@ void TaskWindow::insertResponse(const QString &text) {
     SendInput(4, pasteInputs, sizeof(INPUT));
 }
 
+void TaskWindow::queueStreamInsert(const QString &delta) {
+    insertBatcher.append(delta);
+    if (!insertCooldownTimer->isActive())
+        flushStreamInsert();
+}
+
+void TaskWindow::flushStreamInsert() {
+    if (!streamInsertActive)
+        return;
+    const QString batch = streamInsertDone ? insertBatcher.takeAll()
+                                           : insertBatcher.takeBoundaryBatch();
+    if (!batch.isEmpty()) {
+        if (streamInsertText.isEmpty())
+            qCDebug(lcTask) << "first insert batch after" << requestTimer.elapsed() << "ms";
+        streamInsertText += batch;
+        insertResponse(batch);
+        insertCooldownTimer->start();
+        return;
+    }
+    if (!streamInsertDone)
+        return;
+    // Leave the clipboard as a non-streamed insert would: holding the whole answer.
+    streamInsertActive = false;
+    if (!streamInsertText.isEmpty())
+        QGuiApplication::clipboard()->setText(streamInsertText);
+    streamInsertText.clear();
+}
+
 void TaskWindow::ensureResponseWindow() {
     if (responseWindow)
         return;
 
-    responseWindow = new QDialog(this);
+    responseWindow = new QDialog();
     responseWindow->setAttribute(Qt::WA_DeleteOnClose, true);
     responseWindow->setWindowFlags(responseWindow->windowFlags() | Qt::Dialog);
     responseWindow->installEventFilter(this);
 
     auto *lay = new QVBoxLayout(responseWindow);
-    auto *view = new MarkdownTextBrowser(responseWindow);
+    auto *view = new TranscriptView(responseWindow);
     responseView = view;
-    QFont font = responseView->font();
-    font.setFamilies(QStringList{"Segoe UI", "Noto Sans", "Helvetica", "Arial"});
-    font.setPointSize(12);
-    responseView->setFont(font);
-    responseView->document()->setDefaultFont(font);
-    responseView->setReadOnly(true);
-    responseView->setOpenExternalLinks(true);
-    responseView->document()->setDefaultStyleSheet(markdownCss());
-    responseView->document()->setDocumentMargin(8);
-    responseView->setStyleSheet("QTextBrowser { background-color: #ffffff; }");
-    new MarkdownCodeHighlighter(responseView->document());
-    view->setZoomCallback([this]() {
-        applyMarkdownStyles();
-    });
-    view->setZoomDeltaCallback([this](int steps) {
-        handleResponseZoomDelta(steps);
-    });
+    for (const QString &block : std::as_const(transcriptBlocks))
+        view->appendMessage(block);
+    connect(view, &TranscriptView::zoomChanged, this, &TaskWindow::handleResponseZoomDelta);
     lay->addWidget(view);
 
     auto *input = new QPlainTextEdit(responseWindow);
@@ -769,69 +729,31 @@ void TaskWindow::ensureResponseWindow() {
     responseWindow->activateWindow();
 }
 
-void TaskWindow::updateResponseView() {
-    if (!responseView)
+void TaskWindow::scheduleResponseRender() {
+    if (renderTimer->isActive())
         return;
-    QScrollBar *bar = responseView->verticalScrollBar();
-    const bool atBottom = bar && bar->value() >= bar->maximum();
-    const QString displayText = buildDisplayMarkdown();
-    responseView->document()->setMarkdown(displayText, QTextDocument::MarkdownDialectGitHub);
-    applyMarkdownStyles();
-    if (atBottom)
-        bar->setValue(bar->maximum());
+    // The first chunk after a quiet period renders on the next event loop
+    // pass; chunks arriving faster than the cadence share one render.
+    const qint64 sinceLast = lastRenderTimer.isValid() ? lastRenderTimer.elapsed() : -1;
+    const int interval = renderIntervalMs();
+    renderTimer->start(sinceLast < 0 ? 0 : int(qMax<qint64>(0, interval - sinceLast)));
 }
 
-void TaskWindow::applyMarkdownStyles() {
-    if (!responseView)
-        return;
-    QTextDocument *doc = responseView->document();
-    if (!doc)
-        return;
-
-    const qreal codeBlockMargin = 8.0;
-    QTextCharFormat inlineCodeFormat;
-    inlineCodeFormat.setFontFamilies(QStringList{"Consolas"});
-    inlineCodeFormat.setFontFixedPitch(true);
-    inlineCodeFormat.setBackground(QColor("#f6f8fa"));
-    const QFont baseFont = resolveBaseTextFont(doc);
-    if (baseFont.pointSizeF() > 0) {
-        inlineCodeFormat.setFontPointSize(baseFont.pointSizeF());
-    } else if (baseFont.pixelSize() > 0) {
-        inlineCodeFormat.setProperty(QTextFormat::FontPixelSize, baseFont.pixelSize());
-    }
-
-    QTextCharFormat blockCodeCharFormat = inlineCodeFormat;
-
-    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next()) {
-        if (isCodeBlock(block)) {
-            QTextCursor blockCursor(block);
-            QTextBlockFormat blockFormat = block.blockFormat();
-            blockFormat.setBackground(QColor("#f6f8fa"));
-            const QTextBlock prevBlock = block.previous();
-            const QTextBlock nextBlock = block.next();
-            const bool isFirstBlock = !prevBlock.isValid() || !isCodeBlock(prevBlock);
-            const bool isLastBlock = !nextBlock.isValid() || !isCodeBlock(nextBlock);
-            blockFormat.setTopMargin(isFirstBlock ? codeBlockMargin : 0.0);
-            blockFormat.setBottomMargin(isLastBlock ? codeBlockMargin : 0.0);
-            blockCursor.setBlockFormat(blockFormat);
-
-            blockCursor.select(QTextCursor::BlockUnderCursor);
-            blockCursor.mergeCharFormat(blockCodeCharFormat);
-            continue;
-        }
+int TaskWindow::renderIntervalMs() const {
+    if (settings.streamRenderIntervalMs > 0)
+        return settings.streamRenderIntervalMs;
+    QScreen *screen = responseWindow ? responseWindow->screen() : QGuiApplication::primaryScreen();
+    const qreal rate = screen && screen->refreshRate() > 1.0 ? screen->refreshRate()
+                                                             : kFallbackRefreshRate;
+    return qMax(1, qRound(1000.0 / rate));
+}
 
-        for (auto it = block.begin(); !it.atEnd(); ++it) {
-            const QTextFragment fragment = it.fragment();
-            if (!fragment.isValid())
-                continue;
-            if (!isInlineCodeFormat(fragment.charFormat()))
-                continue;
-            QTextCursor cursor(doc);
-            cursor.setPosition(fragment.position());
-            cursor.setPosition(fragment.position() + fragment.length(), QTextCursor::KeepAnchor);
-            cursor.mergeCharFormat(inlineCodeFormat);
-        }
-    }
+void TaskWindow::updateResponseView() {
+    // Any direct call flushes a pending coalesced render.
+    renderTimer->stop();
+    lastRenderTimer.start();
+    if (responseView)
+        responseView->setStreamingText(pendingResponseText);
 }
 
 void TaskWindow::updateFollowUpHeight() {
@@ -878,9 +800,7 @@ void TaskWindow::appendMessageToHistory(const QString &role, const QString &cont
 void TaskWindow::appendTranscriptBlock(const QString &markdown) {
     if (markdown.trimmed().isEmpty())
         return;
-    if (!transcriptText.isEmpty() && !transcriptText.endsWith("\n\n"))
-        transcriptText += "\n\n";
-    transcriptText += markdown;
+    transcriptBlocks.append(markdown);
 }
 
 QString TaskWindow::formatUserMessageBlock(const QString &text) const {
@@ -897,44 +817,27 @@ QString TaskWindow::formatUserMessageBlock(const QString &text) const {
     return block;
 }
 
-QString TaskWindow::buildDisplayMarkdown() const {
-    QString displayText = transcriptText;
-    if (!pendingResponseText.isEmpty()) {
-        if (!displayText.isEmpty() && !displayText.endsWith("\n\n"))
-            displayText += "\n\n";
-        displayText += pendingResponseText;
-    }
-    return displayText;
-}
-
-QString TaskWindow::extractResponseTextFromJson(const QByteArray &data) const {
-    const QJsonDocument respDoc = QJsonDocument::fromJson(data);
-    if (!respDoc.isObject())
-        return QString();
-    const QJsonObject respObj = respDoc.object();
-    const QJsonArray choices = respObj.value("choices").toArray();
-    if (choices.isEmpty())
-        return QString();
-    const QJsonObject msg = choices.first().toObject()
-        .value("message")
-        .toObject();
-    return msg.value("content").toString();
-}
-
 void TaskWindow::resetRequestState() {
-    responseBody.clear();
-    streamBuffer.clear();
+    ++requestGeneration;
+    queuedAttempts = 0;
+    rateLimitRetries = 0;
+    hedgeTimer->stop();
+    renderTimer->stop();
+    abortReplies(nullptr);
+    if (responseView)
+        responseView->discardStreaming();
+    winningReply.clear();
+    insertCooldownTimer->stop();
+    insertBatcher.takeAll();
+    streamInsertText.clear();
+    streamInsertActive = false;
+    streamInsertDone = false;
     pendingResponseText.clear();
-    sawStreamFormat = false;
-    if (currentReply) {
-        disconnect(currentReply, nullptr, this, nullptr);
-        currentReply.clear();
-    }
 }
 
 void TaskWindow::resetConversationState() {
     messageHistory.clear();
-    transcriptText.clear();
+    transcriptBlocks.clear();
     pendingResponseText.clear();
     resetRequestState();
     setRequestInFlight(false);
@@ -963,41 +866,25 @@ void TaskWindow::setRequestInFlight(bool inFlight) {
 void TaskWindow::cancelRequest() {
     if (!requestInFlight)
         return;
-    if (currentReply) {
-        currentReply->abort();
+    hedgeTimer->stop();
+    // Drop attempts still waiting on the rate limiter.
+    ++requestGeneration;
+    queuedAttempts = 0;
+    const QList<QNetworkReply *> replies = replyAttempts.keys();
+    if (replies.isEmpty()) {
+        hideLoadingIndicator();
+        setRequestInFlight(false);
+        return;
     }
-}
-
-QString TaskWindow::parseStreamDelta(const QByteArray &line) {
-    const QByteArray trimmed = line.trimmed();
-    if (trimmed.isEmpty())
-        return QString();
-    if (!trimmed.startsWith("data:"))
-        return QString();
-    sawStreamFormat = true;
-    const QByteArray payload = trimmed.mid(5).trimmed();
-    if (payload == "[DONE]")
-        return QString();
-
-    const QJsonDocument doc = QJsonDocument::fromJson(payload);
-    if (!doc.isObject())
-        return QString();
-    const QJsonObject obj = doc.object();
-    const QJsonArray choices = obj.value("choices").toArray();
-    if (choices.isEmpty())
-        return QString();
-    const QJsonObject choice = choices.first().toObject();
-    QString deltaText = choice.value("delta").toObject().value("content").toString();
-    if (deltaText.isEmpty())
-        deltaText = choice.value("message").toObject().value("content").toString();
-    return deltaText;
+    for (QNetworkReply *reply : replies)
+        reply->abort();
 }
 
 void TaskWindow::applyResponsePrefs() {
     QSize targetSize(600, 200);
     int targetZoom = 0;
-    if (activeTaskIndex >= 0 && activeTaskIndex < tasks.size()) {
-        TaskDefinition &task = tasks[activeTaskIndex];
+    if (activeTaskIndex >= 0) {
+        TaskDefinition &task = activeTask;
         if (task.responseWidth > 0 && task.responseHeight > 0)
             targetSize = QSize(task.responseWidth, task.responseHeight);
         targetZoom = task.responseZoom;
@@ -1012,21 +899,16 @@ void TaskWindow::applyResponsePrefs() {
     if (responseWindow)
         responseWindow->resize(targetSize);
 
-    if (responseView) {
-        if (targetZoom > 0)
-            responseView->zoomIn(targetZoom);
-        else if (targetZoom < 0)
-            responseView->zoomOut(-targetZoom);
-        applyMarkdownStyles();
-    }
+    if (responseView)
+        responseView->setZoom(targetZoom);
 }
 
 void TaskWindow::handleResponseResize(const QSize &size) {
     if (!size.isValid())
         return;
-    if (activeTaskIndex < 0 || activeTaskIndex >= tasks.size())
+    if (activeTaskIndex < 0)
         return;
-    TaskDefinition &task = tasks[activeTaskIndex];
+    TaskDefinition &task = activeTask;
     if (task.responseWidth == size.width() && task.responseHeight == size.height())
         return;
     task.responseWidth = size.width();
@@ -1037,9 +919,9 @@ void TaskWindow::handleResponseResize(const QSize &size) {
 void TaskWindow::handleResponseZoomDelta(int steps) {
     if (steps == 0)
         return;
-    if (activeTaskIndex < 0 || activeTaskIndex >= tasks.size())
+    if (activeTaskIndex < 0)
         return;
-    TaskDefinition &task = tasks[activeTaskIndex];
+    TaskDefinition &task = activeTask;
     const int newZoom = task.responseZoom + steps;
     if (newZoom == task.responseZoom)
         return;
@@ -1072,208 +954,16 @@ bool TaskWindow::eventFilter(QObject *watched, QEvent *event) {
         auto *resizeEvent = static_cast<QResizeEvent *>(event);
         handleResponseResize(resizeEvent->size());
     }
-    if (event->type() == QEvent::KeyPress) {
-        auto *keyEvent = static_cast<QKeyEvent*>(event);
-        if ((keyEvent->key() == Qt::Key_Return || keyEvent->key() == Qt::Key_Enter)
-            && qobject_cast<QPushButton*>(watched)) {
-            auto *btn = qobject_cast<QPushButton*>(watched);
-            btn->click();
-            return true;
-        }
-    }
-    if (event->type() == QEvent::Enter) {
-        if (auto *btn = qobject_cast<QPushButton *>(watched)) {
-            bool ok = false;
-            const int index = btn->property("menuIndex").toInt(&ok);
-            if (ok)
-                setMenuActiveIndex(index);
-        }
-    }
-    return QWidget::eventFilter(watched, event);
-}
-
-void TaskWindow::showEvent(QShowEvent *event) {
-    QWidget::showEvent(event);
-    applyNoActivateStyle();
-    const HWND hwnd = reinterpret_cast<HWND>(winId());
-    if (hwnd)
-        ShowWindow(hwnd, SW_SHOWNOACTIVATE);
-    setMenuActiveIndex(-1);
-    installMenuHooks();
-}
-
-void TaskWindow::hideEvent(QHideEvent *event) {
-    removeMenuHooks();
-    QWidget::hideEvent(event);
-}
-
-bool TaskWindow::nativeEvent(const QByteArray &eventType, void *message, qintptr *result) {
-    if (eventType == "windows_generic_MSG" || eventType == "windows_dispatcher_MSG") {
-        auto *msg = static_cast<MSG *>(message);
-        if (msg && msg->message == WM_MOUSEACTIVATE) {
-            if (result)
-                *result = MA_NOACTIVATE;
-            return true;
-        }
-    }
-    return QWidget::nativeEvent(eventType, message, result);
-}
-
-void TaskWindow::installMenuHooks() {
-    s_activeMenu = this;
-    if (!s_keyboardHook) {
-        s_keyboardHook = SetWindowsHookExW(WH_KEYBOARD_LL, LowLevelKeyboardProc,
-                                           GetModuleHandleW(nullptr), 0);
-    }
-    if (!s_mouseHook) {
-        s_mouseHook = SetWindowsHookExW(WH_MOUSE_LL, LowLevelMouseProc,
-                                        GetModuleHandleW(nullptr), 0);
-    }
-}
-
-void TaskWindow::removeMenuHooks() {
-    if (s_activeMenu != this)
-        return;
-    s_activeMenu = nullptr;
-    if (s_keyboardHook) {
-        UnhookWindowsHookEx(s_keyboardHook);
-        s_keyboardHook = nullptr;
-    }
-    if (s_mouseHook) {
-        UnhookWindowsHookEx(s_mouseHook);
-        s_mouseHook = nullptr;
-    }
-}
-
-LRESULT CALLBACK TaskWindow::LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
-    if (nCode == HC_ACTION && s_activeMenu) {
-        const auto *data = reinterpret_cast<KBDLLHOOKSTRUCT *>(lParam);
-        if (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) {
-            if (s_activeMenu->handleHookKey(static_cast<UINT>(data->vkCode)))
-                return 1;
-        }
-    }
-    return CallNextHookEx(nullptr, nCode, wParam, lParam);
-}
-
-LRESULT CALLBACK TaskWindow::LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam) {
-    if (nCode == HC_ACTION && s_activeMenu) {
-        switch (wParam) {
-            case WM_LBUTTONDOWN:
-            case WM_RBUTTONDOWN:
-            case WM_MBUTTONDOWN:
-            case WM_XBUTTONDOWN: {
-                const auto *data = reinterpret_cast<MSLLHOOKSTRUCT *>(lParam);
-                s_activeMenu->handleHookMouseClick(data->pt);
-                break;
-            }
-            default:
-                break;
-        }
-    }
-    return CallNextHookEx(nullptr, nCode, wParam, lParam);
-}
-
-bool TaskWindow::handleHookKey(UINT vk) {
-    if (!isVisible())
-        return false;
-    const bool shift = (GetAsyncKeyState(VK_SHIFT) & 0x8000) != 0;
-    switch (vk) {
-        case VK_ESCAPE:
-            close();
-            return true;
-        case VK_TAB:
-            if (shift)
-                selectPreviousMenuItem();
-            else
-                selectNextMenuItem();
-            return true;
-        case VK_LEFT:
-        case VK_UP:
-            selectPreviousMenuItem();
-            return true;
-        case VK_RIGHT:
-        case VK_DOWN:
-            selectNextMenuItem();
-            return true;
-        case VK_RETURN:
-        case VK_SPACE:
-            activateMenuItem();
-            return true;
-        default:
-            return false;
-    }
-}
-
-void TaskWindow::handleHookMouseClick(const POINT &pt) {
-    if (!isVisible())
-        return;
-    if (!isPointInsideMenu(pt))
-        close();
-}
-
-bool TaskWindow::isPointInsideMenu(const POINT &pt) const {
-    const HWND hwnd = reinterpret_cast<HWND>(winId());
-    if (!hwnd)
-        return false;
-    RECT rect{};
-    if (!GetWindowRect(hwnd, &rect))
-        return false;
-    return PtInRect(&rect, pt) != 0;
-}
-
-void TaskWindow::setMenuActiveIndex(int index) {
-    if (index < -1 || index >= menuButtons.size())
-        return;
-    if (menuActiveIndex == index)
-        return;
-    menuActiveIndex = index;
-    for (int i = 0; i < menuButtons.size(); ++i) {
-        QPushButton *btn = menuButtons[i];
-        const bool active = (i == menuActiveIndex);
-        if (btn->property("menuActive").toBool() == active)
-            continue;
-        btn->setProperty("menuActive", active);
-        btn->style()->unpolish(btn);
-        btn->style()->polish(btn);
-        btn->update();
-    }
+    return QObject::eventFilter(watched, event);
 }
 
-void TaskWindow::selectNextMenuItem() {
-    if (menuButtons.isEmpty())
+void TaskWindow::handleHookMouseMove() {
+    // The hook can fire far more often than the screen refreshes; moves are
+    // coalesced into one per event loop pass.
+    if (loadingMovePending)
         return;
-    if (menuActiveIndex < 0)
-        setMenuActiveIndex(0);
-    else
-        setMenuActiveIndex((menuActiveIndex + 1) % menuButtons.size());
-}
-
-void TaskWindow::selectPreviousMenuItem() {
-    if (menuButtons.isEmpty())
-        return;
-    if (menuActiveIndex < 0)
-        setMenuActiveIndex(menuButtons.size() - 1);
-    else
-        setMenuActiveIndex((menuActiveIndex - 1 + menuButtons.size()) % menuButtons.size());
-}
-
-void TaskWindow::activateMenuItem() {
-    if (menuActiveIndex < 0 || menuActiveIndex >= menuButtons.size())
-        return;
-    menuButtons[menuActiveIndex]->click();
-}
-
-void TaskWindow::applyNoActivateStyle() {
-    const HWND hwnd = reinterpret_cast<HWND>(winId());
-    if (!hwnd)
-        return;
-    const LONG_PTR exStyle = GetWindowLongPtrW(hwnd, GWL_EXSTYLE);
-    const LONG_PTR desired = exStyle | WS_EX_NOACTIVATE | WS_EX_TOOLWINDOW;
-    if (desired != exStyle)
-        SetWindowLongPtrW(hwnd, GWL_EXSTYLE, desired);
-    SetWindowPos(hwnd, nullptr, 0, 0, 0, 0,
-                 SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE | SWP_FRAMECHANGED);
+    loadingMovePending = true;
+    QMetaObject::invokeMethod(this, &TaskWindow::updateLoadingPosition, Qt::QueuedConnection);
 }
 
 void TaskWindow::showLoadingIndicator() {
@@ -1285,9 +975,8 @@ void TaskWindow::showLoadingIndicator() {
     loadingWindow->setAttribute(Qt::WA_TransparentForMouseEvents);
     loadingWindow->setFocusPolicy(Qt::NoFocus);
 
-    QLabel *label = new QLabel(tr("Loading"), loadingWindow);
+    QLabel *label = new QLabel(tr("Loading..."), loadingWindow);
     loadingLabel = label;
-    dotCount = 0;
 
     QVBoxLayout *lay = new QVBoxLayout(loadingWindow);
     lay->setContentsMargins(5, 5, 5, 5);
@@ -1298,28 +987,17 @@ void TaskWindow::showLoadingIndicator() {
     updateLoadingPosition();
     loadingWindow->show();
 
-    loadingTimer = new QTimer(this);
-    connect(loadingTimer, &QTimer::timeout,
-            this, &TaskWindow::updateLoadingPosition);
-    loadingTimer->start(16);
-
-    animationTimer = new QTimer(this);
-    connect(animationTimer, &QTimer::timeout,
-            this, &TaskWindow::animateLoadingText);
-    animationTimer->start(500);
+    // Follows the cursor from mouse-move events only; nothing runs while
+    // the mouse is still.
+    MouseHook::subscribe(this, [this](WPARAM message, const MSLLHOOKSTRUCT &) {
+        if (message == WM_MOUSEMOVE)
+            handleHookMouseMove();
+    });
 }
 
 void TaskWindow::hideLoadingIndicator() {
-    if (loadingTimer) {
-        loadingTimer->stop();
-        loadingTimer->deleteLater();
-        loadingTimer = nullptr;
-    }
-    if (animationTimer) {
-        animationTimer->stop();
-        animationTimer->deleteLater();
-        animationTimer = nullptr;
-    }
+    MouseHook::unsubscribe(this);
+    streamProgressTimer.invalidate();
     if (loadingWindow) {
         loadingWindow->close();
         loadingWindow->deleteLater();
@@ -1329,26 +1007,30 @@ void TaskWindow::hideLoadingIndicator() {
 }
 
 void TaskWindow::updateLoadingPosition() {
+    loadingMovePending = false;
     if (!loadingWindow)
         return;
     const QPoint pos = QCursor::pos();
     loadingWindow->move(pos.x() + 10, pos.y() + 10);
 }
 
-void TaskWindow::animateLoadingText() {
+void TaskWindow::updateLoadingProgress() {
     if (!loadingLabel)
         return;
-    dotCount = (dotCount + 1) % 4;
-    loadingLabel->setText(tr("Loading") + QString(dotCount, '.'));
-    if (loadingWindow) {
-        loadingWindow->adjustSize();
-        updateLoadingPosition();
+    if (!streamProgressTimer.isValid()) {
+        streamProgressTimer.start();
+        lastProgressMs = -kLoadingProgressIntervalMs;
     }
+    const qint64 elapsed = streamProgressTimer.elapsed();
+    if (elapsed - lastProgressMs < kLoadingProgressIntervalMs)
+        return;
+    lastProgressMs = elapsed;
+    // Same estimate as the request budget: about 4 bytes per token.
+    const qint64 tokens = (responseUtf8Bytes + 3) / 4;
+    QString text = tr("%1 tokens").arg(tokens);
+    if (elapsed > 0)
+        text += tr(", %1 tok/s").arg(tokens * 1000.0 / elapsed, 0, 'f', 1);
+    loadingLabel->setText(text);
+    loadingWindow->adjustSize();
 }
 
-void TaskWindow::keyPressEvent(QKeyEvent *ev) {
-    if (ev->key() == Qt::Key_Escape)
-        close();
-    else
-        QWidget::keyPressEvent(ev);
-}
@@ -1,7 +1,11 @@
 #ifndef TASKWINDOW_H
 #define TASKWINDOW_H
 
-#include <QWidget>
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
 #include <QList>
 #include <QEvent>
 #include <QKeyEvent>
@@ -9,120 +13,144 @@
 #include <QLabel>
 #include <QPointer>
 #include <QSize>
+#include <QStringList>
 
 #include <windows.h>
 
+#include "configmodel.h"
 #include "configstore.h"
+#include "insertbatcher.h"
+#include "replyattempt.h"
 
-class QByteArray;
-class QHideEvent;
 class QPushButton;
-class QShowEvent;
-class QNetworkAccessManager;
 class QNetworkReply;
-class QTextBrowser;
 class QDialog;
 class QPlainTextEdit;
+class TranscriptView;
 
 struct ChatMessage {
     QString role;
     QString content;
 };
 
-class TaskWindow : public QWidget {
+/**
+ * @brief One task run: captures the selection, sends the request and shows
+ *        the reply in the response window or pastes it back.
+ *
+ *  The menu that starts it lives in TaskMenu; a session is replaced when
+ *  the next task is picked.
+ */
+class TaskWindow : public QObject {
     Q_OBJECT
 
 public:
-    explicit TaskWindow(const QList<TaskDefinition> &taskList,
-                        const AppSettings &settings,
-                        QWidget *parent = nullptr);
+    explicit TaskWindow(const ConfigSnapshot &snapshot, QObject *parent = nullptr);
     ~TaskWindow() override;
 
+    void start(int taskIndex);
+
 signals:
     void taskResponsePrefsChanged(int taskIndex, const QSize &size, int zoom);
     void taskResponsePrefsCommitRequested();
+    /// A hedged request was decided; winner names the side and the reply.
+    void hedgeRaceDecided(const QString &winner);
 
 protected:
-    void keyPressEvent(QKeyEvent *ev) override;
     bool eventFilter(QObject *watched, QEvent *event) override;
-    void showEvent(QShowEvent *event) override;
-    void hideEvent(QHideEvent *event) override;
-    bool nativeEvent(const QByteArray &eventType, void *message, qintptr *result) override;
 
 private slots:
     void updateLoadingPosition();
-    void animateLoadingText();
     void sendFollowUpMessage();
+    void startHedge();
 
 private:
-    QList<TaskDefinition> tasks;
+    ConfigSnapshot config;
+    const AppSettings &settings;
     int activeTaskIndex;
-    AppSettings settings;
-    QNetworkAccessManager *networkManager;
+    // Own copy of the running task; the response window keeps its size here.
+    TaskDefinition activeTask;
     QWidget *loadingWindow;
-    QTimer *loadingTimer;
     QLabel *loadingLabel;
-    QTimer *animationTimer;
-    int dotCount;
+    bool loadingMovePending;
+    QElapsedTimer streamProgressTimer;
+    qint64 lastProgressMs;
+    // UTF-8 size of pendingResponseText, kept up to date chunk by chunk.
+    qsizetype responseUtf8Bytes;
 
     QPointer<QDialog> responseWindow;
-    QPointer<QTextBrowser> responseView;
+    QPointer<TranscriptView> responseView;
     QPointer<QPlainTextEdit> followUpInput;
     QPointer<QPushButton> stopButton;
-    QPointer<QNetworkReply> currentReply;
-    QByteArray responseBody;
-    QByteArray streamBuffer;
-    QString transcriptText;
+    QHash<QNetworkReply *, ReplyAttempt> replyAttempts;
+    QPointer<QNetworkReply> winningReply;
+    QStringList transcriptBlocks;
     QString pendingResponseText;
     QList<ChatMessage> messageHistory;
-    bool sawStreamFormat;
     bool requestInFlight;
-    QList<QPushButton *> menuButtons;
-    int menuActiveIndex;
-
-    static TaskWindow *s_activeMenu;
-    static HHOOK s_keyboardHook;
-    static HHOOK s_mouseHook;
-    static LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
-    static LRESULT CALLBACK LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam);
+    QElapsedTimer requestTimer;
+    QJsonObject requestBody;
+    QByteArray requestCacheKey;
+    // Endpoint the cache key was built for; other endpoints' answers are
+    // not stored under it.
+    QString requestCacheEndpoint;
+    QList<EndpointConfig> attemptEndpoints;
+    int nextEndpoint;
+    int requestTokenEstimate;
+    quint64 requestGeneration;
+    int queuedAttempts;
+    int rateLimitRetries;
+    QTimer *hedgeTimer;
+    QTimer *renderTimer;
+    QElapsedTimer lastRenderTimer;
+    InsertBatcher insertBatcher;
+    QTimer *insertCooldownTimer;
+    QString streamInsertText;
+    bool streamInsertActive;
+    bool streamInsertDone;
 
     QString captureSelectedText();
     QString applyCharLimit(const QString &text) const;
     void startConversation(const TaskDefinition &task, const QString &originalText);
     void sendRequestWithHistory(const TaskDefinition &task);
+    void startAttempt(const TaskDefinition &task,
+                      const EndpointConfig &endpoint,
+                      const QString &model,
+                      bool hedge);
+    void queueAttempt(const TaskDefinition &task,
+                      const EndpointConfig &endpoint,
+                      const QString &model,
+                      bool hedge,
+                      qint64 delayMs);
+    void scheduleHedge(const TaskDefinition &task);
+    void declareWinner(QNetworkReply *reply, ReplyAttempt *attempt);
+    void abortReplies(QNetworkReply *keep);
+    bool canFailOver(QNetworkReply *reply) const;
     void handleReplyReadyRead(const TaskDefinition &task, QNetworkReply *reply);
     void handleReplyFinished(const TaskDefinition &task, QNetworkReply *reply);
+    void completeResponse(const TaskDefinition &task);
     void insertResponse(const QString &text);
+    void queueStreamInsert(const QString &delta);
+    void flushStreamInsert();
     void ensureResponseWindow();
+    void scheduleResponseRender();
+    int renderIntervalMs() const;
     void updateResponseView();
-    void applyMarkdownStyles();
     void updateFollowUpHeight();
     void appendMessageToHistory(const QString &role, const QString &content);
     void appendTranscriptBlock(const QString &markdown);
     QString formatUserMessageBlock(const QString &text) const;
-    QString buildDisplayMarkdown() const;
-    QString extractResponseTextFromJson(const QByteArray &data) const;
     void resetRequestState();
     void resetConversationState();
     void setRequestInFlight(bool inFlight);
     void cancelRequest();
-    QString parseStreamDelta(const QByteArray &line);
     void applyResponsePrefs();
     void handleResponseResize(const QSize &size);
     void handleResponseZoomDelta(int steps);
-    void installMenuHooks();
-    void removeMenuHooks();
-    bool handleHookKey(UINT vk);
-    void handleHookMouseClick(const POINT &pt);
-    bool isPointInsideMenu(const POINT &pt) const;
-    void setMenuActiveIndex(int index);
-    void selectNextMenuItem();
-    void selectPreviousMenuItem();
-    void activateMenuItem();
-    void applyNoActivateStyle();
+    void handleHookMouseMove();
 
     void showLoadingIndicator();
     void hideLoadingIndicator();
+    void updateLoadingProgress();
 };
 
 #endif // TASKWINDOW_H
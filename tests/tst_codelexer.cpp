@@ -0,0 +1,234 @@
+#include "codelexer.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTest>
+
+namespace {
+constexpr int kBlockLines = 6000;
+constexpr int kTimedRuns = 5;
+
+/**
+ * The highlighter as it was before CodeLexer: one global regex pass per
+ * token class over every line, with setFormat() replaced by recording the
+ * ranges.
+ */
+class RegexHighlighter {
+public:
+    RegexHighlighter()
+        : keywordPattern("\\b(auto|bool|break|case|catch|class|const|continue|def|default|"
+                         "delete|do|else|enum|export|extends|false|final|finally|for|"
+                         "foreach|from|function|if|implements|import|inline|interface|"
+                         "lambda|let|namespace|new|nullptr|null|operator|private|protected|"
+                         "public|return|static|struct|switch|template|this|throw|true|try|"
+                         "typedef|typename|using|var|virtual|void|volatile|while)\\b")
+        , stringPatterns{QRegularExpression(R"("([^"\\]|\\.)*")"),
+                         QRegularExpression(R"('([^'\\]|\\.)*')")}
+        , numberPattern("\\b\\d+(?:\\.\\d+)?\\b")
+        , commentPatterns{QRegularExpression("//[^\\n]*"), QRegularExpression("#[^\\n]*")}
+        , blockCommentStart("/\\*")
+        , blockCommentEnd("\\*/") {}
+
+    int highlightLine(const QString &text, int state, QList<CodeLexer::Token> *tokens) const {
+        addMatches(keywordPattern, text, CodeLexer::TokenKind::Keyword, tokens);
+        for (const QRegularExpression &pattern : stringPatterns)
+            addMatches(pattern, text, CodeLexer::TokenKind::String, tokens);
+        addMatches(numberPattern, text, CodeLexer::TokenKind::Number, tokens);
+        for (const QRegularExpression &pattern : commentPatterns)
+            addMatches(pattern, text, CodeLexer::TokenKind::Comment, tokens);
+
+        int nextState = 0;
+        int startIndex = 0;
+        if (state != 1) {
+            const QRegularExpressionMatch match = blockCommentStart.match(text);
+            startIndex = match.hasMatch() ? int(match.capturedStart()) : -1;
+        }
+        while (startIndex >= 0) {
+            const QRegularExpressionMatch endMatch = blockCommentEnd.match(text, startIndex);
+            int length = 0;
+            if (endMatch.hasMatch()) {
+                length = int(endMatch.capturedEnd()) - startIndex;
+            } else {
+                nextState = 1;
+                length = int(text.length()) - startIndex;
+            }
+            tokens->append({startIndex, length, CodeLexer::TokenKind::Comment});
+            const QRegularExpressionMatch next = blockCommentStart.match(text, startIndex + length);
+            startIndex = next.hasMatch() ? int(next.capturedStart()) : -1;
+        }
+        return nextState;
+    }
+
+private:
+    QRegularExpression keywordPattern;
+    QList<QRegularExpression> stringPatterns;
+    QRegularExpression numberPattern;
+    QList<QRegularExpression> commentPatterns;
+    QRegularExpression blockCommentStart;
+    QRegularExpression blockCommentEnd;
+
+    static void addMatches(const QRegularExpression &pattern, const QString &text,
+                           CodeLexer::TokenKind kind, QList<CodeLexer::Token> *tokens) {
+        auto it = pattern.globalMatch(text);
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            tokens->append({int(match.capturedStart()), int(match.capturedLength()), kind});
+        }
+    }
+};
+
+QStringList cppBlock() {
+    const QStringList sample = {
+        "/* Parses one chunk of the stream.",
+        "   Returns false on malformed input. */",
+        "static bool parseChunk(const QByteArray &chunk, int limit) {",
+        "    for (int i = 0; i < limit; ++i) { // walk every byte",
+        "        if (chunk.at(i) == '\\n' && i + 1 < 4096)",
+        "            return handleLine(\"data: \\\"escaped\\\"\", 3.14159);",
+        "    }",
+        "    const auto value = std::max<qsizetype>(0, chunk.size() - 0x20);",
+        "    return value != 0 && !chunk.isEmpty(); /* inline */ }",
+        "",
+    };
+    QStringList lines;
+    while (lines.size() < kBlockLines)
+        lines += sample;
+    return lines;
+}
+
+QStringList pythonBlock() {
+    const QStringList sample = {
+        "def parse_chunk(chunk: bytes, limit: int = 4096) -> bool:",
+        "    \"\"\"Parses one chunk of the stream.\"\"\"",
+        "    for i, byte in enumerate(chunk[:limit]):  # walk every byte",
+        "        if byte == 10 and i + 1 < limit:",
+        "            return handle_line(f'data: {i!r}', 3.14159)",
+        "    return len(chunk) > 0x20 and not None",
+        "",
+    };
+    QStringList lines;
+    while (lines.size() < kBlockLines)
+        lines += sample;
+    return lines;
+}
+
+qint64 lexerNs(const QStringList &lines, CodeLexer::Language language) {
+    QList<CodeLexer::Token> tokens;
+    QElapsedTimer timer;
+    timer.start();
+    int state = CodeLexer::Normal;
+    for (const QString &line : lines) {
+        tokens.clear();
+        state = CodeLexer::lexLine(line, language, state, &tokens);
+    }
+    return timer.nsecsElapsed();
+}
+
+qint64 regexNs(const QStringList &lines) {
+    const RegexHighlighter highlighter;
+    QList<CodeLexer::Token> tokens;
+    QElapsedTimer timer;
+    timer.start();
+    int state = 0;
+    for (const QString &line : lines) {
+        tokens.clear();
+        state = highlighter.highlightLine(line, state, &tokens);
+    }
+    return timer.nsecsElapsed();
+}
+
+template<typename Run>
+qint64 fastest(Run run) {
+    qint64 best = -1;
+    for (int i = 0; i < kTimedRuns; ++i) {
+        const qint64 ns = run();
+        if (best < 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+} // namespace
+
+class TestCodeLexer : public QObject {
+    Q_OBJECT
+
+private slots:
+    void stringsAndCommentsDoNotOverlap();
+    void keywordsDependOnLanguage();
+    void blockCommentSpansLines();
+    void fiveTimesFasterThanRegex_data();
+    void fiveTimesFasterThanRegex();
+    void highlight_data();
+    void highlight();
+};
+
+void TestCodeLexer::stringsAndCommentsDoNotOverlap() {
+    QList<CodeLexer::Token> tokens;
+    CodeLexer::lexLine(u"call(\"// not a comment\"); // real", CodeLexer::Language::Cpp,
+                       CodeLexer::Normal, &tokens);
+    QCOMPARE(tokens.size(), 2);
+    QCOMPARE(tokens.at(0).kind, CodeLexer::TokenKind::String);
+    QCOMPARE(tokens.at(0).start, 5);
+    QCOMPARE(tokens.at(0).length, 18);
+    QCOMPARE(tokens.at(1).kind, CodeLexer::TokenKind::Comment);
+    QCOMPARE(tokens.at(1).start, 26);
+}
+
+void TestCodeLexer::keywordsDependOnLanguage() {
+    QVERIFY(CodeLexer::isKeyword(CodeLexer::Language::Python, u"def"));
+    QVERIFY(!CodeLexer::isKeyword(CodeLexer::Language::Cpp, u"def"));
+    QVERIFY(CodeLexer::isKeyword(CodeLexer::Language::Sql, u"SELECT"));
+    QCOMPARE(CodeLexer::languageForFence(u"ts"), CodeLexer::Language::JavaScript);
+}
+
+void TestCodeLexer::blockCommentSpansLines() {
+    QList<CodeLexer::Token> tokens;
+    const int state = CodeLexer::lexLine(u"int x; /* open", CodeLexer::Language::Cpp,
+                                         CodeLexer::Normal, &tokens);
+    QCOMPARE(state, int(CodeLexer::BlockComment));
+    tokens.clear();
+    QCOMPARE(CodeLexer::lexLine(u"still */ return 1;", CodeLexer::Language::Cpp, state, &tokens),
+             int(CodeLexer::Normal));
+    QCOMPARE(tokens.first().kind, CodeLexer::TokenKind::Comment);
+    QCOMPARE(tokens.first().length, 8);
+}
+
+void TestCodeLexer::fiveTimesFasterThanRegex_data() {
+    QTest::addColumn<QStringList>("lines");
+    QTest::addColumn<CodeLexer::Language>("language");
+    QTest::newRow("cpp") << cppBlock() << CodeLexer::Language::Cpp;
+    QTest::newRow("python") << pythonBlock() << CodeLexer::Language::Python;
+}
+
+void TestCodeLexer::fiveTimesFasterThanRegex() {
+    QFETCH(QStringList, lines);
+    QFETCH(CodeLexer::Language, language);
+    const qint64 lexer = fastest([&]() { return lexerNs(lines, language); });
+    const qint64 regex = fastest([&]() { return regexNs(lines); });
+    qInfo() << lines.size() << "lines: lexer" << lexer / 1000 << "us, regex passes"
+            << regex / 1000 << "us," << double(regex) / qMax<qint64>(lexer, 1) << "x";
+    QVERIFY2(regex >= 5 * lexer, "the lexer is less than 5x faster than the regex passes");
+}
+
+void TestCodeLexer::highlight_data() {
+    QTest::addColumn<bool>("lexer");
+    QTest::newRow("CodeLexer") << true;
+    QTest::newRow("regex passes") << false;
+}
+
+void TestCodeLexer::highlight() {
+    QFETCH(bool, lexer);
+    const QStringList lines = cppBlock();
+    QBENCHMARK {
+        if (lexer)
+            lexerNs(lines, CodeLexer::Language::Cpp);
+        else
+            regexNs(lines);
+    }
+}
+
+QTEST_APPLESS_MAIN(TestCodeLexer)
+
+#include "tst_codelexer.moc"
@@ -0,0 +1,118 @@
+#include "deltaextractor.h"
+
+#include <QList>
+#include <QTest>
+
+namespace {
+constexpr int kRecordedEvents = 2000;
+
+// Event payloads shaped like an OpenAI chat completion stream: a role
+// chunk, content chunks with escapes and non-ASCII text, and a final chunk
+// with finish_reason and usage.
+QList<QByteArray> recordedStream() {
+    const QList<QByteArray> tokens = {
+        "Hello", ",", " world", "\\n", "\\\"quoted\\\"", " caf\\u00e9", " \\ud83d\\ude00",
+        " tab\\t", " path C:\\\\temp", " \xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82",
+    };
+    const QByteArray head = "{\"id\":\"chatcmpl-9x2\",\"object\":\"chat.completion.chunk\","
+                            "\"created\":1718000000,\"model\":\"gpt-4o-mini\","
+                            "\"system_fingerprint\":\"fp_1\",\"choices\":[{\"index\":0,";
+    QList<QByteArray> events;
+    events.append(head + "\"delta\":{\"role\":\"assistant\",\"content\":\"\"},"
+                         "\"logprobs\":null,\"finish_reason\":null}]}");
+    for (int i = 0; i < kRecordedEvents; ++i) {
+        events.append(head + "\"delta\":{\"content\":\"" + tokens.at(i % tokens.size())
+                      + "\"},\"logprobs\":null,\"finish_reason\":null}]}");
+    }
+    events.append(head + "\"delta\":{},\"logprobs\":null,\"finish_reason\":\"stop\"}],"
+                         "\"usage\":{\"prompt_tokens\":12,\"completion_tokens\":2000}}");
+    return events;
+}
+} // namespace
+
+class TestDeltaExtractor : public QObject {
+    Q_OBJECT
+
+private slots:
+    void matchesJsonDocument_data();
+    void matchesJsonDocument();
+    void unexpectedShapeFallsBack();
+    void recordedStreamMatches();
+    void extract_data();
+    void extract();
+};
+
+void TestDeltaExtractor::matchesJsonDocument_data() {
+    QTest::addColumn<QByteArray>("payload");
+    QTest::addColumn<QString>("expected");
+    QTest::newRow("plain") << QByteArray(R"({"choices":[{"delta":{"content":"abc"}}]})")
+                           << QString("abc");
+    QTest::newRow("escapes") << QByteArray(R"({"choices":[{"delta":{"content":"a\n\t\"\\\/b"}}]})")
+                             << QString("a\n\t\"\\/b");
+    QTest::newRow("surrogate pair")
+        << QByteArray(R"({"choices":[{"delta":{"content":"\ud83d\ude00"}}]})")
+        << QString::fromUtf8("\xf0\x9f\x98\x80");
+    QTest::newRow("utf-8") << QByteArray("{\"choices\":[{\"delta\":{\"content\":\"\xc3\xa9\"}}]}")
+                           << QString::fromUtf8("\xc3\xa9");
+    QTest::newRow("skipped values")
+        << QByteArray(R"({"x":[1,{"y":"}"}],"choices":[{"index":0,"logprobs":null,)"
+                      R"("delta":{"role":"assistant","content":"ok"}}]})")
+        << QString("ok");
+    QTest::newRow("null content") << QByteArray(R"({"choices":[{"delta":{"content":null}}]})")
+                                  << QString();
+    QTest::newRow("message") << QByteArray(R"({"choices":[{"message":{"content":"full"}}]})")
+                             << QString("full");
+}
+
+void TestDeltaExtractor::matchesJsonDocument() {
+    QFETCH(QByteArray, payload);
+    QFETCH(QString, expected);
+    QString fast;
+    QVERIFY(DeltaExtractor::extractContentFast(payload, &fast));
+    QCOMPARE(fast, expected);
+    QCOMPARE(DeltaExtractor::extractContentWithJsonDocument(payload), expected);
+}
+
+void TestDeltaExtractor::unexpectedShapeFallsBack() {
+    QString fast;
+    QVERIFY(!DeltaExtractor::extractContentFast("[1,2]", &fast));
+    QCOMPARE(DeltaExtractor::extractContent("{\"choices\":[]}"), QString());
+    QCOMPARE(DeltaExtractor::extractContent("not json"), QString());
+}
+
+void TestDeltaExtractor::recordedStreamMatches() {
+    for (const QByteArray &payload : recordedStream()) {
+        QString fast;
+        QVERIFY2(DeltaExtractor::extractContentFast(payload, &fast), payload.constData());
+        QCOMPARE(fast, DeltaExtractor::extractContentWithJsonDocument(payload));
+    }
+}
+
+void TestDeltaExtractor::extract_data() {
+    QTest::addColumn<bool>("fast");
+    QTest::newRow("fast path") << true;
+    QTest::newRow("QJsonDocument") << false;
+}
+
+void TestDeltaExtractor::extract() {
+    QFETCH(bool, fast);
+    const QList<QByteArray> events = recordedStream();
+    QString text;
+    QBENCHMARK {
+        text.clear();
+        for (const QByteArray &payload : events) {
+            if (fast) {
+                QString content;
+                DeltaExtractor::extractContentFast(payload, &content);
+                text += content;
+            } else {
+                text += DeltaExtractor::extractContentWithJsonDocument(payload);
+            }
+        }
+    }
+    QVERIFY(text.startsWith(QLatin1String("Hello, world\n")));
+}
+
+QTEST_APPLESS_MAIN(TestDeltaExtractor)
+
+#include "tst_deltaextractor.moc"
@@ -0,0 +1,143 @@
+#include "markdownview.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTest>
+#include <QTextDocument>
+
+namespace {
+constexpr int kFramesPerMessage = 60;
+constexpr qreal kTextWidth = 600;
+
+QString finishedMessage(int index) {
+    QString text = QString("## Step %1\n\n").arg(index);
+    for (int i = 0; i < 6; ++i) {
+        text += "The refactoring keeps the public interface and moves the parsing into "
+                "a helper with `parseChunk()`, so callers do not change.\n\n";
+    }
+    text += "```cpp\nint main() {\n    return run(argc, argv); // entry\n}\n```\n\n"
+            "- first point\n- second point\n";
+    return text;
+}
+
+// The states a streaming answer goes through, one per rendered frame.
+QStringList streamingFrames() {
+    QStringList frames;
+    QString text;
+    for (int i = 0; i < kFramesPerMessage; ++i) {
+        text += i % 12 == 11 ? QString("done.\n\n") : QString("token%1 ").arg(i);
+        frames.append(text);
+    }
+    return frames;
+}
+
+void forceLayout(QTextDocument *document) {
+    document->documentLayout()->documentSize();
+}
+
+struct IncrementalRenderer {
+    QTextDocument document;
+    MarkdownStyler *styler;
+    MarkdownTranscript *transcript;
+
+    explicit IncrementalRenderer(int messages)
+        : styler(new MarkdownStyler(&document))
+        , transcript(new MarkdownTranscript(&document)) {
+        document.setTextWidth(kTextWidth);
+        for (int i = 0; i < messages; ++i)
+            transcript->appendMessage(finishedMessage(i));
+        styler->apply();
+        forceLayout(&document);
+    }
+
+    void frame(const QString &streamingText) {
+        transcript->setStreamingText(streamingText);
+        styler->apply();
+        forceLayout(&document);
+    }
+};
+
+// What TaskWindow did before: the whole transcript is parsed and restyled
+// on every chunk.
+struct FullRenderer {
+    QTextDocument document;
+    MarkdownStyler *styler;
+    QString transcript;
+
+    explicit FullRenderer(int messages)
+        : styler(new MarkdownStyler(&document)) {
+        document.setTextWidth(kTextWidth);
+        for (int i = 0; i < messages; ++i)
+            transcript += finishedMessage(i) + "\n\n";
+    }
+
+    void frame(const QString &streamingText) {
+        document.setMarkdown(transcript + streamingText, QTextDocument::MarkdownDialectGitHub);
+        styler->invalidate();
+        styler->apply();
+        forceLayout(&document);
+    }
+};
+
+qint64 incrementalFrameNs(int messages) {
+    IncrementalRenderer renderer(messages);
+    const QStringList frames = streamingFrames();
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString &frame : frames)
+        renderer.frame(frame);
+    return timer.nsecsElapsed() / frames.size();
+}
+} // namespace
+
+class TestMarkdownTranscript : public QObject {
+    Q_OBJECT
+
+private slots:
+    void frameTimeStaysFlat();
+    void frameTime_data();
+    void frameTime();
+};
+
+void TestMarkdownTranscript::frameTimeStaysFlat() {
+    const qint64 shortNs = incrementalFrameNs(20);
+    const qint64 longNs = incrementalFrameNs(400);
+    qInfo() << "ns per frame, 20 messages:" << shortNs << "400 messages:" << longNs;
+    // A full re-parse is about twenty times slower at 400 messages.
+    QVERIFY2(longNs < 4 * qMax<qint64>(shortNs, 200000),
+             "frame time grows with transcript length");
+}
+
+void TestMarkdownTranscript::frameTime_data() {
+    QTest::addColumn<bool>("incremental");
+    QTest::addColumn<int>("messages");
+    for (int messages : {20, 100, 400}) {
+        QTest::addRow("incremental %d", messages) << true << messages;
+        QTest::addRow("full re-parse %d", messages) << false << messages;
+    }
+}
+
+void TestMarkdownTranscript::frameTime() {
+    QFETCH(bool, incremental);
+    QFETCH(int, messages);
+    const QStringList frames = streamingFrames();
+    if (incremental) {
+        IncrementalRenderer renderer(messages);
+        QBENCHMARK {
+            for (const QString &frame : frames)
+                renderer.frame(frame);
+            renderer.transcript->discardStreaming();
+        }
+    } else {
+        FullRenderer renderer(messages);
+        QBENCHMARK {
+            for (const QString &frame : frames)
+                renderer.frame(frame);
+        }
+    }
+}
+
+QTEST_MAIN(TestMarkdownTranscript)
+
+#include "tst_markdowntranscript.moc"
@@ -0,0 +1,164 @@
+#include "networkengine.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSet>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTest>
+
+namespace {
+constexpr int kDeadlineMs = 300;
+constexpr int kWaitMs = 10000;
+
+/**
+ * Local stand-in for an LLM endpoint. Depending on the mode it answers
+ * normally or stops talking at a chosen point, keeping the socket open.
+ */
+class StallServer : public QTcpServer {
+public:
+    enum Mode {
+        Respond,
+        StallBeforeFirstByte,
+        StallMidStream
+    };
+
+    explicit StallServer(Mode mode, QObject *parent = nullptr)
+        : QTcpServer(parent)
+        , mode(mode) {
+        connect(this, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket *socket = nextPendingConnection()) {
+                socket->setParent(this);
+                connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+                    received[socket] += socket->readAll();
+                    if (!received[socket].contains("\r\n\r\n") || answered.contains(socket))
+                        return;
+                    answered.insert(socket);
+                    answer(socket);
+                });
+            }
+        });
+        listen(QHostAddress::LocalHost);
+    }
+
+    QUrl url() const {
+        return QUrl(QString("http://127.0.0.1:%1/v1/chat/completions").arg(serverPort()));
+    }
+
+private:
+    Mode mode;
+    QHash<QTcpSocket *, QByteArray> received;
+    QSet<QTcpSocket *> answered;
+
+    void answer(QTcpSocket *socket) {
+        if (mode == StallBeforeFirstByte)
+            return;
+        socket->write("HTTP/1.1 200 OK\r\n"
+                      "Content-Type: text/event-stream\r\n"
+                      "Connection: close\r\n\r\n"
+                      "data: {\"choices\":[{\"delta\":{\"content\":\"a\"}}]}\n\n");
+        if (mode == StallMidStream)
+            return;
+        socket->write("data: [DONE]\n\n");
+        socket->disconnectFromHost();
+    }
+};
+
+QNetworkReply *post(const QUrl &url, const RequestDeadlines &deadlines) {
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    NetworkEngine *engine = NetworkEngine::instance();
+    QNetworkReply *reply = engine->post(request, "{\"stream\":true}", QString());
+    engine->watchDeadlines(reply, deadlines);
+    return reply;
+}
+
+RequestDeadlines shortDeadlines() {
+    RequestDeadlines deadlines;
+    deadlines.connectMs = 2000;
+    deadlines.firstByteMs = kDeadlineMs;
+    deadlines.idleMs = kDeadlineMs;
+    return deadlines;
+}
+
+bool waitForFinished(QNetworkReply *reply) {
+    if (reply->isFinished())
+        return true;
+    QSignalSpy finished(reply, &QNetworkReply::finished);
+    return finished.wait(kWaitMs);
+}
+} // namespace
+
+class TestNetworkEngine : public QObject {
+    Q_OBJECT
+
+private slots:
+    void completesWithinDeadlines();
+    void firstByteDeadline();
+    void idleDeadlineMidStream();
+    void stalledEndpointRanksLast();
+};
+
+void TestNetworkEngine::completesWithinDeadlines() {
+    StallServer server(StallServer::Respond);
+    QNetworkReply *reply = post(server.url(), shortDeadlines());
+    QVERIFY(waitForFinished(reply));
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QVERIFY(reply->readAll().contains("[DONE]"));
+    QCOMPARE(NetworkEngine::instance()->connectionStats(reply).expiredDeadline,
+             DeadlineKind::None);
+    reply->deleteLater();
+}
+
+void TestNetworkEngine::firstByteDeadline() {
+    StallServer server(StallServer::StallBeforeFirstByte);
+    QElapsedTimer timer;
+    timer.start();
+    QNetworkReply *reply = post(server.url(), shortDeadlines());
+    QVERIFY(waitForFinished(reply));
+    QCOMPARE(reply->error(), QNetworkReply::OperationCanceledError);
+    QCOMPARE(NetworkEngine::instance()->connectionStats(reply).expiredDeadline,
+             DeadlineKind::FirstByte);
+    QVERIFY(timer.elapsed() >= kDeadlineMs);
+    QVERIFY(timer.elapsed() < kWaitMs / 2);
+    reply->deleteLater();
+}
+
+void TestNetworkEngine::idleDeadlineMidStream() {
+    StallServer server(StallServer::StallMidStream);
+    QNetworkReply *reply = post(server.url(), shortDeadlines());
+    QByteArray body;
+    connect(reply, &QNetworkReply::readyRead, this, [&body, reply]() {
+        body += reply->readAll();
+    });
+    QVERIFY(waitForFinished(reply));
+    QVERIFY(body.contains("\"a\""));
+    QCOMPARE(reply->error(), QNetworkReply::OperationCanceledError);
+    const ConnectionStats stats = NetworkEngine::instance()->connectionStats(reply);
+    QCOMPARE(stats.expiredDeadline, DeadlineKind::Idle);
+    QVERIFY(stats.firstByteMs >= 0);
+    reply->deleteLater();
+}
+
+void TestNetworkEngine::stalledEndpointRanksLast() {
+    StallServer stalled(StallServer::StallBeforeFirstByte);
+    StallServer healthy(StallServer::Respond);
+
+    QNetworkReply *failed = post(stalled.url(), shortDeadlines());
+    QVERIFY(waitForFinished(failed));
+    QNetworkReply *succeeded = post(healthy.url(), shortDeadlines());
+    QVERIFY(waitForFinished(succeeded));
+
+    // Failover tries endpoints in this order.
+    const QList<int> order = NetworkEngine::instance()->rankEndpoints({stalled.url(), healthy.url()});
+    QCOMPARE(order, QList<int>({1, 0}));
+    failed->deleteLater();
+    succeeded->deleteLater();
+}
+
+QTEST_GUILESS_MAIN(TestNetworkEngine)
+
+#include "tst_networkengine.moc"
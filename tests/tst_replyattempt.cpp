@@ -0,0 +1,90 @@
+#include "replyattempt.h"
+
+#include <QTest>
+
+namespace {
+constexpr qsizetype kChunkSize = 1400;
+// Parser buffer plus one partial event; independent of the response size.
+constexpr qsizetype kStreamBufferLimit = 64 * 1024;
+
+QByteArray streamedResponse(qsizetype minBytes) {
+    QByteArray stream;
+    for (int i = 0; stream.size() < minBytes; ++i) {
+        stream += "data: {\"choices\":[{\"index\":0,\"delta\":{\"content\":\"word";
+        stream += QByteArray::number(i % 10);
+        stream += " \"}}]}\n\n";
+    }
+    stream += "data: [DONE]\n\n";
+    return stream;
+}
+
+qsizetype feedInChunks(ReplyAttempt *attempt, const QByteArray &body,
+                       const QByteArray &contentType, QString *text) {
+    qsizetype peak = 0;
+    for (qsizetype pos = 0; pos < body.size(); pos += kChunkSize) {
+        attempt->feed(QByteArrayView(body).sliced(pos, qMin(kChunkSize, body.size() - pos)),
+                      contentType, text);
+        peak = qMax(peak, attempt->bufferedBytes());
+    }
+    return peak;
+}
+} // namespace
+
+class TestReplyAttempt : public QObject {
+    Q_OBJECT
+
+private slots:
+    void streamedPeakBuffer_data();
+    void streamedPeakBuffer();
+    void jsonReplyIsBufferedWhole();
+};
+
+void TestReplyAttempt::streamedPeakBuffer_data() {
+    QTest::addColumn<QByteArray>("contentType");
+    QTest::addColumn<qsizetype>("responseBytes");
+    QTest::newRow("header 256k") << QByteArray("text/event-stream") << qsizetype(256 * 1024);
+    QTest::newRow("header 8M") << QByteArray("text/event-stream") << qsizetype(8 * 1024 * 1024);
+    // Some proxies drop the header; the format is then sniffed from data.
+    QTest::newRow("sniffed 8M") << QByteArray() << qsizetype(8 * 1024 * 1024);
+}
+
+void TestReplyAttempt::streamedPeakBuffer() {
+    QFETCH(QByteArray, contentType);
+    QFETCH(qsizetype, responseBytes);
+    const QByteArray body = streamedResponse(responseBytes);
+
+    ReplyAttempt attempt;
+    QString text;
+    const qsizetype peak = feedInChunks(&attempt, body, contentType, &text);
+    attempt.finish(false, &text);
+
+    QCOMPARE(attempt.replyFormat, ReplyFormat::EventStream);
+    QVERIFY(text.startsWith(QLatin1String("word0 word1 ")));
+    qInfo() << "response" << body.size() << "bytes, peak buffer" << peak << "bytes";
+    QVERIFY2(peak < kStreamBufferLimit,
+             qPrintable(QString("peak buffer %1 bytes for a %2 byte response")
+                            .arg(peak).arg(body.size())));
+    QCOMPARE(attempt.bufferedBytes(), qsizetype(0));
+}
+
+void TestReplyAttempt::jsonReplyIsBufferedWhole() {
+    QByteArray body = "{\"choices\":[{\"message\":{\"role\":\"assistant\",\"content\":\"";
+    body += QByteArray(200 * 1024, 'x');
+    body += "\"}}]}";
+
+    ReplyAttempt attempt;
+    QString text;
+    const qsizetype peak = feedInChunks(&attempt, body, QByteArray(), &text);
+    QCOMPARE(attempt.replyFormat, ReplyFormat::Json);
+    QVERIFY(text.isEmpty());
+    QVERIFY(peak >= body.size());
+    QVERIFY(peak <= 2 * body.size());
+
+    attempt.finish(false, &text);
+    QCOMPARE(text.size(), 200 * 1024);
+    QCOMPARE(attempt.bufferedBytes(), qsizetype(0));
+}
+
+QTEST_APPLESS_MAIN(TestReplyAttempt)
+
+#include "tst_replyattempt.moc"
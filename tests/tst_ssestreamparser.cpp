@@ -0,0 +1,128 @@
+#include "ssestreamparser.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QTest>
+
+namespace {
+constexpr int kReplayEvents = 50000;
+// Network-sized reads, so events straddle chunk boundaries.
+constexpr qsizetype kChunkSize = 1400;
+// Far below the replayed stream; a parser that keeps consumed bytes around
+// passes it within the first few hundred events.
+constexpr qsizetype kBufferLimit = 64 * 1024;
+
+QByteArray recordedStream(int events) {
+    QByteArray stream;
+    for (int i = 0; i < events; ++i) {
+        stream += "data: {\"id\":\"chatcmpl-1\",\"object\":\"chat.completion.chunk\","
+                  "\"choices\":[{\"index\":0,\"delta\":{\"content\":\"token ";
+        stream += QByteArray::number(i);
+        stream += "\"},\"finish_reason\":null}]}\n\n";
+    }
+    stream += "data: [DONE]\n\n";
+    return stream;
+}
+
+int replayStream(SseStreamParser *parser, const QByteArray &stream) {
+    int count = 0;
+    const auto handler = [&count](const SseEvent &) { ++count; };
+    for (qsizetype pos = 0; pos < stream.size(); pos += kChunkSize)
+        parser->feed(QByteArrayView(stream).sliced(pos, qMin(kChunkSize, stream.size() - pos)), handler);
+    parser->finish(handler);
+    return count;
+}
+
+QList<QByteArray> collect(const QList<QByteArray> &chunks) {
+    QList<QByteArray> data;
+    SseStreamParser parser;
+    const auto handler = [&data](const SseEvent &event) { data.append(event.data.toByteArray()); };
+    for (const QByteArray &chunk : chunks)
+        parser.feed(chunk, handler);
+    parser.finish(handler);
+    return data;
+}
+} // namespace
+
+class TestSseStreamParser : public QObject {
+    Q_OBJECT
+
+private slots:
+    void framing();
+    void fieldsAndComments();
+    void crlfSplitAcrossChunks();
+    void bufferStaysBounded();
+    void replay_data();
+    void replay();
+};
+
+void TestSseStreamParser::framing() {
+    QCOMPARE(collect({"data: a\n\ndata: b\ndata: c\n\n"}),
+             QList<QByteArray>({"a", "b\nc"}));
+    QCOMPARE(collect({"da", "ta: x", "yz\n", "\n"}), QList<QByteArray>({"xyz"}));
+    // Unterminated last event is dispatched by finish().
+    QCOMPARE(collect({"data: tail"}), QList<QByteArray>({"tail"}));
+}
+
+void TestSseStreamParser::fieldsAndComments() {
+    QByteArray type;
+    QByteArray id;
+    QByteArray data;
+    SseStreamParser parser;
+    parser.feed(": keep-alive\nevent: delta\nid: 7\ndata:no-space\n\n",
+                [&](const SseEvent &event) {
+                    type = event.type.toByteArray();
+                    id = event.id.toByteArray();
+                    data = event.data.toByteArray();
+                });
+    QCOMPARE(type, QByteArray("delta"));
+    QCOMPARE(id, QByteArray("7"));
+    QCOMPARE(data, QByteArray("no-space"));
+    QVERIFY(parser.sawData());
+}
+
+void TestSseStreamParser::crlfSplitAcrossChunks() {
+    QCOMPARE(collect({"data: a\r", "\n\r", "\ndata: b\r\n\r\n"}),
+             QList<QByteArray>({"a", "b"}));
+}
+
+void TestSseStreamParser::bufferStaysBounded() {
+    const QByteArray stream = recordedStream(kReplayEvents);
+    SseStreamParser parser;
+    int count = 0;
+    const auto handler = [&count](const SseEvent &) { ++count; };
+    qsizetype peak = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (qsizetype pos = 0; pos < stream.size(); pos += kChunkSize) {
+        parser.feed(QByteArrayView(stream).sliced(pos, qMin(kChunkSize, stream.size() - pos)), handler);
+        peak = qMax(peak, parser.bufferedBytes());
+    }
+    parser.finish(handler);
+    QCOMPARE(count, kReplayEvents + 1);
+
+    // Timing is informational; the replay benchmark measures it properly.
+    qInfo() << "ns per event:" << timer.nsecsElapsed() / kReplayEvents
+            << "peak buffer:" << peak << "bytes";
+    QVERIFY2(peak < kBufferLimit,
+             qPrintable(QString("parser kept %1 bytes buffered").arg(peak)));
+}
+
+void TestSseStreamParser::replay_data() {
+    QTest::addColumn<int>("events");
+    QTest::newRow("5k") << 5000;
+    QTest::newRow("50k") << kReplayEvents;
+}
+
+void TestSseStreamParser::replay() {
+    QFETCH(int, events);
+    const QByteArray stream = recordedStream(events);
+    QBENCHMARK {
+        SseStreamParser parser;
+        QCOMPARE(replayStream(&parser, stream), events + 1);
+    }
+}
+
+QTEST_APPLESS_MAIN(TestSseStreamParser)
+
+#include "tst_ssestreamparser.moc"
@@ -0,0 +1,138 @@
+#include "taskfilter.h"
+
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTest>
+
+namespace {
+constexpr int kTaskCount = 1000;
+// One display frame at 60 Hz; a keystroke must be filtered within it.
+constexpr qint64 kFrameNs = 16666667;
+
+// Names shaped like real task lists: a verb, an object and a qualifier,
+// with a few duplicate words so many names share a prefix.
+QStringList taskNames() {
+    const QStringList verbs = {
+        "Translate", "Summarize", "Fix", "Rewrite", "Explain", "Shorten", "Expand",
+        "Review", "Format", "Convert",
+    };
+    const QStringList objects = {
+        "grammar", "email reply", "commit message", "SQL query", "regex", "paragraph",
+        "meeting notes", "bug report", "JSON payload", "release notes",
+    };
+    const QStringList qualifiers = {
+        "to English", "to German", "formally", "casually", "as bullet points",
+        "in one line", "for Slack", "for a PR", "with examples", "step by step",
+    };
+    QStringList names;
+    names.reserve(kTaskCount);
+    for (int i = 0; i < kTaskCount; ++i) {
+        names.append(verbs.at(i % verbs.size()) + ' ' + objects.at(i / verbs.size() % objects.size())
+                     + ' ' + qualifiers.at(i / (verbs.size() * objects.size())));
+    }
+    return names;
+}
+
+// Every prefix of query, then every prefix again from the shortest, the way
+// typing and then deleting with backspace reaches the filter.
+QStringList keystrokes(const QString &query) {
+    QStringList steps;
+    for (qsizetype i = 1; i <= query.size(); ++i)
+        steps.append(query.left(i));
+    for (qsizetype i = query.size() - 1; i >= 0; --i)
+        steps.append(query.left(i));
+    return steps;
+}
+} // namespace
+
+class TestTaskFilter : public QObject {
+    Q_OBJECT
+
+private slots:
+    void matchesSubsequence();
+    void emptyQueryKeepsOrder();
+    void usageBreaksTies();
+    void keystrokeFitsInFrame_data();
+    void keystrokeFitsInFrame();
+    void filter_data();
+    void filter();
+};
+
+void TestTaskFilter::matchesSubsequence() {
+    TaskFilter filter;
+    filter.setTasks({"Rewrite formally", "Fix grammar", "Summarize"});
+    const QList<int> matches = filter.filter("fg");
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches.first(), 1);
+    QCOMPARE(filter.filter("zzz"), QList<int>());
+}
+
+void TestTaskFilter::emptyQueryKeepsOrder() {
+    TaskFilter filter;
+    filter.setTasks({"b", "a", "c"});
+    QCOMPARE(filter.filter(QString()), QList<int>({0, 1, 2}));
+}
+
+void TestTaskFilter::usageBreaksTies() {
+    TaskFilter filter;
+    filter.setTasks({"Translate to German", "Translate to English"});
+    filter.recordUse(1);
+    QCOMPARE(filter.filter("translate").first(), 1);
+    QCOMPARE(filter.usage().value("Translate to English").count, 1);
+}
+
+void TestTaskFilter::keystrokeFitsInFrame_data() {
+    QTest::addColumn<QString>("query");
+    QTest::newRow("word starts") << QString("tre");
+    QTest::newRow("phrase") << QString("fix commit message for a pr");
+    QTest::newRow("scattered") << QString("smbgrp");
+    QTest::newRow("no match") << QString("xqzv");
+}
+
+void TestTaskFilter::keystrokeFitsInFrame() {
+    QFETCH(QString, query);
+    const QStringList names = taskNames();
+    TaskFilter filter;
+    filter.setTasks(names);
+    filter.recordUse(7);
+    filter.recordUse(420);
+
+    qint64 worstNs = 0;
+    QElapsedTimer timer;
+    for (const QString &step : keystrokes(query)) {
+        timer.start();
+        const QList<int> matches = filter.filter(step);
+        worstNs = qMax(worstNs, timer.nsecsElapsed());
+        if (step.isEmpty())
+            QCOMPARE(matches.size(), names.size());
+    }
+    qInfo() << names.size() << "tasks, slowest keystroke" << worstNs / 1000 << "us";
+    QVERIFY2(worstNs < kFrameNs, "filtering a keystroke took longer than one frame");
+}
+
+void TestTaskFilter::filter_data() {
+    QTest::addColumn<QString>("query");
+    QTest::addColumn<bool>("narrowing");
+    QTest::newRow("first keystroke") << QString("t") << false;
+    QTest::newRow("extend query") << QString("tr") << true;
+    QTest::newRow("scattered, from scratch") << QString("smbgrp") << false;
+}
+
+void TestTaskFilter::filter() {
+    QFETCH(QString, query);
+    QFETCH(bool, narrowing);
+    TaskFilter filter;
+    filter.setTasks(taskNames());
+    const QString previous = narrowing ? query.chopped(1) : QString();
+    QList<int> matches;
+    QBENCHMARK {
+        // Reset the previous query so every iteration does the same work.
+        filter.filter(previous);
+        matches = filter.filter(query);
+    }
+    QVERIFY(!matches.isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TestTaskFilter)
+
+#include "tst_taskfilter.moc"
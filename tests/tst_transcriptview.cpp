@@ -0,0 +1,151 @@
+#include "transcriptview.h"
+
+#include <QElapsedTimer>
+#include <QScrollBar>
+#include <QTest>
+#include <QTextDocument>
+
+#include <windows.h>
+#include <psapi.h>
+
+namespace {
+constexpr int kResizeSteps = 20;
+
+QString message(int index) {
+    return QString("Message %1 explains the change in two short paragraphs.\n\n"
+                   "It mentions `TranscriptView` and a code block:\n\n"
+                   "```cpp\nview.appendMessage(text);\n```\n").arg(index);
+}
+
+void fill(TranscriptView *view, int messages) {
+    for (int i = 0; i < messages; ++i)
+        view->appendMessage(message(i));
+    // Lets the queued layout pass and the first paint run.
+    QTest::qWait(50);
+}
+
+int liveDocuments(const TranscriptView &view) {
+    return view.findChildren<QTextDocument *>(Qt::FindDirectChildrenOnly).size();
+}
+
+qint64 privateBytes() {
+    PROCESS_MEMORY_COUNTERS_EX counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(),
+                              reinterpret_cast<PROCESS_MEMORY_COUNTERS *>(&counters),
+                              sizeof(counters))) {
+        return -1;
+    }
+    return qint64(counters.PrivateUsage);
+}
+
+void resizeAndPaint(TranscriptView *view, int width) {
+    view->resize(width, 600);
+    QCoreApplication::processEvents();
+    view->viewport()->repaint();
+}
+
+qint64 resizeLatencyNs(int messages) {
+    TranscriptView view;
+    view.resize(600, 600);
+    view.show();
+    if (!QTest::qWaitForWindowExposed(&view))
+        return -1;
+    fill(&view, messages);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kResizeSteps; ++i)
+        resizeAndPaint(&view, i % 2 ? 600 : 480);
+    return timer.nsecsElapsed() / kResizeSteps;
+}
+} // namespace
+
+class TestTranscriptView : public QObject {
+    Q_OBJECT
+
+private slots:
+    void selectionSpansEvictedMessages();
+    void liveDocumentsStayBounded_data();
+    void liveDocumentsStayBounded();
+    void resizeLatencyStaysFlat();
+    void resize_data();
+    void resize();
+};
+
+void TestTranscriptView::selectionSpansEvictedMessages() {
+    TranscriptView view;
+    view.resize(600, 400);
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+    fill(&view, 300);
+    view.selectAll();
+    const QString text = view.selectedText();
+    QVERIFY(text.startsWith(QLatin1String("Message 0 ")));
+    QVERIFY(text.contains(QLatin1String("Message 150 ")));
+    QVERIFY(text.contains(QLatin1String("Message 299 ")));
+}
+
+void TestTranscriptView::liveDocumentsStayBounded_data() {
+    QTest::addColumn<int>("messages");
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("5000") << 5000;
+}
+
+void TestTranscriptView::liveDocumentsStayBounded() {
+    QFETCH(int, messages);
+    const qint64 before = privateBytes();
+    TranscriptView view;
+    view.resize(600, 600);
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+    fill(&view, messages);
+
+    // Scroll through everything so documents are created and evicted.
+    QScrollBar *bar = view.verticalScrollBar();
+    for (int value = 0; value < bar->maximum(); value += bar->pageStep()) {
+        bar->setValue(value);
+        QCoreApplication::processEvents();
+        view.viewport()->repaint();
+    }
+    for (int width : {480, 720, 600}) {
+        resizeAndPaint(&view, width);
+        view.setZoom(view.zoom() + 1);
+        QCoreApplication::processEvents();
+    }
+
+    const int live = liveDocuments(view);
+    qInfo() << messages << "messages:" << live << "live documents,"
+            << (privateBytes() - before) / 1024 << "KiB private memory";
+    // The eviction limit plus whatever fits on screen.
+    QVERIFY2(live <= 64, qPrintable(QString("%1 live documents").arg(live)));
+}
+
+void TestTranscriptView::resizeLatencyStaysFlat() {
+    const qint64 shortNs = resizeLatencyNs(100);
+    const qint64 longNs = resizeLatencyNs(5000);
+    QVERIFY(shortNs >= 0 && longNs >= 0);
+    qInfo() << "ns per resize, 100 messages:" << shortNs << "5000 messages:" << longNs;
+    QVERIFY2(longNs < 4 * qMax<qint64>(shortNs, 2000000),
+             "resize latency grows with message count");
+}
+
+void TestTranscriptView::resize_data() {
+    liveDocumentsStayBounded_data();
+}
+
+void TestTranscriptView::resize() {
+    QFETCH(int, messages);
+    TranscriptView view;
+    view.resize(600, 600);
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+    fill(&view, messages);
+    int step = 0;
+    QBENCHMARK {
+        resizeAndPaint(&view, ++step % 2 ? 480 : 600);
+    }
+}
+
+QTEST_MAIN(TestTranscriptView)
+
+#include "tst_transcriptview.moc"
@@ -0,0 +1,627 @@
+#include "transcriptview.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QAction>
+#include <QClipboard>
+#include <QContextMenuEvent>
+#include <QDesktopServices>
+#include <QFontMetricsF>
+#include <QGuiApplication>
+#include <QKeyEvent>
+#include <QMenu>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QStyleHints>
+#include <QStringList>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextDocumentFragment>
+#include <QUrl>
+#include <QWheelEvent>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <memory>
+
+#include "markdownview.h"
+
+namespace {
+constexpr int kBasePointSize = 12;
+constexpr qreal kDocumentMargin = 8;
+// Documents kept alive besides the visible ones; the rest keep only their
+// markdown and height.
+constexpr int kMaxLiveDocuments = 48;
+constexpr int kScrollStep = 20;
+} // namespace
+
+TranscriptView::TranscriptView(QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , tops{0} {
+    QFont font = this->font();
+    font.setFamilies({"Segoe UI", "Noto Sans", "Helvetica", "Arial"});
+    font.setPointSize(kBasePointSize);
+    setFont(font);
+    viewport()->setMouseTracking(true);
+    viewport()->setCursor(Qt::IBeamCursor);
+    setFocusPolicy(Qt::StrongFocus);
+    verticalScrollBar()->setSingleStep(kScrollStep);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) {
+        if (!adjustingScroll)
+            followBottom = value >= verticalScrollBar()->maximum();
+        // Scrolling may reveal messages that were never measured.
+        scheduleLayout();
+    });
+}
+
+void TranscriptView::appendMessage(const QString &markdown) {
+    if (markdown.trimmed().isEmpty())
+        return;
+    if (streamingIndex >= 0)
+        finishStreaming(streamingText);
+    Message message;
+    message.markdown = markdown;
+    message.height = estimateHeight(markdown);
+    messages.append(message);
+    tops.append(0);
+    firstDirtyTop = qMin(firstDirtyTop, int(messages.size()) - 1);
+    updateScrollRange();
+    scheduleLayout();
+}
+
+void TranscriptView::setStreamingText(const QString &markdown) {
+    if (streamingIndex < 0) {
+        if (markdown.isEmpty())
+            return;
+        messages.append(Message());
+        tops.append(0);
+        streamingIndex = messages.size() - 1;
+        firstDirtyTop = qMin(firstDirtyTop, streamingIndex);
+        ensureDocument(streamingIndex);
+    }
+    streamingText = markdown;
+    messages[streamingIndex].transcript->setStreamingText(markdown);
+}
+
+void TranscriptView::finishStreaming(const QString &finalText) {
+    if (streamingIndex < 0) {
+        appendMessage(finalText);
+        return;
+    }
+    if (finalText.trimmed().isEmpty()) {
+        discardStreaming();
+        return;
+    }
+    Message &message = messages[streamingIndex];
+    message.markdown = finalText;
+    message.transcript->finishStreaming(finalText);
+    streamingIndex = -1;
+    streamingText.clear();
+}
+
+void TranscriptView::discardStreaming() {
+    if (streamingIndex < 0)
+        return;
+    const int index = streamingIndex;
+    streamingIndex = -1;
+    streamingText.clear();
+    removeMessage(index);
+}
+
+void TranscriptView::clear() {
+    for (int i = 0; i < messages.size(); ++i)
+        releaseDocument(i);
+    messages.clear();
+    tops = {0};
+    firstDirtyTop = 0;
+    streamingIndex = -1;
+    streamingText.clear();
+    followBottom = true;
+    clearSelection();
+    updateScrollRange();
+    scheduleLayout();
+}
+
+void TranscriptView::setZoom(int steps) {
+    if (steps == zoomSteps)
+        return;
+    const qreal ratio = qreal(qMax(1, kBasePointSize + steps))
+                        / qMax(1, kBasePointSize + zoomSteps);
+    zoomSteps = steps;
+    const QFont font = zoomedFont();
+    for (Message &message : messages) {
+        if (message.document) {
+            message.document->setDefaultFont(font);
+            message.styler->invalidate();
+        }
+        // Rough estimate until the message is laid out again.
+        message.height *= ratio;
+        message.measured = false;
+    }
+    firstDirtyTop = 0;
+    updateScrollRange();
+    scheduleLayout();
+}
+
+bool TranscriptView::hasSelection() const {
+    TextPoint start;
+    TextPoint end;
+    return orderedSelection(&start, &end);
+}
+
+QString TranscriptView::selectedText() {
+    TextPoint start;
+    TextPoint end;
+    if (!orderedSelection(&start, &end))
+        return QString();
+    QStringList parts;
+    for (int i = start.message; i <= end.message; ++i) {
+        // Evicted messages in the middle of a selection are parsed again
+        // just for the copy.
+        std::unique_ptr<QTextDocument> scratch;
+        QTextDocument *document = messages[i].document;
+        if (!document) {
+            scratch = std::make_unique<QTextDocument>();
+            scratch->setMarkdown(messages[i].markdown, QTextDocument::MarkdownDialectGitHub);
+            document = scratch.get();
+        }
+        const int last = document->characterCount() - 1;
+        QTextCursor cursor(document);
+        cursor.setPosition(i == start.message ? qBound(0, start.position, last) : 0);
+        cursor.setPosition(i == end.message ? qBound(0, end.position, last) : last,
+                           QTextCursor::KeepAnchor);
+        parts.append(cursor.selection().toPlainText());
+    }
+    return parts.join('\n');
+}
+
+void TranscriptView::copy() {
+    const QString text = selectedText();
+    if (!text.isEmpty())
+        QGuiApplication::clipboard()->setText(text);
+}
+
+void TranscriptView::selectAll() {
+    if (messages.isEmpty())
+        return;
+    selectionAnchor = {0, 0};
+    selectionHead = {int(messages.size()) - 1, INT_MAX};
+    viewport()->update();
+}
+
+void TranscriptView::paintEvent(QPaintEvent *event) {
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), Qt::white);
+    if (messages.isEmpty())
+        return;
+
+    ++paintGeneration;
+    if (layoutWidth != viewport()->width())
+        scheduleLayout();
+
+    const int value = verticalScrollBar()->value();
+    const QRect clip = event->rect();
+    TextPoint start;
+    TextPoint end;
+    const bool selected = orderedSelection(&start, &end);
+    for (int i = messageAt(value + clip.top());
+         i < messages.size() && tops[i] - value <= clip.bottom(); ++i) {
+        Message &message = messages[i];
+        message.lastPainted = paintGeneration;
+        // An evicted message is parsed again by the layout pass, not here;
+        // until then its estimated height stays blank.
+        QTextDocument *document = message.document;
+        if (!document || (!message.measured && !message.rebuilding))
+            scheduleLayout();
+        if (!document)
+            continue;
+        const qreal top = tops[i] - value;
+
+        QAbstractTextDocumentLayout::PaintContext context;
+        context.palette = palette();
+        context.clip = QRectF(clip).translated(0, -top);
+        if (selected && i >= start.message && i <= end.message) {
+            const int last = document->characterCount() - 1;
+            QAbstractTextDocumentLayout::Selection selection;
+            selection.cursor = QTextCursor(document);
+            selection.cursor.setPosition(i == start.message ? qBound(0, start.position, last) : 0);
+            selection.cursor.setPosition(i == end.message ? qBound(0, end.position, last) : last,
+                                         QTextCursor::KeepAnchor);
+            selection.format.setBackground(palette().highlight());
+            selection.format.setForeground(palette().highlightedText());
+            context.selections.append(selection);
+        }
+
+        painter.save();
+        painter.translate(0, top);
+        document->documentLayout()->draw(&painter, context);
+        painter.restore();
+    }
+    evictDocuments();
+}
+
+void TranscriptView::resizeEvent(QResizeEvent *event) {
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollRange();
+    scheduleLayout();
+}
+
+void TranscriptView::wheelEvent(QWheelEvent *event) {
+    if (!event->modifiers().testFlag(Qt::ControlModifier)) {
+        QAbstractScrollArea::wheelEvent(event);
+        return;
+    }
+    int delta = event->angleDelta().y();
+    if (delta == 0)
+        delta = event->pixelDelta().y();
+    event->accept();
+    if (delta == 0)
+        return;
+    const int steps = qMax(1, qAbs(delta) / 120) * (delta > 0 ? 1 : -1);
+    setZoom(zoomSteps + steps);
+    emit zoomChanged(steps);
+}
+
+void TranscriptView::mousePressEvent(QMouseEvent *event) {
+    if (event->button() != Qt::LeftButton) {
+        QAbstractScrollArea::mousePressEvent(event);
+        return;
+    }
+    const TextPoint point = hitTest(event->position().toPoint());
+    if (point.message < 0)
+        return;
+    if (!event->modifiers().testFlag(Qt::ShiftModifier) || selectionAnchor.message < 0)
+        selectionAnchor = point;
+    selectionHead = point;
+    selecting = true;
+    dragged = false;
+    pressPos = event->position().toPoint();
+    viewport()->update();
+}
+
+void TranscriptView::mouseMoveEvent(QMouseEvent *event) {
+    const QPoint pos = event->position().toPoint();
+    if (!selecting) {
+        viewport()->setCursor(anchorAt(pos).isEmpty() ? Qt::IBeamCursor : Qt::PointingHandCursor);
+        return;
+    }
+    if ((pos - pressPos).manhattanLength() >= QGuiApplication::styleHints()->startDragDistance())
+        dragged = true;
+    QScrollBar *bar = verticalScrollBar();
+    if (pos.y() < 0)
+        bar->setValue(bar->value() + pos.y());
+    else if (pos.y() > viewport()->height())
+        bar->setValue(bar->value() + pos.y() - viewport()->height());
+    const TextPoint point = hitTest(pos);
+    if (point.message >= 0)
+        selectionHead = point;
+    viewport()->update();
+}
+
+void TranscriptView::mouseReleaseEvent(QMouseEvent *event) {
+    if (event->button() != Qt::LeftButton || !selecting) {
+        QAbstractScrollArea::mouseReleaseEvent(event);
+        return;
+    }
+    selecting = false;
+    if (dragged)
+        return;
+    const QString anchor = anchorAt(event->position().toPoint());
+    if (!anchor.isEmpty()) {
+        clearSelection();
+        QDesktopServices::openUrl(QUrl(anchor));
+    }
+}
+
+void TranscriptView::mouseDoubleClickEvent(QMouseEvent *event) {
+    if (event->button() != Qt::LeftButton) {
+        QAbstractScrollArea::mouseDoubleClickEvent(event);
+        return;
+    }
+    const TextPoint point = hitTest(event->position().toPoint());
+    if (point.message < 0)
+        return;
+    QTextCursor cursor(ensureDocument(point.message));
+    cursor.setPosition(point.position);
+    cursor.select(QTextCursor::WordUnderCursor);
+    selectionAnchor = {point.message, cursor.selectionStart()};
+    selectionHead = {point.message, cursor.selectionEnd()};
+    selecting = false;
+    viewport()->update();
+}
+
+void TranscriptView::keyPressEvent(QKeyEvent *event) {
+    if (event == QKeySequence::Copy) {
+        copy();
+        event->accept();
+        return;
+    }
+    if (event == QKeySequence::SelectAll) {
+        selectAll();
+        event->accept();
+        return;
+    }
+    QAbstractScrollArea::keyPressEvent(event);
+}
+
+void TranscriptView::contextMenuEvent(QContextMenuEvent *event) {
+    QMenu menu(this);
+    QAction *copyAction = menu.addAction(tr("Copy"));
+    copyAction->setShortcut(QKeySequence::Copy);
+    copyAction->setEnabled(hasSelection());
+    connect(copyAction, &QAction::triggered, this, &TranscriptView::copy);
+    QAction *selectAllAction = menu.addAction(tr("Select All"));
+    selectAllAction->setShortcut(QKeySequence::SelectAll);
+    connect(selectAllAction, &QAction::triggered, this, &TranscriptView::selectAll);
+    menu.exec(event->globalPos());
+}
+
+QFont TranscriptView::zoomedFont() const {
+    QFont font = this->font();
+    font.setPointSize(qMax(1, kBasePointSize + zoomSteps));
+    return font;
+}
+
+QTextDocument *TranscriptView::ensureDocument(int index) {
+    Message &message = messages[index];
+    if (message.document)
+        return message.document;
+
+    auto *document = new QTextDocument(this);
+    document->setDefaultFont(zoomedFont());
+    document->setDefaultStyleSheet(markdownCss());
+    document->setDocumentMargin(kDocumentMargin);
+    if (layoutWidth > 0)
+        document->setTextWidth(layoutWidth);
+    new MarkdownCodeHighlighter(document);
+    message.styler = new MarkdownStyler(document);
+    message.transcript = new MarkdownTranscript(document);
+    message.document = document;
+    connect(document, &QTextDocument::contentsChanged, this, [this, document]() {
+        documentChanged(document, false);
+    });
+    connect(message.transcript, &MarkdownTranscript::rendered, this, [this, document]() {
+        documentChanged(document, true);
+    });
+
+    if (!message.markdown.isEmpty()) {
+        message.transcript->appendMessage(message.markdown);
+        // A large message is parsed in the background; keep its last known
+        // height until it lands.
+        message.rebuilding = document->isEmpty();
+        // Styled and measured again by the next layout pass.
+        message.measured = false;
+    }
+    return document;
+}
+
+void TranscriptView::releaseDocument(int index) {
+    Message &message = messages[index];
+    delete message.document;
+    message.document = nullptr;
+    message.styler = nullptr;
+    message.transcript = nullptr;
+    message.rebuilding = false;
+}
+
+void TranscriptView::evictDocuments() {
+    QList<int> candidates;
+    int live = 0;
+    for (int i = 0; i < messages.size(); ++i) {
+        const Message &message = messages[i];
+        if (!message.document)
+            continue;
+        ++live;
+        if (i == streamingIndex || message.lastPainted == paintGeneration
+            || i == selectionAnchor.message || i == selectionHead.message) {
+            continue;
+        }
+        candidates.append(i);
+    }
+    if (live <= kMaxLiveDocuments)
+        return;
+    std::sort(candidates.begin(), candidates.end(), [this](int a, int b) {
+        return messages[a].lastPainted < messages[b].lastPainted;
+    });
+    for (int i = 0; i < candidates.size() && live > kMaxLiveDocuments; ++i, --live)
+        releaseDocument(candidates[i]);
+}
+
+int TranscriptView::indexOfDocument(const QTextDocument *document) const {
+    // Changes almost always come from the streaming message at the end.
+    for (int i = messages.size() - 1; i >= 0; --i) {
+        if (messages[i].document == document)
+            return i;
+    }
+    return -1;
+}
+
+void TranscriptView::documentChanged(const QTextDocument *document, bool rendered) {
+    const int index = indexOfDocument(document);
+    if (index < 0)
+        return;
+    Message &message = messages[index];
+    if (rendered)
+        message.rebuilding = false;
+    message.measured = false;
+    scheduleLayout();
+}
+
+void TranscriptView::removeMessage(int index) {
+    releaseDocument(index);
+    messages.removeAt(index);
+    tops.removeLast();
+    firstDirtyTop = qMin(firstDirtyTop, index);
+    if (streamingIndex > index)
+        --streamingIndex;
+    if (selectionAnchor.message >= index || selectionHead.message >= index)
+        clearSelection();
+    updateScrollRange();
+    scheduleLayout();
+}
+
+bool TranscriptView::measure(int index) {
+    Message &message = messages[index];
+    if (message.measured)
+        return false;
+    QTextDocument *document = ensureDocument(index);
+    if (message.rebuilding)
+        return false;
+    message.styler->apply();
+    if (document->textWidth() != layoutWidth)
+        document->setTextWidth(layoutWidth);
+    const qreal height = document->size().height();
+    message.measured = true;
+    if (qAbs(height - message.height) < 0.5)
+        return false;
+    message.height = height;
+    firstDirtyTop = qMin(firstDirtyTop, index);
+    return true;
+}
+
+void TranscriptView::scheduleLayout() {
+    if (layoutPending)
+        return;
+    layoutPending = true;
+    QMetaObject::invokeMethod(this, [this]() {
+        // Measuring can move the scroll position (following the bottom or
+        // keeping the first visible message in place), which may reveal
+        // more unmeasured messages. Scroll changes made here do not
+        // schedule another pass.
+        for (int pass = 0; pass < 3; ++pass) {
+            if (!layoutVisible())
+                break;
+        }
+        layoutPending = false;
+        viewport()->update();
+    }, Qt::QueuedConnection);
+}
+
+bool TranscriptView::layoutVisible() {
+    if (messages.isEmpty())
+        return false;
+    const qreal width = viewport()->width();
+    if (width != layoutWidth) {
+        layoutWidth = width;
+        // Off-screen messages keep their height at the old width as an
+        // estimate and are laid out again when they become visible.
+        for (Message &message : messages)
+            message.measured = false;
+    }
+    updateTops();
+
+    const int value = verticalScrollBar()->value();
+    const int anchor = messageAt(value);
+    const qreal anchorOffset = value - tops[anchor];
+    const qreal bottom = value + viewport()->height();
+    bool changed = false;
+    qreal y = tops[anchor];
+    for (int i = anchor; i < messages.size() && y < bottom; ++i) {
+        // Re-creates documents evicted while off screen, even if their
+        // height is still known.
+        ensureDocument(i);
+        changed |= measure(i);
+        messages[i].lastPainted = paintGeneration;
+        y += messages[i].height;
+    }
+    // The streaming message decides the scroll range even when off screen.
+    if (streamingIndex >= 0)
+        changed |= measure(streamingIndex);
+    if (!changed)
+        return false;
+
+    updateScrollRange();
+    if (!followBottom)
+        setScrollValue(qRound(tops[anchor] + qMin(anchorOffset, messages[anchor].height)));
+    return true;
+}
+
+qreal TranscriptView::estimateHeight(const QString &markdown) const {
+    const QFontMetricsF metrics(zoomedFont());
+    const qreal width = (layoutWidth > 0 ? layoutWidth : viewport()->width()) - 2 * kDocumentMargin;
+    const qreal charsPerLine = qMax<qreal>(1, width / metrics.averageCharWidth());
+    qreal lines = 0;
+    qsizetype start = 0;
+    while (start <= markdown.size()) {
+        qsizetype end = markdown.indexOf('\n', start);
+        if (end < 0)
+            end = markdown.size();
+        lines += qMax<qreal>(1, std::ceil((end - start) / charsPerLine));
+        start = end + 1;
+    }
+    return lines * metrics.lineSpacing() + 2 * kDocumentMargin;
+}
+
+void TranscriptView::updateTops() {
+    for (int i = firstDirtyTop; i < messages.size(); ++i)
+        tops[i + 1] = tops[i] + messages[i].height;
+    firstDirtyTop = messages.size();
+}
+
+void TranscriptView::updateScrollRange() {
+    updateTops();
+    QScrollBar *bar = verticalScrollBar();
+    const int page = viewport()->height();
+    const int maximum = qMax(0, int(std::ceil(tops.last())) - page);
+    adjustingScroll = true;
+    bar->setPageStep(page);
+    bar->setRange(0, maximum);
+    if (followBottom)
+        bar->setValue(maximum);
+    adjustingScroll = false;
+}
+
+void TranscriptView::setScrollValue(int value) {
+    adjustingScroll = true;
+    verticalScrollBar()->setValue(value);
+    adjustingScroll = false;
+}
+
+int TranscriptView::messageAt(qreal y) const {
+    if (messages.isEmpty())
+        return -1;
+    const auto it = std::upper_bound(tops.begin(), tops.end() - 1, y);
+    return qBound(0, int(it - tops.begin()) - 1, int(messages.size()) - 1);
+}
+
+TranscriptView::TextPoint TranscriptView::hitTest(const QPoint &pos) {
+    const qreal y = pos.y() + verticalScrollBar()->value();
+    const int index = messageAt(y);
+    if (index < 0)
+        return TextPoint();
+    QTextDocument *document = ensureDocument(index);
+    const QPointF local(pos.x(), y - tops[index]);
+    int position = document->documentLayout()->hitTest(local, Qt::FuzzyHit);
+    if (position < 0)
+        position = local.y() < 0 ? 0 : document->characterCount() - 1;
+    return {index, position};
+}
+
+QString TranscriptView::anchorAt(const QPoint &pos) {
+    const qreal y = pos.y() + verticalScrollBar()->value();
+    const int index = messageAt(y);
+    if (index < 0 || y >= tops.last())
+        return QString();
+    QTextDocument *document = ensureDocument(index);
+    return document->documentLayout()->anchorAt(QPointF(pos.x(), y - tops[index]));
+}
+
+bool TranscriptView::orderedSelection(TextPoint *start, TextPoint *end) const {
+    if (selectionAnchor.message < 0 || selectionHead.message < 0)
+        return false;
+    const bool anchorFirst = selectionAnchor.message < selectionHead.message
+                             || (selectionAnchor.message == selectionHead.message
+                                 && selectionAnchor.position <= selectionHead.position);
+    *start = anchorFirst ? selectionAnchor : selectionHead;
+    *end = anchorFirst ? selectionHead : selectionAnchor;
+    return start->message != end->message || start->position != end->position;
+}
+
+void TranscriptView::clearSelection() {
+    selectionAnchor = TextPoint();
+    selectionHead = TextPoint();
+    selecting = false;
+    viewport()->update();
+}
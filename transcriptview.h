@@ -0,0 +1,122 @@
+#ifndef TRANSCRIPTVIEW_H
+#define TRANSCRIPTVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QFont>
+#include <QList>
+#include <QString>
+
+class QTextDocument;
+class MarkdownStyler;
+class MarkdownTranscript;
+
+/**
+ * @brief Scrollable chat transcript that only lays out what is on screen.
+ *
+ *  Every message is its own QTextDocument, created when the message first
+ *  scrolls into view and dropped again (keeping the markdown source and
+ *  the measured height) once more than a few dozen are alive. Messages that
+ *  were never measured at the current width and zoom use an estimated
+ *  height, so resizing and zooming only re-lay out the visible messages.
+ *  Selection is kept as a pair of (message, position) points and can span
+ *  any number of messages.
+ *
+ *  The streaming API mirrors MarkdownTranscript: the streaming message is
+ *  the last one and is always kept alive.
+ */
+class TranscriptView : public QAbstractScrollArea {
+    Q_OBJECT
+
+public:
+    explicit TranscriptView(QWidget *parent = nullptr);
+
+    void appendMessage(const QString &markdown);
+    void setStreamingText(const QString &markdown);
+    void finishStreaming(const QString &finalText);
+    void discardStreaming();
+    void clear();
+
+    /// Font size offset in points, counted like QTextEdit::zoomIn.
+    void setZoom(int steps);
+    int zoom() const { return zoomSteps; }
+
+    bool hasSelection() const;
+    QString selectedText();
+
+public slots:
+    void copy();
+    void selectAll();
+
+signals:
+    /// Ctrl+wheel zoom by the user, in steps.
+    void zoomChanged(int delta);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+
+private:
+    struct Message {
+        QString markdown; // empty while streaming
+        QTextDocument *document = nullptr; // null while evicted
+        MarkdownStyler *styler = nullptr;
+        MarkdownTranscript *transcript = nullptr;
+        qreal height = 0;
+        bool measured = false; // height is exact for the current width and zoom
+        bool rebuilding = false; // evicted document is being parsed again
+        quint64 lastPainted = 0;
+    };
+
+    struct TextPoint {
+        int message = -1;
+        int position = 0;
+    };
+
+    QList<Message> messages;
+    // tops[i] is the y of message i; the last entry is the total height.
+    QList<qreal> tops;
+    int firstDirtyTop = 0;
+    int streamingIndex = -1;
+    QString streamingText;
+    int zoomSteps = 0;
+    qreal layoutWidth = -1;
+    quint64 paintGeneration = 0;
+    bool followBottom = true;
+    bool adjustingScroll = false;
+    bool layoutPending = false;
+    TextPoint selectionAnchor;
+    TextPoint selectionHead;
+    bool selecting = false;
+    bool dragged = false;
+    QPoint pressPos;
+
+    QFont zoomedFont() const;
+    QTextDocument *ensureDocument(int index);
+    void releaseDocument(int index);
+    void evictDocuments();
+    int indexOfDocument(const QTextDocument *document) const;
+    void documentChanged(const QTextDocument *document, bool rendered);
+    void removeMessage(int index);
+    bool measure(int index);
+    /// Lays out the visible messages before the next paint; paintEvent only draws.
+    void scheduleLayout();
+    bool layoutVisible();
+    qreal estimateHeight(const QString &markdown) const;
+    void updateTops();
+    void updateScrollRange();
+    void setScrollValue(int value);
+    int messageAt(qreal y) const;
+    TextPoint hitTest(const QPoint &pos);
+    QString anchorAt(const QPoint &pos);
+    bool orderedSelection(TextPoint *start, TextPoint *end) const;
+    void clearSelection();
+};
+
+#endif // TRANSCRIPTVIEW_H